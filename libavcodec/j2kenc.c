@@ -107,6 +107,16 @@ typedef struct {
    double *layer_rates;
 } Jpeg2000Tile;
 
+/** a code-block to be coded by tier-1, independent of all others */
+typedef struct {
+    Jpeg2000Tile *tile;
+    Jpeg2000Component *comp;
+    Jpeg2000Band *band;
+    Jpeg2000Cblk *cblk;
+    int xx0, xx1, yy0, yy1; ///< code-block position in the component's DWT output
+    int bandpos, lev;
+} Jpeg2000CblkJob;
+
 typedef struct {
     AVClass *class;
     AVCodecContext *avctx;
@@ -131,6 +141,10 @@ typedef struct {
     Jpeg2000QuantStyle  qntsty;
 
     Jpeg2000Tile *tile;
+    Jpeg2000CblkJob *cblk_jobs;
+    int nb_cblk_jobs;
+    int *job_ret;          ///< return values of the DWT and tier-1 jobs
+    Jpeg2000T1Context *t1; ///< one tier-1 context per thread
     int layer_rates[100];
     uint8_t compression_rate_enc; ///< Is compression done using compression ratio?
 
@@ -1400,84 +1414,131 @@ static void truncpasses(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile)
     }
 }
 
-static int encode_tile(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile, int tileno)
+static int dwt_encode_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
 {
-    int compno, reslevelno, bandno, ret;
-    Jpeg2000T1Context t1;
-    Jpeg2000CodingStyle *codsty = &s->codsty;
-    for (compno = 0; compno < s->ncomponents; compno++){
-        Jpeg2000Component *comp = s->tile[tileno].comp + compno;
+    Jpeg2000EncoderContext *s = avctx->priv_data;
+    Jpeg2000Component *comp = s->tile[jobnr / s->ncomponents].comp + jobnr % s->ncomponents;
 
-        t1.stride = (1<<codsty->log2_cblk_width) + 2;
+    return ff_dwt_encode(&comp->dwt, comp->i_data) < 0 ? AVERROR_BUG : 0;
+}
 
-        av_log(s->avctx, AV_LOG_DEBUG,"dwt\n");
-        if ((ret = ff_dwt_encode(&comp->dwt, comp->i_data)) < 0)
-            return ret;
-        av_log(s->avctx, AV_LOG_DEBUG,"after dwt -> tier1\n");
+static int encode_cblk_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    Jpeg2000EncoderContext *s = avctx->priv_data;
+    const Jpeg2000CblkJob *job = s->cblk_jobs + jobnr;
+    Jpeg2000T1Context *t1 = s->t1 + threadnr;
+    Jpeg2000Component *comp = job->comp;
+    Jpeg2000Band *band = job->band;
+    int y, x, w = comp->coord[0][1] - comp->coord[0][0];
+
+    if (s->codsty.transform == FF_DWT53){
+        for (y = job->yy0; y < job->yy1; y++){
+            int *ptr = t1->data + (y-job->yy0)*t1->stride;
+            for (x = job->xx0; x < job->xx1; x++){
+                *ptr++ = comp->i_data[w * y + x] * (1 << NMSEDEC_FRACBITS);
+            }
+        }
+    } else{
+        for (y = job->yy0; y < job->yy1; y++){
+            int *ptr = t1->data + (y-job->yy0)*t1->stride;
+            for (x = job->xx0; x < job->xx1; x++){
+                *ptr = (comp->i_data[w * y + x]);
+                *ptr = (int64_t)*ptr * (int64_t)(16384 * 65536 / band->i_stepsize) >> 15 - NMSEDEC_FRACBITS;
+                ptr++;
+            }
+        }
+    }
+    encode_cblk(s, t1, job->cblk, job->tile, job->xx1 - job->xx0, job->yy1 - job->yy0,
+                job->bandpos, job->lev);
+    return 0;
+}
 
-        for (reslevelno = 0; reslevelno < codsty->nreslevels; reslevelno++){
-            Jpeg2000ResLevel *reslevel = comp->reslevel + reslevelno;
+/**
+ * Build the list of code-blocks of all tiles and components, so that tier-1
+ * coding can run over them in parallel.
+ */
+static int init_cblk_jobs(Jpeg2000EncoderContext *s)
+{
+    int tileno, compno, reslevelno, bandno, pass;
+    Jpeg2000CodingStyle *codsty = &s->codsty;
 
-            for (bandno = 0; bandno < reslevel->nbands ; bandno++){
-                Jpeg2000Band *band = reslevel->band + bandno;
-                Jpeg2000Prec *prec = band->prec; // we support only 1 precinct per band ATM in the encoder
-                int cblkx, cblky, cblkno=0, xx0, x0, xx1, y0, yy0, yy1, bandpos;
-                yy0 = bandno == 0 ? 0 : comp->reslevel[reslevelno-1].coord[1][1] - comp->reslevel[reslevelno-1].coord[1][0];
-                y0 = yy0;
-                yy1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[1][0] + 1, band->log2_cblk_height) << band->log2_cblk_height,
-                            band->coord[1][1]) - band->coord[1][0] + yy0;
+    for (pass = 0; pass < 2; pass++) {
+        s->nb_cblk_jobs = 0;
+        for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++){
+            Jpeg2000Tile *tile = s->tile + tileno;
+            for (compno = 0; compno < s->ncomponents; compno++){
+                Jpeg2000Component *comp = tile->comp + compno;
 
-                if (band->coord[0][0] == band->coord[0][1] || band->coord[1][0] == band->coord[1][1])
-                    continue;
+                for (reslevelno = 0; reslevelno < codsty->nreslevels; reslevelno++){
+                    Jpeg2000ResLevel *reslevel = comp->reslevel + reslevelno;
 
-                bandpos = bandno + (reslevelno > 0);
-
-                for (cblky = 0; cblky < prec->nb_codeblocks_height; cblky++){
-                    if (reslevelno == 0 || bandno == 1)
-                        xx0 = 0;
-                    else
-                        xx0 = comp->reslevel[reslevelno-1].coord[0][1] - comp->reslevel[reslevelno-1].coord[0][0];
-                    x0 = xx0;
-                    xx1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[0][0] + 1, band->log2_cblk_width) << band->log2_cblk_width,
-                                band->coord[0][1]) - band->coord[0][0] + xx0;
-
-                    for (cblkx = 0; cblkx < prec->nb_codeblocks_width; cblkx++, cblkno++){
-                        int y, x;
-                        if (codsty->transform == FF_DWT53){
-                            for (y = yy0; y < yy1; y++){
-                                int *ptr = t1.data + (y-yy0)*t1.stride;
-                                for (x = xx0; x < xx1; x++){
-                                    *ptr++ = comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x] * (1 << NMSEDEC_FRACBITS);
-                                }
-                            }
-                        } else{
-                            for (y = yy0; y < yy1; y++){
-                                int *ptr = t1.data + (y-yy0)*t1.stride;
-                                for (x = xx0; x < xx1; x++){
-                                    *ptr = (comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x]);
-                                    *ptr = (int64_t)*ptr * (int64_t)(16384 * 65536 / band->i_stepsize) >> 15 - NMSEDEC_FRACBITS;
-                                    ptr++;
+                    for (bandno = 0; bandno < reslevel->nbands ; bandno++){
+                        Jpeg2000Band *band = reslevel->band + bandno;
+                        Jpeg2000Prec *prec = band->prec; // we support only 1 precinct per band ATM in the encoder
+                        int cblkx, cblky, cblkno=0, xx0, x0, xx1, y0, yy0, yy1;
+                        yy0 = bandno == 0 ? 0 : comp->reslevel[reslevelno-1].coord[1][1] - comp->reslevel[reslevelno-1].coord[1][0];
+                        y0 = yy0;
+                        yy1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[1][0] + 1, band->log2_cblk_height) << band->log2_cblk_height,
+                                    band->coord[1][1]) - band->coord[1][0] + yy0;
+
+                        if (band->coord[0][0] == band->coord[0][1] || band->coord[1][0] == band->coord[1][1])
+                            continue;
+
+                        for (cblky = 0; cblky < prec->nb_codeblocks_height; cblky++){
+                            if (reslevelno == 0 || bandno == 1)
+                                xx0 = 0;
+                            else
+                                xx0 = comp->reslevel[reslevelno-1].coord[0][1] - comp->reslevel[reslevelno-1].coord[0][0];
+                            x0 = xx0;
+                            xx1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[0][0] + 1, band->log2_cblk_width) << band->log2_cblk_width,
+                                        band->coord[0][1]) - band->coord[0][0] + xx0;
+
+                            for (cblkx = 0; cblkx < prec->nb_codeblocks_width; cblkx++, cblkno++){
+                                if (pass) {
+                                    Jpeg2000CblkJob *job = s->cblk_jobs + s->nb_cblk_jobs;
+                                    Jpeg2000Cblk *cblk = prec->cblk + cblkno;
+
+                                    if (!cblk->data)
+                                        cblk->data = av_malloc(1 + 8192);
+                                    if (!cblk->passes)
+                                        cblk->passes = av_malloc_array(JPEG2000_MAX_PASSES, sizeof (*cblk->passes));
+                                    if (!cblk->data || !cblk->passes)
+                                        return AVERROR(ENOMEM);
+
+                                    job->tile    = tile;
+                                    job->comp    = comp;
+                                    job->band    = band;
+                                    job->cblk    = cblk;
+                                    job->xx0     = xx0;
+                                    job->xx1     = xx1;
+                                    job->yy0     = yy0;
+                                    job->yy1     = yy1;
+                                    job->bandpos = bandno + (reslevelno > 0);
+                                    job->lev     = codsty->nreslevels - reslevelno - 1;
                                 }
+                                s->nb_cblk_jobs++;
+                                xx0 = xx1;
+                                xx1 = FFMIN(xx1 + (1 << band->log2_cblk_width), band->coord[0][1] - band->coord[0][0] + x0);
                             }
+                            yy0 = yy1;
+                            yy1 = FFMIN(yy1 + (1 << band->log2_cblk_height), band->coord[1][1] - band->coord[1][0] + y0);
                         }
-                        if (!prec->cblk[cblkno].data)
-                            prec->cblk[cblkno].data = av_malloc(1 + 8192);
-                        if (!prec->cblk[cblkno].passes)
-                            prec->cblk[cblkno].passes = av_malloc_array(JPEG2000_MAX_PASSES, sizeof (*prec->cblk[cblkno].passes));
-                        if (!prec->cblk[cblkno].data || !prec->cblk[cblkno].passes)
-                            return AVERROR(ENOMEM);
-                        encode_cblk(s, &t1, prec->cblk + cblkno, tile, xx1 - xx0, yy1 - yy0,
-                                    bandpos, codsty->nreslevels - reslevelno - 1);
-                        xx0 = xx1;
-                        xx1 = FFMIN(xx1 + (1 << band->log2_cblk_width), band->coord[0][1] - band->coord[0][0] + x0);
                     }
-                    yy0 = yy1;
-                    yy1 = FFMIN(yy1 + (1 << band->log2_cblk_height), band->coord[1][1] - band->coord[1][0] + y0);
                 }
             }
         }
-        av_log(s->avctx, AV_LOG_DEBUG, "after tier1\n");
+        if (!pass) {
+            s->cblk_jobs = av_calloc(s->nb_cblk_jobs, sizeof(*s->cblk_jobs));
+            if (!s->cblk_jobs)
+                return AVERROR(ENOMEM);
+        }
     }
+    return 0;
+}
+
+static int encode_tile(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile, int tileno)
+{
+    int ret;
 
     av_log(s->avctx, AV_LOG_DEBUG, "rate control\n");
     if (s->compression_rate_enc)
@@ -1526,6 +1587,14 @@ static void update_size(uint8_t *size, const uint8_t *end)
     AV_WB32(size, end-size);
 }
 
+static int check_job_ret(Jpeg2000EncoderContext *s, int nb_jobs)
+{
+    for (int i = 0; i < nb_jobs; i++)
+        if (s->job_ret[i] < 0)
+            return s->job_ret[i];
+    return 0;
+}
+
 static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                         const AVFrame *pict, int *got_packet)
 {
@@ -1551,6 +1620,19 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
 
     reinit(s);
 
+    // tier-1 coding does not depend on the bitstream position, run it for all
+    // tiles up front so that code-blocks can be coded in parallel
+    av_log(s->avctx, AV_LOG_DEBUG, "dwt\n");
+    avctx->execute2(avctx, dwt_encode_job, NULL, s->job_ret,
+                    s->numXtiles * s->numYtiles * s->ncomponents);
+    if ((ret = check_job_ret(s, s->numXtiles * s->numYtiles * s->ncomponents)) < 0)
+        return ret;
+    av_log(s->avctx, AV_LOG_DEBUG, "after dwt -> tier1\n");
+    avctx->execute2(avctx, encode_cblk_job, NULL, s->job_ret, s->nb_cblk_jobs);
+    if ((ret = check_job_ret(s, s->nb_cblk_jobs)) < 0)
+        return ret;
+    av_log(s->avctx, AV_LOG_DEBUG, "after tier1\n");
+
     if (s->format == CODEC_JP2) {
         av_assert0(s->buf == pkt->data);
 
@@ -1785,6 +1867,18 @@ static av_cold int j2kenc_init(AVCodecContext *avctx)
     init_quantization(s);
     if ((ret=init_tiles(s)) < 0)
         return ret;
+    if ((ret = init_cblk_jobs(s)) < 0)
+        return ret;
+    s->job_ret = av_calloc(FFMAX(s->numXtiles * s->numYtiles * s->ncomponents,
+                                 s->nb_cblk_jobs), sizeof(*s->job_ret));
+    if (!s->job_ret)
+        return AVERROR(ENOMEM);
+
+    s->t1 = av_calloc(FFMAX(avctx->thread_count, 1), sizeof(*s->t1));
+    if (!s->t1)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < FFMAX(avctx->thread_count, 1); i++)
+        s->t1[i].stride = (1<<codsty->log2_cblk_width) + 2;
 
     av_log(s->avctx, AV_LOG_DEBUG, "after init\n");
 
@@ -1796,6 +1890,9 @@ static int j2kenc_destroy(AVCodecContext *avctx)
     Jpeg2000EncoderContext *s = avctx->priv_data;
 
     cleanup(s);
+    av_freep(&s->cblk_jobs);
+    av_freep(&s->job_ret);
+    av_freep(&s->t1);
     return 0;
 }
 
@@ -1848,6 +1945,7 @@ const AVCodec ff_jpeg2000_encoder = {
         AV_PIX_FMT_RGB48, AV_PIX_FMT_GRAY16,
         AV_PIX_FMT_NONE
     },
+    .capabilities   = AV_CODEC_CAP_SLICE_THREADS | AV_CODEC_CAP_FRAME_THREADS,
     .priv_class     = &j2k_class,
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE | FF_CODEC_CAP_INIT_CLEANUP,
 };
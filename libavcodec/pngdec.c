@@ -21,6 +21,8 @@
 
 //#define DEBUG
 
+#include <stdatomic.h>
+
 #include "libavutil/avassert.h"
 #include "libavutil/bprint.h"
 #include "libavutil/crc.h"
@@ -40,6 +42,9 @@
 
 #include <zlib.h>
 
+/* number of inflated rows buffered between the inflate and unfilter stages */
+#define PNG_ROW_RING 32
+
 enum PNGHeaderState {
     PNG_IHDR = 1 << 0,
     PNG_PLTE = 1 << 1,
@@ -105,7 +110,22 @@ typedef struct PNGDecContext {
     int row_size; /* decompressed row size */
     int pass_row_size; /* decompress row size of the current pass */
     int y;
+    int trns_rows; /* number of rows transparency was already applied to */
     z_stream zstream;
+
+    /* row pipeline used with slice threading */
+    GetByteContext *idat_chunks;
+    unsigned int idat_chunks_allocated;
+    int nb_idat_chunks;
+    uint8_t *row_ring;
+    unsigned int row_ring_size;
+    int row_ring_stride;
+    uint8_t *partial_row;
+    uint8_t *thread_dst;
+    ptrdiff_t thread_dst_stride;
+    atomic_int rows_valid;
+    int thread_ret;
+    int trns_stage; /* whether a job applies transparency behind the unfilter one */
 } PNGDecContext;
 
 /* Mask to determine which pixels are valid in a pass */
@@ -454,6 +474,239 @@ static int png_decode_idat(PNGDecContext *s, GetByteContext *gb,
     return 0;
 }
 
+/* expand one row to the alpha format, bpp is the bpp including alpha */
+static void apply_trns_row(PNGDecContext *s, uint8_t *row, int bpp)
+{
+    size_t byte_depth = s->bit_depth > 8 ? 2 : 1;
+    size_t raw_bpp = bpp - byte_depth;
+    unsigned x;
+
+    if (bpp == 2 && byte_depth == 1) {
+        uint8_t *pixel = &row[2 * s->width - 1];
+        uint8_t *rowp  = &row[1 * s->width - 1];
+        int tcolor = s->transparent_color_be[0];
+        for (x = s->width; x > 0; --x) {
+            *pixel-- = *rowp == tcolor ? 0 : 0xff;
+            *pixel-- = *rowp--;
+        }
+    } else if (bpp == 4 && byte_depth == 1) {
+        uint8_t *pixel = &row[4 * s->width - 1];
+        uint8_t *rowp  = &row[3 * s->width - 1];
+        int tcolor = AV_RL24(s->transparent_color_be);
+        for (x = s->width; x > 0; --x) {
+            *pixel-- = AV_RL24(rowp-2) == tcolor ? 0 : 0xff;
+            *pixel-- = *rowp--;
+            *pixel-- = *rowp--;
+            *pixel-- = *rowp--;
+        }
+    } else {
+        /* since we're updating in-place, we have to go from right to left */
+        for (x = s->width; x > 0; --x) {
+            uint8_t *pixel = &row[bpp * (x - 1)];
+            memmove(pixel, &row[raw_bpp * (x - 1)], raw_bpp);
+
+            if (!memcmp(pixel, s->transparent_color_be, raw_bpp)) {
+                memset(&pixel[raw_bpp], 0, byte_depth);
+            } else {
+                memset(&pixel[raw_bpp], 0xff, byte_depth);
+            }
+        }
+    }
+}
+
+#if HAVE_THREADS
+/*
+ * With slice threading, non-interlaced images are decoded by a pipeline:
+ * the calling thread inflates rows into a ring of PNG_ROW_RING rows, one
+ * worker unfilters them into the frame and, if there are enough threads,
+ * another worker applies the transparency expansion to the finished rows.
+ * The stages are synchronized with the slice thread progress entries:
+ * entries[0] counts released ring slots (starting at PNG_ROW_RING),
+ * entries[1] inflated rows, entries[2] unfiltered rows and entries[3]
+ * expanded rows.
+ */
+static int png_collect_idat_chunks(AVCodecContext *avctx, PNGDecContext *s,
+                                   GetByteContext *gb)
+{
+    const AVCRC *crc_tab = av_crc_get_table(AV_CRC_32_IEEE_LE);
+    GetByteContext next = *gb;
+
+    s->nb_idat_chunks = 0;
+    for (;;) {
+        GetByteContext *chunks;
+        uint32_t length;
+
+        chunks = av_fast_realloc(s->idat_chunks, &s->idat_chunks_allocated,
+                                 (s->nb_idat_chunks + 1) * sizeof(*chunks));
+        if (!chunks)
+            return AVERROR(ENOMEM);
+        s->idat_chunks = chunks;
+        chunks[s->nb_idat_chunks++] = next;
+
+        /* IDAT chunks must be consecutive, gather all of them so that the
+         * inflate stage never has to return to the chunk parser */
+        if (bytestream2_get_bytes_left(&s->gb) < 12)
+            break;
+        length = AV_RB32(s->gb.buffer);
+        if (AV_RL32(s->gb.buffer + 4) != MKTAG('I', 'D', 'A', 'T') ||
+            length > 0x7fffffff || length + 12 > bytestream2_get_bytes_left(&s->gb))
+            break;
+        /* leave chunks with a broken CRC to the regular chunk loop */
+        if (avctx->err_recognition & (AV_EF_CRCCHECK | AV_EF_IGNORE_ERR)) {
+            uint32_t crc_sig = AV_RB32(s->gb.buffer + length + 8);
+            uint32_t crc_cal = ~av_crc(crc_tab, UINT32_MAX, s->gb.buffer + 4, length + 4);
+            if (crc_sig ^ crc_cal)
+                break;
+        }
+        if (avctx->debug & FF_DEBUG_STARTCODE)
+            av_log(avctx, AV_LOG_DEBUG, "png: tag=IDAT length=%u\n", length);
+
+        bytestream2_init(&next, s->gb.buffer + 8, length);
+        bytestream2_skip(&s->gb, length + 12);
+    }
+
+    return 0;
+}
+
+static int png_inflate_rows(AVCodecContext *avctx)
+{
+    PNGDecContext *s = avctx->priv_data;
+    uint8_t *crow = NULL;
+    int y = 0, i, ret;
+
+    for (i = 0; i < s->nb_idat_chunks && y < s->cur_h; i++) {
+        s->zstream.avail_in = bytestream2_get_bytes_left(&s->idat_chunks[i]);
+        s->zstream.next_in  = s->idat_chunks[i].buffer;
+
+        while (s->zstream.avail_in > 0 && y < s->cur_h) {
+            if (!crow) {
+                /* wait for the unfilter stage to release a ring slot */
+                ff_thread_await_progress2(avctx, 1, 1, 1);
+                crow = s->row_ring + (y % PNG_ROW_RING) * s->row_ring_stride + 15;
+                s->zstream.avail_out = s->crow_size;
+                s->zstream.next_out  = crow;
+            }
+            ret = inflate(&s->zstream, Z_PARTIAL_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END) {
+                av_log(avctx, AV_LOG_ERROR, "inflate returned error %d\n", ret);
+                s->thread_ret = AVERROR_EXTERNAL;
+                goto end;
+            }
+            if (s->zstream.avail_out == 0) {
+                ff_thread_report_progress2(avctx, 1, 1, 1);
+                crow = NULL;
+                y++;
+            }
+            if (ret == Z_STREAM_END && s->zstream.avail_in > 0) {
+                av_log(avctx, AV_LOG_WARNING,
+                       "%d undecompressed bytes left in buffer\n", s->zstream.avail_in);
+                goto end;
+            }
+        }
+    }
+
+end:
+    s->partial_row = crow;
+    if (y < s->cur_h) {
+        /* release the workers waiting for rows that will never come */
+        atomic_store(&s->rows_valid, y);
+        ff_thread_report_progress2(avctx, 1, 1, s->cur_h - y);
+    }
+    return 0;
+}
+
+static int png_filter_rows(AVCodecContext *avctx, void *arg,
+                           int jobnr, int threadnr)
+{
+    PNGDecContext *s = avctx->priv_data;
+    int byte_depth = s->bit_depth > 8 ? 2 : 1;
+    uint8_t *ptr = s->thread_dst + s->thread_dst_stride * s->y_offset +
+                   s->x_offset * s->bpp;
+    int y;
+
+    for (y = 0; y < s->cur_h; y++, ptr += s->thread_dst_stride) {
+        if (!jobnr) {
+            ff_thread_await_progress2(avctx, 2, 2, 1);
+            if (y < atomic_load(&s->rows_valid)) {
+                uint8_t *crow = s->row_ring + (y % PNG_ROW_RING) * s->row_ring_stride + 15;
+                ff_png_filter_row(&s->dsp, ptr, crow[0], crow + 1,
+                                  y ? ptr - s->thread_dst_stride : s->last_row,
+                                  s->row_size, s->bpp);
+            }
+            ff_thread_report_progress2(avctx, 0, 0, 1);
+            /* wake the expansion stage; the third progress mutex only
+             * exists with three threads or more */
+            ff_thread_report_progress2(avctx, 2, s->trns_stage ? 2 : 1, 1);
+        } else {
+            int rows_valid;
+
+            /* the next row still uses this one as its top neighbour */
+            ff_thread_await_progress2(avctx, 3, 3, y < s->cur_h - 1 ? 2 : 1);
+            /* after a partial decode, the regular path unfilters the next
+             * row against the last valid one, so leave that one unexpanded */
+            rows_valid = atomic_load(&s->rows_valid);
+            if (y < rows_valid - (rows_valid < s->cur_h))
+                apply_trns_row(s, ptr, s->bpp + byte_depth);
+            ff_thread_report_progress2(avctx, 3, 2, 1);
+        }
+    }
+
+    return 0;
+}
+
+static int png_decode_idat_threaded(AVCodecContext *avctx, PNGDecContext *s,
+                                    GetByteContext *gb, AVFrame *p)
+{
+    int nb_jobs = 1, ret;
+
+    if ((ret = png_collect_idat_chunks(avctx, s, gb)) < 0)
+        return ret;
+
+    /* keep crow + 1 16-byte aligned for the dsp functions */
+    s->row_ring_stride = FFALIGN(s->row_size, 16) + 16;
+    av_fast_padded_malloc(&s->row_ring, &s->row_ring_size,
+                          PNG_ROW_RING * s->row_ring_stride);
+    if (!s->row_ring)
+        return AVERROR(ENOMEM);
+
+    if ((ret = ff_alloc_entries(avctx, 4)) < 0)
+        return ret;
+    ff_thread_report_progress2(avctx, 0, 0, PNG_ROW_RING);
+
+    s->thread_dst        = p->data[0];
+    s->thread_dst_stride = p->linesize[0];
+    s->partial_row       = NULL;
+    s->thread_ret        = 0;
+    atomic_init(&s->rows_valid, s->cur_h);
+
+    /* the expansion stage waits on a third progress mutex */
+    s->trns_stage = s->has_trns && s->color_type != PNG_COLOR_TYPE_PALETTE &&
+                    avctx->thread_count > 2;
+    if (s->trns_stage)
+        nb_jobs = 2;
+
+    ff_slice_thread_execute_with_mainfunc(avctx, png_filter_rows,
+                                          png_inflate_rows, NULL, NULL, nb_jobs);
+
+    s->y = atomic_load(&s->rows_valid);
+    if (s->trns_stage)
+        s->trns_rows = s->y < s->cur_h ? FFMAX(s->y - 1, 0) : s->y;
+    if (s->y == s->cur_h) {
+        s->pic_state |= PNG_ALLIMAGE;
+    } else if (s->partial_row) {
+        /* let the regular path finish the row if more IDAT chunks follow */
+        int size = s->crow_size - s->zstream.avail_out;
+        memcpy(s->crow_buf, s->partial_row, size);
+        s->zstream.next_out = s->crow_buf + size;
+    } else {
+        s->zstream.avail_out = s->crow_size;
+        s->zstream.next_out  = s->crow_buf;
+    }
+
+    return s->thread_ret;
+}
+#endif
+
 static int decode_zbuf(AVBPrint *bp, const uint8_t *data,
                        const uint8_t *data_end)
 {
@@ -639,14 +892,14 @@ static int decode_phys_chunk(AVCodecContext *avctx, PNGDecContext *s,
 static int decode_idat_chunk(AVCodecContext *avctx, PNGDecContext *s,
                              GetByteContext *gb, AVFrame *p)
 {
-    int ret;
+    int ret, first_idat = !(s->pic_state & PNG_IDAT);
     size_t byte_depth = s->bit_depth > 8 ? 2 : 1;
 
     if (!(s->hdr_state & PNG_IHDR)) {
         av_log(avctx, AV_LOG_ERROR, "IDAT without IHDR\n");
         return AVERROR_INVALIDDATA;
     }
-    if (!(s->pic_state & PNG_IDAT)) {
+    if (first_idat) {
         /* init image info */
         ret = ff_set_dimensions(avctx, s->width, s->height);
         if (ret < 0)
@@ -775,6 +1028,12 @@ static int decode_idat_chunk(AVCodecContext *avctx, PNGDecContext *s,
     if (s->has_trns && s->color_type != PNG_COLOR_TYPE_PALETTE)
         s->bpp -= byte_depth;
 
+#if HAVE_THREADS
+    if (first_idat && avctx->active_thread_type & FF_THREAD_SLICE &&
+        !s->interlace_type && s->filter_type != PNG_FILTER_TYPE_LOCO)
+        ret = png_decode_idat_threaded(avctx, s, gb, p);
+    else
+#endif
     ret = png_decode_idat(s, gb, p->data[0], p->linesize[0]);
 
     if (s->has_trns && s->color_type != PNG_COLOR_TYPE_PALETTE)
@@ -1188,6 +1447,8 @@ static int decode_frame_common(AVCodecContext *avctx, PNGDecContext *s,
     int decode_next_dat = 0;
     int i, ret;
 
+    s->trns_rows = 0;
+
     for (;;) {
         GetByteContext gb_chunk;
 
@@ -1370,47 +1631,12 @@ exit_loop:
 
     /* apply transparency if needed */
     if (s->has_trns && s->color_type != PNG_COLOR_TYPE_PALETTE) {
-        size_t byte_depth = s->bit_depth > 8 ? 2 : 1;
-        size_t raw_bpp = s->bpp - byte_depth;
-        unsigned x, y;
+        unsigned y;
 
         av_assert0(s->bit_depth > 1);
 
-        for (y = 0; y < s->height; ++y) {
-            uint8_t *row = &p->data[0][p->linesize[0] * y];
-
-            if (s->bpp == 2 && byte_depth == 1) {
-                uint8_t *pixel = &row[2 * s->width - 1];
-                uint8_t *rowp  = &row[1 * s->width - 1];
-                int tcolor = s->transparent_color_be[0];
-                for (x = s->width; x > 0; --x) {
-                    *pixel-- = *rowp == tcolor ? 0 : 0xff;
-                    *pixel-- = *rowp--;
-                }
-            } else if (s->bpp == 4 && byte_depth == 1) {
-                uint8_t *pixel = &row[4 * s->width - 1];
-                uint8_t *rowp  = &row[3 * s->width - 1];
-                int tcolor = AV_RL24(s->transparent_color_be);
-                for (x = s->width; x > 0; --x) {
-                    *pixel-- = AV_RL24(rowp-2) == tcolor ? 0 : 0xff;
-                    *pixel-- = *rowp--;
-                    *pixel-- = *rowp--;
-                    *pixel-- = *rowp--;
-                }
-            } else {
-                /* since we're updating in-place, we have to go from right to left */
-                for (x = s->width; x > 0; --x) {
-                    uint8_t *pixel = &row[s->bpp * (x - 1)];
-                    memmove(pixel, &row[raw_bpp * (x - 1)], raw_bpp);
-
-                    if (!memcmp(pixel, s->transparent_color_be, raw_bpp)) {
-                        memset(&pixel[raw_bpp], 0, byte_depth);
-                    } else {
-                        memset(&pixel[raw_bpp], 0xff, byte_depth);
-                    }
-                }
-            }
-        }
+        for (y = s->trns_rows; y < s->height; ++y)
+            apply_trns_row(s, &p->data[0][p->linesize[0] * y], s->bpp);
     }
 
     /* handle P-frames only if a predecessor frame is available */
@@ -1720,6 +1946,10 @@ static av_cold int png_dec_end(AVCodecContext *avctx)
     s->last_row_size = 0;
     av_freep(&s->tmp_row);
     s->tmp_row_size = 0;
+    av_freep(&s->idat_chunks);
+    s->idat_chunks_allocated = 0;
+    av_freep(&s->row_ring);
+    s->row_ring_size = 0;
     av_freep(&s->background_buf);
 
     av_freep(&s->iccp_data);
@@ -1756,8 +1986,10 @@ const AVCodec ff_png_decoder = {
     .close          = png_dec_end,
     .decode         = decode_frame_png,
     .update_thread_context = ONLY_IF_THREADS_ENABLED(update_thread_context),
-    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS /*| AV_CODEC_CAP_DRAW_HORIZ_BAND*/,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS |
+                      AV_CODEC_CAP_SLICE_THREADS /*| AV_CODEC_CAP_DRAW_HORIZ_BAND*/,
     .caps_internal  = FF_CODEC_CAP_SKIP_FRAME_FILL_PARAM | FF_CODEC_CAP_INIT_THREADSAFE |
-                      FF_CODEC_CAP_ALLOCATE_PROGRESS | FF_CODEC_CAP_INIT_CLEANUP,
+                      FF_CODEC_CAP_ALLOCATE_PROGRESS | FF_CODEC_CAP_INIT_CLEANUP |
+                      FF_CODEC_CAP_SLICE_THREAD_HAS_MF,
 };
 #endif
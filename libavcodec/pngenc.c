@@ -37,6 +37,9 @@
 #include <zlib.h>
 
 #define IOBUF_SIZE 4096
+/* minimum amount of filtered data deflated by one slice job */
+#define DEFLATE_CHUNK_SIZE (256 * 1024)
+#define DEFLATE_DICT_SIZE  (32 * 1024)
 
 typedef struct APNGFctlChunk {
     uint32_t sequence_number;
@@ -46,6 +49,23 @@ typedef struct APNGFctlChunk {
     uint8_t dispose_op, blend_op;
 } APNGFctlChunk;
 
+typedef struct PNGDeflateThread {
+    z_stream zstream;
+    int zstream_inited;
+    uint8_t *crow_base;          ///< filter scratch buffer
+    unsigned int crow_base_size;
+    uint8_t *filtered;           ///< filtered rows of the current chunk and its dictionary
+    unsigned int filtered_size;
+} PNGDeflateThread;
+
+typedef struct PNGDeflateChunk {
+    uint8_t *out;
+    unsigned int out_size;
+    int out_len;
+    uLong adler;
+    int ret;
+} PNGDeflateChunk;
+
 typedef struct PNGEncContext {
     AVClass *class;
     LLVidEncDSPContext llvidencdsp;
@@ -57,6 +77,7 @@ typedef struct PNGEncContext {
     int filter_type;
 
     z_stream zstream;
+    int compression_level;
     uint8_t buf[IOBUF_SIZE];
     int dpi;                     ///< Physical pixel density, in dots per inch, if set
     int dpm;                     ///< Physical pixel density, in dots per meter, if set
@@ -78,6 +99,16 @@ typedef struct PNGEncContext {
     APNGFctlChunk last_frame_fctl;
     uint8_t *last_frame_packet;
     size_t last_frame_packet_size;
+
+    // slice threaded deflate
+    PNGDeflateThread *threads;   ///< z_streams must not move, allocated once
+    int nb_threads;
+    PNGDeflateChunk *chunks;
+    unsigned int chunks_size;
+    const AVFrame *cur_frame;
+    int row_size;
+    int chunk_rows;
+    int nb_chunks;
 } PNGEncContext;
 
 static void png_get_interlaced_row(uint8_t *dst, int row_size,
@@ -192,6 +223,23 @@ static void png_filter_row(PNGEncContext *c, uint8_t *dst, int filter_type,
     }
 }
 
+/* sum of absolute values of the filtered row, stops once limit is reached */
+static int png_filter_cost(const uint8_t *buf, int size, int limit)
+{
+    int i = 0, j, cost = 0;
+
+    /* only check the limit every 64 bytes */
+    for (; i + 64 <= size; i += 64) {
+        for (j = 0; j < 64; j++)
+            cost += abs((int8_t) buf[i + j]);
+        if (cost >= limit)
+            return cost;
+    }
+    for (; i < size; i++)
+        cost += abs((int8_t) buf[i]);
+    return cost;
+}
+
 static uint8_t *png_choose_filter(PNGEncContext *s, uint8_t *dst,
                                   uint8_t *src, uint8_t *top, int size, int bpp)
 {
@@ -200,15 +248,12 @@ static uint8_t *png_choose_filter(PNGEncContext *s, uint8_t *dst,
     if (!top && pred)
         pred = PNG_FILTER_VALUE_SUB;
     if (pred == PNG_FILTER_VALUE_MIXED) {
-        int i;
         int cost, bcost = INT_MAX;
         uint8_t *buf1 = dst, *buf2 = dst + size + 16;
         for (pred = 0; pred < 5; pred++) {
             png_filter_row(s, buf1 + 1, pred, src, top, size, bpp);
             buf1[0] = pred;
-            cost = 0;
-            for (i = 0; i <= size; i++)
-                cost += abs((int8_t) buf1[i]);
+            cost = png_filter_cost(buf1, size + 1, bcost);
             if (cost < bcost) {
                 bcost = cost;
                 FFSWAP(uint8_t *, buf1, buf2);
@@ -429,6 +474,166 @@ static int encode_headers(AVCodecContext *avctx, const AVFrame *pict)
     return 0;
 }
 
+/*
+ * Filter and deflate one chunk of rows as a raw deflate stream primed with
+ * the filtered tail of the previous chunk, pigz style. The filter only
+ * depends on the source rows, so the rows making up the dictionary are
+ * filtered again here rather than kept from the previous chunk. All but
+ * the last chunk end with a sync flush, so the concatenated chunks form a
+ * single stream.
+ */
+static int png_deflate_rows(AVCodecContext *avctx, void *arg,
+                            int jobnr, int threadnr)
+{
+    PNGEncContext *s    = avctx->priv_data;
+    PNGDeflateThread *t = &s->threads[threadnr];
+    PNGDeflateChunk *c  = &s->chunks[jobnr];
+    const AVFrame *p    = s->cur_frame;
+    size_t stride       = s->row_size + 1;
+    int y_start         = jobnr * s->chunk_rows;
+    int y_end           = FFMIN(y_start + s->chunk_rows, p->height);
+    int dict_rows       = FFMIN(y_start, (DEFLATE_DICT_SIZE + stride - 1) / stride);
+    int flush           = jobnr == s->nb_chunks - 1 ? Z_FINISH : Z_SYNC_FLUSH;
+    const uint8_t *src;
+    size_t len;
+    int y, ret;
+
+    av_fast_malloc(&t->crow_base, &t->crow_base_size,
+                   (s->row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
+    av_fast_malloc(&t->filtered, &t->filtered_size,
+                   (s->chunk_rows + dict_rows) * stride);
+    if (!t->crow_base || !t->filtered)
+        return c->ret = AVERROR(ENOMEM);
+
+    for (y = y_start - dict_rows; y < y_end; y++) {
+        uint8_t *ptr = p->data[0] + y * p->linesize[0];
+        uint8_t *top = y ? ptr - p->linesize[0] : NULL;
+        uint8_t *crow = png_choose_filter(s, t->crow_base + 15, ptr, top,
+                                          s->row_size, s->bits_per_pixel >> 3);
+        memcpy(t->filtered + (y - y_start + dict_rows) * stride, crow, stride);
+    }
+    src = t->filtered + dict_rows * stride;
+    len = (y_end - y_start) * stride;
+
+    deflateReset(&t->zstream);
+    if (dict_rows) {
+        size_t dict_len = FFMIN(dict_rows * stride, DEFLATE_DICT_SIZE);
+        deflateSetDictionary(&t->zstream, src - dict_len, dict_len);
+    }
+    c->adler = adler32(adler32(0, Z_NULL, 0), src, len);
+
+    c->out_len           = 0;
+    t->zstream.next_in   = src;
+    t->zstream.avail_in  = len;
+    for (;;) {
+        if (c->out_size - c->out_len < IOBUF_SIZE) {
+            uint8_t *out = av_fast_realloc(c->out, &c->out_size,
+                                           FFMAX(c->out_size, len / 2) + IOBUF_SIZE);
+            if (!out)
+                return c->ret = AVERROR(ENOMEM);
+            c->out = out;
+        }
+        t->zstream.next_out  = c->out + c->out_len;
+        t->zstream.avail_out = c->out_size - c->out_len;
+        ret = deflate(&t->zstream, flush);
+        c->out_len = c->out_size - t->zstream.avail_out;
+        if (ret == Z_STREAM_END)
+            break;
+        if (ret != Z_OK)
+            return c->ret = AVERROR_EXTERNAL;
+        /* a sync flush is complete once deflate leaves output space unused */
+        if (flush == Z_SYNC_FLUSH && t->zstream.avail_out)
+            break;
+    }
+
+    return c->ret = 0;
+}
+
+static void png_write_image_data_buffered(AVCodecContext *avctx, int *buf_len,
+                                          const uint8_t *data, int size)
+{
+    PNGEncContext *s = avctx->priv_data;
+
+    while (size > 0) {
+        int len = FFMIN(size, IOBUF_SIZE - *buf_len);
+        memcpy(s->buf + *buf_len, data, len);
+        *buf_len += len;
+        data     += len;
+        size     -= len;
+        if (*buf_len == IOBUF_SIZE) {
+            if (s->bytestream_end - s->bytestream > IOBUF_SIZE + 100)
+                png_write_image_data(avctx, s->buf, IOBUF_SIZE);
+            *buf_len = 0;
+        }
+    }
+}
+
+static int encode_frame_threaded(AVCodecContext *avctx, const AVFrame *pict)
+{
+    PNGEncContext *s = avctx->priv_data;
+    int level = s->compression_level == Z_DEFAULT_COMPRESSION ? 6 : s->compression_level;
+    uLong adler = adler32(0, Z_NULL, 0);
+    uint8_t header[2], trailer[4];
+    int i, buf_len = 0;
+
+    if (!s->threads) {
+        s->threads = av_calloc(FFMAX(avctx->thread_count, 1), sizeof(*s->threads));
+        if (!s->threads)
+            return AVERROR(ENOMEM);
+        s->nb_threads = FFMAX(avctx->thread_count, 1);
+    }
+    for (i = 0; i < s->nb_threads; i++) {
+        PNGDeflateThread *t = &s->threads[i];
+        if (t->zstream_inited)
+            continue;
+        t->zstream.zalloc = ff_png_zalloc;
+        t->zstream.zfree  = ff_png_zfree;
+        t->zstream.opaque = NULL;
+        if (deflateInit2(&t->zstream, s->compression_level, Z_DEFLATED,
+                         -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            return AVERROR_EXTERNAL;
+        t->zstream_inited = 1;
+    }
+
+    if (s->nb_chunks > s->chunks_size / sizeof(*s->chunks)) {
+        unsigned int size = s->chunks_size;
+        PNGDeflateChunk *chunks = av_fast_realloc(s->chunks, &size,
+                                                  s->nb_chunks * sizeof(*chunks));
+        if (!chunks)
+            return AVERROR(ENOMEM);
+        memset((uint8_t *)chunks + s->chunks_size, 0, size - s->chunks_size);
+        s->chunks      = chunks;
+        s->chunks_size = size;
+    }
+
+    s->cur_frame = pict;
+    avctx->execute2(avctx, png_deflate_rows, NULL, NULL, s->nb_chunks);
+    s->cur_frame = NULL;
+
+    /* zlib header matching what deflateInit() would have written */
+    header[0] = 0x78;
+    header[1] = (level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6;
+    header[1] += 31 - ((header[0] << 8) + header[1]) % 31;
+    png_write_image_data_buffered(avctx, &buf_len, header, 2);
+
+    for (i = 0; i < s->nb_chunks; i++) {
+        PNGDeflateChunk *c = &s->chunks[i];
+        int y_start = i * s->chunk_rows;
+        int rows    = FFMIN(s->chunk_rows, pict->height - y_start);
+        if (c->ret < 0)
+            return c->ret;
+        png_write_image_data_buffered(avctx, &buf_len, c->out, c->out_len);
+        adler = adler32_combine(adler, c->adler, rows * (z_off_t)(s->row_size + 1));
+    }
+
+    AV_WB32(trailer, adler);
+    png_write_image_data_buffered(avctx, &buf_len, trailer, 4);
+    if (buf_len > 0 && s->bytestream_end - s->bytestream > buf_len + 100)
+        png_write_image_data(avctx, s->buf, buf_len);
+
+    return 0;
+}
+
 static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
 {
     PNGEncContext *s       = avctx->priv_data;
@@ -442,6 +647,14 @@ static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
 
     row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
 
+    if (avctx->active_thread_type & FF_THREAD_SLICE && !s->is_progressive) {
+        s->row_size   = row_size;
+        s->chunk_rows = FFMAX(DEFLATE_CHUNK_SIZE / (row_size + 1), 1);
+        s->nb_chunks  = (pict->height + s->chunk_rows - 1) / s->chunk_rows;
+        if (s->nb_chunks > 1)
+            return encode_frame_threaded(avctx, pict);
+    }
+
     crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
     if (!crow_base) {
         ret = AVERROR(ENOMEM);
@@ -1073,6 +1286,7 @@ static av_cold int png_enc_init(AVCodecContext *avctx)
     compression_level = avctx->compression_level == FF_COMPRESSION_DEFAULT
                       ? Z_DEFAULT_COMPRESSION
                       : av_clip(avctx->compression_level, 0, 9);
+    s->compression_level = compression_level;
     if (deflateInit2(&s->zstream, compression_level, Z_DEFLATED, 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
         return -1;
 
@@ -1084,6 +1298,19 @@ static av_cold int png_enc_close(AVCodecContext *avctx)
     PNGEncContext *s = avctx->priv_data;
 
     deflateEnd(&s->zstream);
+    for (int i = 0; i < s->nb_threads; i++) {
+        PNGDeflateThread *t = &s->threads[i];
+        if (t->zstream_inited)
+            deflateEnd(&t->zstream);
+        av_freep(&t->crow_base);
+        av_freep(&t->filtered);
+    }
+    av_freep(&s->threads);
+    s->nb_threads = 0;
+    for (int i = 0; i < s->chunks_size / sizeof(*s->chunks); i++)
+        av_freep(&s->chunks[i].out);
+    av_freep(&s->chunks);
+    s->chunks_size = 0;
     av_frame_free(&s->last_frame);
     av_frame_free(&s->prev_frame);
     av_freep(&s->last_frame_packet);
@@ -1123,7 +1350,7 @@ const AVCodec ff_png_encoder = {
     .init           = png_enc_init,
     .close          = png_enc_close,
     .encode2        = encode_png,
-    .capabilities   = AV_CODEC_CAP_FRAME_THREADS,
+    .capabilities   = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS,
     .pix_fmts       = (const enum AVPixelFormat[]) {
         AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA,
         AV_PIX_FMT_RGB48BE, AV_PIX_FMT_RGBA64BE,
@@ -1141,7 +1368,8 @@ const AVCodec ff_apng_encoder = {
     .long_name      = NULL_IF_CONFIG_SMALL("APNG (Animated Portable Network Graphics) image"),
     .type           = AVMEDIA_TYPE_VIDEO,
     .id             = AV_CODEC_ID_APNG,
-    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .priv_data_size = sizeof(PNGEncContext),
     .init           = png_enc_init,
     .close          = png_enc_close,
@@ -52,6 +52,11 @@ enum {
     PRORES_PROFILE_4444XQ,
 };
 
+enum {
+    QUANT_SEARCH_TRELLIS = 0,
+    QUANT_SEARCH_FAST,
+};
+
 enum {
     QUANT_MAT_PROXY = 0,
     QUANT_MAT_PROXY_CHROMA,
@@ -260,6 +265,7 @@ typedef struct ProresContext {
 
     char *vendor;
     int quant_sel;
+    int quant_search;
 
     int frame_size_upper_bound;
 
@@ -788,6 +794,118 @@ static int estimate_alpha_plane(ProresContext *ctx,
     return bits;
 }
 
+static int estimate_slice_quant(ProresContext *ctx, int q, int *error,
+                                const uint16_t *src, const int *linesize,
+                                int mbs_per_slice, const int *num_cblocks,
+                                const int *plane_factor, int alpha_bits,
+                                ProresThreadData *td)
+{
+    int16_t *qmat, *qmat_chroma;
+    int i, bits = alpha_bits;
+
+    if (q < MAX_STORED_Q) {
+        qmat        = ctx->quants[q];
+        qmat_chroma = ctx->quants_chroma[q];
+    } else {
+        qmat        = td->custom_q;
+        qmat_chroma = td->custom_chroma_q;
+        for (i = 0; i < 64; i++) {
+            qmat[i]        = ctx->quant_mat[i] * q;
+            qmat_chroma[i] = ctx->quant_chroma_mat[i] * q;
+        }
+    }
+
+    *error = 0;
+    bits += estimate_slice_plane(ctx, error, 0,
+                                 src, linesize[0],
+                                 mbs_per_slice,
+                                 num_cblocks[0], plane_factor[0],
+                                 qmat, td); /* estimate luma plane */
+    for (i = 1; i < ctx->num_planes - !!ctx->alpha_bits; i++) { /* estimate chroma plane */
+        bits += estimate_slice_plane(ctx, error, i,
+                                     src, linesize[i],
+                                     mbs_per_slice,
+                                     num_cblocks[i], plane_factor[i],
+                                     qmat_chroma, td);
+    }
+
+    return bits;
+}
+
+/**
+ * Fast quantiser search: only the quantiser range end points are estimated,
+ * the inner ones are interpolated assuming bits and error scale with 1/q,
+ * and the overquantiser is found by bisection instead of a linear scan.
+ */
+static int find_slice_quant_fast(ProresContext *ctx, int *slice_bits,
+                                 int *slice_score, const uint16_t *src,
+                                 const int *linesize, int mbs_per_slice,
+                                 const int *num_cblocks, const int *plane_factor,
+                                 int alpha_bits, ProresThreadData *td)
+{
+    const int min_quant = ctx->profile_info->min_quant;
+    const int max_quant = ctx->profile_info->max_quant;
+    const int limit     = ctx->bits_per_mb * mbs_per_slice;
+    int q, lo, hi, bits, error;
+
+    slice_bits[min_quant] = estimate_slice_quant(ctx, min_quant, &slice_score[min_quant],
+                                                 src, linesize, mbs_per_slice,
+                                                 num_cblocks, plane_factor,
+                                                 alpha_bits, td);
+    slice_bits[max_quant] = estimate_slice_quant(ctx, max_quant, &slice_score[max_quant],
+                                                 src, linesize, mbs_per_slice,
+                                                 num_cblocks, plane_factor,
+                                                 alpha_bits, td);
+    for (q = min_quant + 1; q < max_quant; q++) {
+        int64_t num = (int64_t)(max_quant - q) * min_quant;
+        int64_t den = (int64_t)(max_quant - min_quant) * q;
+
+        slice_bits[q]  = slice_bits[max_quant] +
+                         (slice_bits[min_quant] - slice_bits[max_quant]) * num / den;
+        slice_score[q] = slice_score[max_quant] +
+                         (slice_score[min_quant] - slice_score[max_quant]) * num / den;
+    }
+    for (q = min_quant; q <= max_quant; q++)
+        if (slice_bits[q] > 65000 * 8)
+            slice_score[q] = SCORE_LIMIT;
+
+    if (slice_bits[max_quant] <= limit) {
+        slice_bits[max_quant + 1]  = slice_bits[max_quant];
+        slice_score[max_quant + 1] = slice_score[max_quant] + 1;
+        return max_quant;
+    }
+
+    /* same result as the linear scan as long as bits decrease with q */
+    hi   = 127;
+    bits = estimate_slice_quant(ctx, hi, &error, src, linesize, mbs_per_slice,
+                                num_cblocks, plane_factor, alpha_bits, td);
+    if (bits > limit) {
+        hi = 128;
+    } else {
+        lo = max_quant + 1;
+        slice_bits[max_quant + 1]  = bits;
+        slice_score[max_quant + 1] = error;
+        while (lo < hi) {
+            int mid = (lo + hi) >> 1;
+            bits = estimate_slice_quant(ctx, mid, &error, src, linesize,
+                                        mbs_per_slice, num_cblocks,
+                                        plane_factor, alpha_bits, td);
+            if (bits <= limit) {
+                hi = mid;
+                slice_bits[max_quant + 1]  = bits;
+                slice_score[max_quant + 1] = error;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        return hi;
+    }
+
+    slice_bits[max_quant + 1]  = bits;
+    slice_score[max_quant + 1] = error;
+    return hi;
+}
+
 static int find_slice_quant(AVCodecContext *avctx,
                             int trellis_node, int x, int y, int mbs_per_slice,
                             ProresThreadData *td)
@@ -804,8 +922,6 @@ static int find_slice_quant(AVCodecContext *avctx,
     int mbs, prev, cur, new_score;
     int slice_bits[TRELLIS_WIDTH], slice_score[TRELLIS_WIDTH];
     int overquant;
-    uint16_t *qmat;
-    uint16_t *qmat_chroma;
     int linesize[4], line_add;
     int alpha_bits = 0;
 
@@ -857,65 +973,39 @@ static int find_slice_quant(AVCodecContext *avctx,
         alpha_bits = estimate_alpha_plane(ctx, src, linesize[3],
                                           mbs_per_slice, td->blocks[3]);
     // todo: maybe perform coarser quantising to fit into frame size when needed
-    for (q = min_quant; q <= max_quant; q++) {
-        bits  = alpha_bits;
-        error = 0;
-        bits += estimate_slice_plane(ctx, &error, 0,
-                                     src, linesize[0],
-                                     mbs_per_slice,
-                                     num_cblocks[0], plane_factor[0],
-                                     ctx->quants[q], td); /* estimate luma plane */
-        for (i = 1; i < ctx->num_planes - !!ctx->alpha_bits; i++) { /* estimate chroma plane */
-            bits += estimate_slice_plane(ctx, &error, i,
-                                         src, linesize[i],
-                                         mbs_per_slice,
-                                         num_cblocks[i], plane_factor[i],
-                                         ctx->quants_chroma[q], td);
-        }
-        if (bits > 65000 * 8)
-            error = SCORE_LIMIT;
-
-        slice_bits[q]  = bits;
-        slice_score[q] = error;
-    }
-    if (slice_bits[max_quant] <= ctx->bits_per_mb * mbs_per_slice) {
-        slice_bits[max_quant + 1]  = slice_bits[max_quant];
-        slice_score[max_quant + 1] = slice_score[max_quant] + 1;
-        overquant = max_quant;
+    if (ctx->quant_search == QUANT_SEARCH_FAST) {
+        overquant = find_slice_quant_fast(ctx, slice_bits, slice_score,
+                                          src, linesize, mbs_per_slice,
+                                          num_cblocks, plane_factor,
+                                          alpha_bits, td);
     } else {
-        for (q = max_quant + 1; q < 128; q++) {
-            bits  = alpha_bits;
-            error = 0;
-            if (q < MAX_STORED_Q) {
-                qmat = ctx->quants[q];
-                qmat_chroma = ctx->quants_chroma[q];
-            } else {
-                qmat = td->custom_q;
-                qmat_chroma = td->custom_chroma_q;
-                for (i = 0; i < 64; i++) {
-                    qmat[i] = ctx->quant_mat[i] * q;
-                    qmat_chroma[i] = ctx->quant_chroma_mat[i] * q;
-                }
-            }
-            bits += estimate_slice_plane(ctx, &error, 0,
-                                         src, linesize[0],
-                                         mbs_per_slice,
-                                         num_cblocks[0], plane_factor[0],
-                                         qmat, td);/* estimate luma plane */
-            for (i = 1; i < ctx->num_planes - !!ctx->alpha_bits; i++) { /* estimate chroma plane */
-                bits += estimate_slice_plane(ctx, &error, i,
-                                             src, linesize[i],
-                                             mbs_per_slice,
-                                             num_cblocks[i], plane_factor[i],
-                                             qmat_chroma, td);
-            }
-            if (bits <= ctx->bits_per_mb * mbs_per_slice)
-                break;
+        for (q = min_quant; q <= max_quant; q++) {
+            bits = estimate_slice_quant(ctx, q, &error, src, linesize,
+                                        mbs_per_slice, num_cblocks,
+                                        plane_factor, alpha_bits, td);
+            if (bits > 65000 * 8)
+                error = SCORE_LIMIT;
+
+            slice_bits[q]  = bits;
+            slice_score[q] = error;
         }
+        if (slice_bits[max_quant] <= ctx->bits_per_mb * mbs_per_slice) {
+            slice_bits[max_quant + 1]  = slice_bits[max_quant];
+            slice_score[max_quant + 1] = slice_score[max_quant] + 1;
+            overquant = max_quant;
+        } else {
+            for (q = max_quant + 1; q < 128; q++) {
+                bits = estimate_slice_quant(ctx, q, &error, src, linesize,
+                                            mbs_per_slice, num_cblocks,
+                                            plane_factor, alpha_bits, td);
+                if (bits <= ctx->bits_per_mb * mbs_per_slice)
+                    break;
+            }
 
-        slice_bits[max_quant + 1]  = bits;
-        slice_score[max_quant + 1] = error;
-        overquant = q;
+            slice_bits[max_quant + 1]  = bits;
+            slice_score[max_quant + 1] = error;
+            overquant = q;
+        }
     }
     td->nodes[trellis_node + max_quant + 1].quant = overquant;
 
@@ -1383,6 +1473,12 @@ static const AVOption options[] = {
         0, 0, VE, "quant_mat" },
     { "alpha_bits", "bits for alpha plane", OFFSET(alpha_bits), AV_OPT_TYPE_INT,
         { .i64 = 16 }, 0, 16, VE },
+    { "quant_search", "quantiser search method", OFFSET(quant_search), AV_OPT_TYPE_INT,
+        { .i64 = QUANT_SEARCH_TRELLIS }, QUANT_SEARCH_TRELLIS, QUANT_SEARCH_FAST, VE, "quant_search" },
+    { "trellis",       "estimate every quantiser", 0, AV_OPT_TYPE_CONST, { .i64 = QUANT_SEARCH_TRELLIS },
+        0, 0, VE, "quant_search" },
+    { "fast",          "interpolate quantiser estimates", 0, AV_OPT_TYPE_CONST, { .i64 = QUANT_SEARCH_FAST },
+        0, 0, VE, "quant_search" },
     { NULL }
 };
 
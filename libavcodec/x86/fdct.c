@@ -595,3 +595,124 @@ void ff_fdct_sse2(int16_t *block)
 }
 
 #endif /* HAVE_SSE2_INLINE */
+
+#if HAVE_AVX2_INLINE && ARCH_X86_64
+
+/*
+ * In both passes of the 10-bit ISLOW forward DCT of jfdctint_template.c,
+ * each output is an integer combination of the 8 inputs of its row or
+ * column, rounded only once, by 12 bits in the first pass and by 15 bits
+ * in the second one. These are the combined coefficients, the DC and 4th
+ * outputs being scaled so that the same rounding applies to them. Each
+ * output is thus computed exactly with pmaddwd, 8 rows or columns at once,
+ * and the results are the same as those of the C version.
+ */
+DECLARE_ALIGNED(16, static const int16_t, fdct10_coeffs)[64] = {
+   8192,   8192,   8192,   8192,   8192,   8192,   8192,   8192,
+  11363,   9633,   6437,   2260,  -2260,  -6437,  -9633, -11363,
+  10703,   4433,  -4433, -10703, -10703,  -4433,   4433,  10703,
+   9633,  -2259, -11362,  -6436,   6436,  11362,   2259,  -9633,
+   8192,  -8192,  -8192,   8192,   8192,  -8192,  -8192,   8192,
+   6437, -11362,   2261,   9633,  -9633,  -2261,  11362,  -6437,
+   4433, -10704,  10704,  -4433,  -4433,  10704, -10704,   4433,
+   2260,  -6436,   9633, -11363,  11363,  -9633,   6436,  -2260,
+};
+
+DECLARE_ALIGNED(8, static const int32_t, fdct10_round)[2] = { 1 << 11, 1 << 14 };
+
+/* Output k of the 8 rows or columns held as pairs of 16-bit inputs in
+ * in0 to in3, as 32-bit values in out. */
+#define FDCT10_OUT(k, in0, in1, in2, in3, out, tmp, rnd, shift)    \
+        "vpbroadcastd  " #k "*16(%1), %%" #tmp "              \n\t" \
+        "vpmaddwd      %%" #in0 ", %%" #tmp ", %%" #out "      \n\t" \
+        "vpbroadcastd  " #k "*16+4(%1), %%" #tmp "            \n\t" \
+        "vpmaddwd      %%" #in1 ", %%" #tmp ", %%" #tmp "      \n\t" \
+        "vpaddd        %%" #tmp ", %%" #out ", %%" #out "      \n\t" \
+        "vpbroadcastd  " #k "*16+8(%1), %%" #tmp "            \n\t" \
+        "vpmaddwd      %%" #in2 ", %%" #tmp ", %%" #tmp "      \n\t" \
+        "vpaddd        %%" #tmp ", %%" #out ", %%" #out "      \n\t" \
+        "vpbroadcastd  " #k "*16+12(%1), %%" #tmp "           \n\t" \
+        "vpmaddwd      %%" #in3 ", %%" #tmp ", %%" #tmp "      \n\t" \
+        "vpaddd        %%" #tmp ", %%" #out ", %%" #out "      \n\t" \
+        "vpaddd        %%" #rnd ", %%" #out ", %%" #out "      \n\t" \
+        "vpsrad        $" #shift ", %%" #out ", %%" #out "     \n\t"
+
+#define FDCT10_PASS(in0, in1, in2, in3, o0, o1, o2, o3, o4, o5, o6, o7, tmp, rnd, shift) \
+        FDCT10_OUT(0, in0, in1, in2, in3, o0, tmp, rnd, shift) \
+        FDCT10_OUT(1, in0, in1, in2, in3, o1, tmp, rnd, shift) \
+        FDCT10_OUT(2, in0, in1, in2, in3, o2, tmp, rnd, shift) \
+        FDCT10_OUT(3, in0, in1, in2, in3, o3, tmp, rnd, shift) \
+        FDCT10_OUT(4, in0, in1, in2, in3, o4, tmp, rnd, shift) \
+        FDCT10_OUT(5, in0, in1, in2, in3, o5, tmp, rnd, shift) \
+        FDCT10_OUT(6, in0, in1, in2, in3, o6, tmp, rnd, shift) \
+        FDCT10_OUT(7, in0, in1, in2, in3, o7, tmp, rnd, shift)
+
+void ff_fdct10_avx2(int16_t *block)
+{
+    __asm__ volatile (
+        /* rows 0-3 in the low lanes and rows 4-7 in the high lanes */
+        "vmovdqu       (%0), %%xmm0                          \n\t"
+        "vmovdqu       16(%0), %%xmm1                        \n\t"
+        "vmovdqu       32(%0), %%xmm2                        \n\t"
+        "vmovdqu       48(%0), %%xmm3                        \n\t"
+        "vinserti128   $1, 64(%0), %%ymm0, %%ymm0            \n\t"
+        "vinserti128   $1, 80(%0), %%ymm1, %%ymm1            \n\t"
+        "vinserti128   $1, 96(%0), %%ymm2, %%ymm2            \n\t"
+        "vinserti128   $1, 112(%0), %%ymm3, %%ymm3           \n\t"
+        /* ymm0-3: pairs of inputs 0-1, 2-3, 4-5 and 6-7 of each row */
+        "vpunpckldq    %%ymm1, %%ymm0, %%ymm4                \n\t"
+        "vpunpckhdq    %%ymm1, %%ymm0, %%ymm5                \n\t"
+        "vpunpckldq    %%ymm3, %%ymm2, %%ymm6                \n\t"
+        "vpunpckhdq    %%ymm3, %%ymm2, %%ymm7                \n\t"
+        "vpunpcklqdq   %%ymm6, %%ymm4, %%ymm0                \n\t"
+        "vpunpckhqdq   %%ymm6, %%ymm4, %%ymm1                \n\t"
+        "vpunpcklqdq   %%ymm7, %%ymm5, %%ymm2                \n\t"
+        "vpunpckhqdq   %%ymm7, %%ymm5, %%ymm3                \n\t"
+        "vpbroadcastd  (%2), %%ymm13                         \n\t"
+        FDCT10_PASS(ymm0, ymm1, ymm2, ymm3,
+                    ymm4, ymm5, ymm6, ymm7, ymm8, ymm9, ymm10, ymm11,
+                    ymm12, ymm13, 12)
+        /* ymm4-11: output k of the rows, rows 0-3 in the low lanes;
+         * ymm4-7: pairs of rows 0-1, 2-3, 4-5 and 6-7 of each column,
+         * columns 0-3 in the low lanes */
+        "vpackssdw     %%ymm5, %%ymm4, %%ymm4                \n\t"
+        "vpackssdw     %%ymm7, %%ymm6, %%ymm6                \n\t"
+        "vpackssdw     %%ymm9, %%ymm8, %%ymm8                \n\t"
+        "vpackssdw     %%ymm11, %%ymm10, %%ymm10             \n\t"
+        "vperm2i128    $0x20, %%ymm8, %%ymm4, %%ymm0         \n\t"
+        "vperm2i128    $0x20, %%ymm10, %%ymm6, %%ymm1        \n\t"
+        "vperm2i128    $0x31, %%ymm8, %%ymm4, %%ymm2         \n\t"
+        "vperm2i128    $0x31, %%ymm10, %%ymm6, %%ymm3        \n\t"
+        "vshufps       $0x88, %%ymm1, %%ymm0, %%ymm4         \n\t"
+        "vshufps       $0xdd, %%ymm1, %%ymm0, %%ymm5         \n\t"
+        "vshufps       $0x88, %%ymm3, %%ymm2, %%ymm6         \n\t"
+        "vshufps       $0xdd, %%ymm3, %%ymm2, %%ymm7         \n\t"
+        "vpbroadcastd  4(%2), %%ymm1                         \n\t"
+        FDCT10_PASS(ymm4, ymm5, ymm6, ymm7,
+                    ymm8, ymm9, ymm10, ymm11, ymm12, ymm13, ymm14, ymm15,
+                    ymm0, ymm1, 15)
+        /* ymm8-15: output rows 0-7 */
+        "vpackssdw     %%ymm9, %%ymm8, %%ymm8                \n\t"
+        "vpackssdw     %%ymm11, %%ymm10, %%ymm10             \n\t"
+        "vpackssdw     %%ymm13, %%ymm12, %%ymm12             \n\t"
+        "vpackssdw     %%ymm15, %%ymm14, %%ymm14             \n\t"
+        "vpermq        $0xd8, %%ymm8, %%ymm8                 \n\t"
+        "vpermq        $0xd8, %%ymm10, %%ymm10               \n\t"
+        "vpermq        $0xd8, %%ymm12, %%ymm12               \n\t"
+        "vpermq        $0xd8, %%ymm14, %%ymm14               \n\t"
+        "vmovdqu       %%ymm8, (%0)                          \n\t"
+        "vmovdqu       %%ymm10, 32(%0)                       \n\t"
+        "vmovdqu       %%ymm12, 64(%0)                       \n\t"
+        "vmovdqu       %%ymm14, 96(%0)                       \n\t"
+        "vzeroupper                                          \n\t"
+        :
+        : "r" (block), "r" (fdct10_coeffs), "r" (fdct10_round)
+        : XMM_CLOBBERS("%xmm0",  "%xmm1",  "%xmm2",  "%xmm3",
+                       "%xmm4",  "%xmm5",  "%xmm6",  "%xmm7",
+                       "%xmm8",  "%xmm9",  "%xmm10", "%xmm11",
+                       "%xmm12", "%xmm13", "%xmm14", "%xmm15",)
+          "memory"
+    );
+}
+
+#endif /* HAVE_AVX2_INLINE && ARCH_X86_64 */
@@ -40,5 +40,8 @@ av_cold void ff_fdctdsp_init_x86(FDCTDSPContext *c, AVCodecContext *avctx,
             if (INLINE_SSE2(cpu_flags))
                 c->fdct = ff_fdct_sse2;
         }
+    } else if (avctx->bits_per_raw_sample == 10 || avctx->bits_per_raw_sample == 9) {
+        if (ARCH_X86_64 && INLINE_AVX2(cpu_flags))
+            c->fdct = ff_fdct10_avx2;
     }
 }
@@ -42,6 +42,8 @@ decl_fpel_func(put, 32,   , avx);
 decl_fpel_func(put, 64,   , avx);
 decl_fpel_func(avg, 32, _8, avx2);
 decl_fpel_func(avg, 64, _8, avx2);
+decl_fpel_func(put, 64,   , avx512);
+decl_fpel_func(avg, 64, _8, avx512);
 
 decl_mc_funcs(4, mmxext, int16_t, 8, 8);
 decl_mc_funcs(8, sse2, int16_t,  8, 8);
@@ -50,6 +52,9 @@ decl_mc_funcs(8, ssse3, int8_t, 32, 8);
 #if ARCH_X86_64
 decl_mc_funcs(16, ssse3, int8_t, 32, 8);
 decl_mc_funcs(32, avx2, int8_t, 32, 8);
+#if HAVE_AVX512_EXTERNAL
+decl_mc_funcs(64, avx512, int8_t, 32, 8);
+#endif
 #endif
 
 mc_rep_funcs(16,  8,  8,  sse2, int16_t,  8, 8)
@@ -77,6 +82,10 @@ filters_8tap_2d_fn(put, 32, 32, 8, 1, avx2, ssse3)
 filters_8tap_2d_fn(avg, 64, 32, 8, 1, avx2, ssse3)
 filters_8tap_2d_fn(avg, 32, 32, 8, 1, avx2, ssse3)
 #endif
+#if ARCH_X86_64 && HAVE_AVX512_EXTERNAL
+filters_8tap_2d_fn(put, 64, 32, 8, 1, avx512, ssse3)
+filters_8tap_2d_fn(avg, 64, 32, 8, 1, avx512, ssse3)
+#endif
 
 filters_8tap_1d_fn3(put, 8, mmxext, sse2, sse2)
 filters_8tap_1d_fn3(avg, 8, mmxext, sse2, sse2)
@@ -88,6 +97,10 @@ filters_8tap_1d_fn2(put, 32, 8, avx2, ssse3)
 filters_8tap_1d_fn2(avg, 64, 8, avx2, ssse3)
 filters_8tap_1d_fn2(avg, 32, 8, avx2, ssse3)
 #endif
+#if ARCH_X86_64 && HAVE_AVX512_EXTERNAL
+filters_8tap_1d_fn2(put, 64, 8, avx512, ssse3)
+filters_8tap_1d_fn2(avg, 64, 8, avx512, ssse3)
+#endif
 
 #define itxfm_func(typea, typeb, size, opt) \
 void ff_vp9_##typea##_##typeb##_##size##x##size##_add_##opt(uint8_t *dst, ptrdiff_t stride, \
@@ -406,6 +419,20 @@ av_cold void ff_vp9dsp_init_x86(VP9DSPContext *dsp, int bpp, int bitexact)
         init_ipred(32, avx2, tm, TM_VP8);
     }
 
+    if (EXTERNAL_AVX512(cpu_flags)) {
+        /* Only 64px blocks use zmm registers; 32px blocks keep the avx2
+         * versions, since a ymm-width avx512 version would run the same
+         * code with no gain. */
+        init_fpel_func(0, 0, 64, put, , avx512);
+        init_fpel_func(0, 1, 64, avg, _8, avx512);
+        if (ARCH_X86_64) {
+#if ARCH_X86_64 && HAVE_AVX512_EXTERNAL
+            init_subpel2(0, 0, 64, put, 8, avx512);
+            init_subpel2(0, 1, 64, avg, 8, avx512);
+#endif
+        }
+    }
+
 #undef init_fpel
 #undef init_subpel1
 #undef init_subpel2
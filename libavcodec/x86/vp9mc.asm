@@ -261,14 +261,37 @@ filter_h_fn put
 filter_h_fn avg
 
 %if ARCH_X86_64
-%macro filter_hx2_fn 1
-%assign %%px mmsize
-cglobal vp9_%1_8tap_1d_h_ %+ %%px %+ _8, 6, 6, 14, dst, dstride, src, sstride, h, filtery
+; the ssse3 tap table holds 32 bytes per tap pair, so zmm versions broadcast
+; each pair into both halves of the register instead of loading 64 bytes
+%macro LOAD_FILTERS_X2 0
+%if mmsize == 64
+    vpbroadcastd m13, [pw_256]
+    vbroadcasti64x4 m8, [filteryq+ 0]
+    vbroadcasti64x4 m9, [filteryq+32]
+    vbroadcasti64x4 m10, [filteryq+64]
+    vbroadcasti64x4 m11, [filteryq+96]
+%else
     mova       m13, [pw_256]
     mova        m8, [filteryq+ 0]
     mova        m9, [filteryq+32]
     mova       m10, [filteryq+64]
     mova       m11, [filteryq+96]
+%endif
+%endmacro
+
+; 64px blocks may land in the 32-byte aligned per-thread tmp buffers
+%macro STORE_X2 2
+%if mmsize == 64
+    movu          %1, %2
+%else
+    mova          %1, %2
+%endif
+%endmacro
+
+%macro filter_hx2_fn 1
+%assign %%px mmsize
+cglobal vp9_%1_8tap_1d_h_ %+ %%px %+ _8, 6, 6, 14, dst, dstride, src, sstride, h, filtery
+    LOAD_FILTERS_X2
 .loop:
     movu        m0, [srcq-3]
     movu        m1, [srcq-2]
@@ -303,7 +326,7 @@ cglobal vp9_%1_8tap_1d_h_ %+ %%px %+ _8, 6, 6, 14, dst, dstride, src, sstride, h
 %ifidn %1, avg
     pavgb       m0, [dstq]
 %endif
-    mova    [dstq], m0
+    STORE_X2    [dstq], m0
     add       dstq, dstrideq
     dec         hd
     jg .loop
@@ -320,6 +343,12 @@ filter_hx2_fn put
 filter_hx2_fn avg
 %endif
 
+%if HAVE_AVX512_EXTERNAL
+INIT_ZMM avx512
+filter_hx2_fn put
+filter_hx2_fn avg
+%endif
+
 %endif ; ARCH_X86_64
 
 %macro filter_sse2_v_fn 1
@@ -497,14 +526,10 @@ filter_v_fn avg
 %macro filter_vx2_fn 1
 %assign %%px mmsize
 cglobal vp9_%1_8tap_1d_v_ %+ %%px %+ _8, 6, 8, 14, dst, dstride, src, sstride, h, filtery, src4, sstride3
-    mova       m13, [pw_256]
     lea  sstride3q, [sstrideq*3]
     lea      src4q, [srcq+sstrideq]
     sub       srcq, sstride3q
-    mova        m8, [filteryq+ 0]
-    mova        m9, [filteryq+32]
-    mova       m10, [filteryq+64]
-    mova       m11, [filteryq+96]
+    LOAD_FILTERS_X2
 .loop:
     ; FIXME maybe reuse loads from previous rows, or just
     ; more generally unroll this to prevent multiple loads of
@@ -543,7 +568,7 @@ cglobal vp9_%1_8tap_1d_v_ %+ %%px %+ _8, 6, 8, 14, dst, dstride, src, sstride, h
 %ifidn %1, avg
     pavgb       m0, [dstq]
 %endif
-    mova    [dstq], m0
+    STORE_X2    [dstq], m0
     add       dstq, dstrideq
     dec         hd
     jg .loop
@@ -560,12 +585,21 @@ filter_vx2_fn put
 filter_vx2_fn avg
 %endif
 
+%if HAVE_AVX512_EXTERNAL
+INIT_ZMM avx512
+filter_vx2_fn put
+filter_vx2_fn avg
+%endif
+
 %endif ; ARCH_X86_64
 
 %macro fpel_fn 6-8 0, 4
 %if %2 == 4
 %define %%srcfn movh
 %define %%dstfn movh
+%elif mmsize == 64
+%define %%srcfn movu
+%define %%dstfn movu
 %else
 %define %%srcfn movu
 %define %%dstfn mova
@@ -656,6 +690,11 @@ INIT_YMM avx2
 fpel_fn avg, 32, strideq, strideq*2, stride3q, 4, 8
 fpel_fn avg, 64, mmsize,  strideq,   strideq+mmsize, 2, 8
 %endif
+%if HAVE_AVX512_EXTERNAL
+INIT_ZMM avx512
+fpel_fn put, 64, strideq, strideq*2, stride3q, 4
+fpel_fn avg, 64, strideq, strideq*2, stride3q, 4, 8
+%endif
 INIT_MMX mmxext
 fpel_fn avg,  8,  strideq, strideq*2, stride3q, 4, 16
 INIT_XMM sse2
@@ -1807,6 +1807,45 @@ typedef struct AVFormatContext {
      * @return 0 on success, a negative AVERROR code on failure
      */
     int (*io_close2)(struct AVFormatContext *s, AVIOContext *pb);
+
+    /**
+     * Number of threads used by avformat_find_stream_info() to decode the
+     * packets of different streams concurrently. 1 decodes them on the
+     * calling thread, 0 picks a number automatically.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int probe_threads;
+
+    /**
+     * Stream information avformat_find_stream_info() keeps reading packets
+     * for, a combination of AVFMT_PROBE_REQUIRE_* flags. Information not
+     * required is still filled in if found before all the required one.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int probe_required;
+#define AVFMT_PROBE_REQUIRE_CODEC_PARAMS 0x0001 ///< codec parameters, e.g. dimensions, sample rate or channel layout
+#define AVFMT_PROBE_REQUIRE_FRAME_RATE   0x0002 ///< frame rate of video streams with unreliable time bases
+#define AVFMT_PROBE_REQUIRE_DECODE_DELAY 0x0004 ///< decoder delay, when the timestamps show reordering
+#define AVFMT_PROBE_REQUIRE_EXTRADATA    0x0008 ///< extradata extracted from the packets
+#define AVFMT_PROBE_REQUIRE_START_TIME   0x0010 ///< first timestamp of audio and video streams
+#define AVFMT_PROBE_REQUIRE_STREAMS      0x0020 ///< streams appearing later, with formats without a header
+#define AVFMT_PROBE_REQUIRE_ALL          0x003f
+
+    /**
+     * Probe information saved by avformat_save_probe_info() for the same
+     * input. When set, avformat_open_input() takes the input format from it
+     * instead of probing, and avformat_find_stream_info() restores the stream
+     * information from it instead of reading packets, unless it does not
+     * match the streams found by the demuxer.
+     * Must be allocated with av_malloc(), freed by avformat_free_context().
+     * Set it with the "probe_info" binary option.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    uint8_t *probe_info;
+    int probe_info_size;
 } AVFormatContext;
 
 /**
@@ -1865,6 +1904,8 @@ int avformat_network_init(void);
 /**
  * Undo the initialization done by avformat_network_init. Call it only
  * once for each time you called avformat_network_init.
+ * This also closes the idle connections pooled by the HTTP protocol and
+ * drops the TLS sessions kept for resumption.
  */
 int avformat_network_deinit(void);
 
@@ -2117,6 +2158,21 @@ int avformat_open_input(AVFormatContext **ps, const char *url,
  */
 int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options);
 
+/**
+ * Save the results of probing and analyzing the input into a blob that can
+ * be passed back with the "probe_info" option when opening the same input
+ * again, skipping most of the work of avformat_open_input() and
+ * avformat_find_stream_info().
+ *
+ * The blob is only valid with the same libavformat version and input.
+ *
+ * @param ic   media file handle, after avformat_find_stream_info()
+ * @param buf  set to the blob, to be freed with av_free()
+ * @param size set to the size of the blob
+ * @return >=0 on success, a negative AVERROR code on failure
+ */
+int avformat_save_probe_info(AVFormatContext *ic, uint8_t **buf, int *size);
+
 /**
  * Find the programs which belong to a given stream.
  *
@@ -58,6 +58,9 @@ static const AVOption options[] = {
     {"protocol_whitelist", "List of protocols that are allowed to be used", OFFSET(protocol_whitelist), AV_OPT_TYPE_STRING, { .str = NULL },  0, 0, D },
     {"protocol_blacklist", "List of protocols that are not allowed to be used", OFFSET(protocol_blacklist), AV_OPT_TYPE_STRING, { .str = NULL },  0, 0, D },
     {"rw_timeout", "Timeout for IO operations (in microseconds)", offsetof(URLContext, rw_timeout), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_DECODING_PARAM },
+    {"async_write", "Write the data from a background thread", OFFSET(async_write), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
+    {"async_write_size", "Size of the blocks of data handed to the background thread", OFFSET(async_write_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, E },
+    {"async_write_budget", "Maximum amount of data waiting for the background thread", OFFSET(async_write_budget), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E },
     { NULL }
 };
 
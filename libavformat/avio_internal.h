@@ -77,6 +77,11 @@ typedef struct FFIOContext {
      * is updated each time a successful writeout ends up further position-wise
      */
     int64_t written_output_size;
+
+    /**
+     * Background thread writing out the data, if any
+     */
+    struct IOWriteThread *write_thread;
 } FFIOContext;
 
 static av_always_inline FFIOContext *ffiocontext(AVIOContext *ctx)
@@ -19,14 +19,19 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+
 #include "libavutil/bprint.h"
+#include "libavutil/buffer.h"
 #include "libavutil/crc.h"
 #include "libavutil/dict.h"
+#include "libavutil/fifo.h"
 #include "libavutil/internal.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
 #include "libavutil/avassert.h"
+#include "libavutil/thread.h"
 #include "libavcodec/defs.h"
 #include "avio.h"
 #include "avio_internal.h"
@@ -78,6 +83,196 @@ static int url_resetbuf(AVIOContext *s, int flags);
 /** @warning must be called before any I/O */
 static int set_buf_size(AVIOContext *s, int buf_size);
 
+/**
+ * Default maximum amount of data waiting for the background thread of the
+ * protocols opened with the async_write option.
+ */
+#define ASYNC_WRITE_BUDGET (4 * 1024 * 1024)
+
+#if HAVE_THREADS
+typedef struct IOWriteThread {
+    pthread_t       thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+
+    void *opaque;
+    int (*write_packet)(void *opaque, uint8_t *buf, int buf_size);
+
+    /**
+     * Blocks of data waiting to be written, as AVBufferRef pointers,
+     * allocated from pool when they fit in block_size.
+     */
+    AVFifo       *blocks;
+    AVBufferPool *pool;
+    int           block_size;
+
+    /**
+     * Memory used by the blocks queued and not written yet, at most budget
+     * unless it is a single block. Blocks from the pool count for their
+     * full size whatever amount of data they hold.
+     */
+    int64_t queued;
+    int64_t budget;
+
+    int error;
+    int finish;
+} IOWriteThread;
+
+static int write_thread_cost(const IOWriteThread *wt, int len)
+{
+    return FFMAX(len, wt->block_size);
+}
+
+static void *write_thread(void *arg)
+{
+    IOWriteThread *wt = arg;
+    AVBufferRef *buf;
+
+    pthread_mutex_lock(&wt->mutex);
+    while (1) {
+        int ret = 0;
+
+        if (av_fifo_read(wt->blocks, &buf, 1) < 0) {
+            if (wt->finish)
+                break;
+            pthread_cond_wait(&wt->cond, &wt->mutex);
+            continue;
+        }
+        /* once an error happened, the remaining data is dropped */
+        if (!wt->error) {
+            pthread_mutex_unlock(&wt->mutex);
+            ret = wt->write_packet(wt->opaque, buf->data, buf->size);
+            pthread_mutex_lock(&wt->mutex);
+        }
+        if (ret < 0 && !wt->error)
+            wt->error = ret;
+        wt->queued -= write_thread_cost(wt, buf->size);
+        av_buffer_unref(&buf);
+        pthread_cond_broadcast(&wt->cond);
+    }
+    pthread_mutex_unlock(&wt->mutex);
+
+    return NULL;
+}
+
+static int write_thread_queue(IOWriteThread *wt, const uint8_t *data, int len)
+{
+    int cost = write_thread_cost(wt, len);
+    AVBufferRef *buf;
+    int ret;
+
+    pthread_mutex_lock(&wt->mutex);
+    while (!wt->error && wt->queued && wt->queued + cost > wt->budget)
+        pthread_cond_wait(&wt->cond, &wt->mutex);
+    ret = wt->error;
+    pthread_mutex_unlock(&wt->mutex);
+    if (ret < 0)
+        return ret;
+
+    buf = len <= wt->block_size ? av_buffer_pool_get(wt->pool) : av_buffer_alloc(len);
+    if (!buf)
+        return AVERROR(ENOMEM);
+    memcpy(buf->data, data, len);
+    buf->size = len;
+
+    pthread_mutex_lock(&wt->mutex);
+    ret = av_fifo_write(wt->blocks, &buf, 1);
+    if (ret >= 0) {
+        wt->queued += cost;
+        pthread_cond_broadcast(&wt->cond);
+    }
+    pthread_mutex_unlock(&wt->mutex);
+    if (ret < 0)
+        av_buffer_unref(&buf);
+    return ret;
+}
+
+static int write_thread_start(FFIOContext *ctx, int block_size, int64_t budget)
+{
+    AVIOContext *const s = &ctx->pub;
+    IOWriteThread *wt;
+    int ret;
+
+    wt = av_mallocz(sizeof(*wt));
+    if (!wt)
+        return AVERROR(ENOMEM);
+    wt->opaque       = s->opaque;
+    wt->write_packet = s->write_packet;
+    wt->block_size   = block_size;
+    wt->budget       = budget;
+    wt->blocks       = av_fifo_alloc2(FFMAX(budget / block_size, 2), sizeof(AVBufferRef *),
+                                      AV_FIFO_FLAG_AUTO_GROW);
+    wt->pool         = av_buffer_pool_init(block_size, NULL);
+    if (!wt->blocks || !wt->pool) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    if ((ret = pthread_mutex_init(&wt->mutex, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&wt->cond, NULL))) {
+        pthread_mutex_destroy(&wt->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_create(&wt->thread, NULL, write_thread, wt))) {
+        pthread_cond_destroy(&wt->cond);
+        pthread_mutex_destroy(&wt->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    ctx->write_thread = wt;
+    return 0;
+
+fail:
+    av_fifo_freep2(&wt->blocks);
+    av_buffer_pool_uninit(&wt->pool);
+    av_free(wt);
+    return ret;
+}
+
+static void write_thread_stop(FFIOContext *ctx)
+{
+    IOWriteThread *wt = ctx->write_thread;
+
+    if (!wt)
+        return;
+    pthread_mutex_lock(&wt->mutex);
+    wt->finish = 1;
+    pthread_cond_broadcast(&wt->cond);
+    pthread_mutex_unlock(&wt->mutex);
+    pthread_join(wt->thread, NULL);
+
+    pthread_cond_destroy(&wt->cond);
+    pthread_mutex_destroy(&wt->mutex);
+    av_fifo_freep2(&wt->blocks);
+    av_buffer_pool_uninit(&wt->pool);
+    av_freep(&ctx->write_thread);
+}
+#endif
+
+/**
+ * Wait for the data queued for the background thread to be written, before
+ * the underlying protocol is used directly.
+ */
+static void write_thread_wait(AVIOContext *s)
+{
+#if HAVE_THREADS
+    IOWriteThread *wt = ffiocontext(s)->write_thread;
+
+    if (!wt)
+        return;
+    pthread_mutex_lock(&wt->mutex);
+    while (!wt->error && wt->queued)
+        pthread_cond_wait(&wt->cond, &wt->mutex);
+    if (wt->error < 0 && !s->error)
+        s->error = wt->error;
+    pthread_mutex_unlock(&wt->mutex);
+#endif
+}
+
 void ffio_init_context(FFIOContext *ctx,
                   unsigned char *buffer,
                   int buffer_size,
@@ -151,6 +346,10 @@ AVIOContext *avio_alloc_context(
 
 void avio_context_free(AVIOContext **ps)
 {
+#if HAVE_THREADS
+    if (*ps)
+        write_thread_stop(ffiocontext(*ps));
+#endif
     av_freep(ps);
 }
 
@@ -164,6 +363,10 @@ static void writeout(AVIOContext *s, const uint8_t *data, int len)
                                      len,
                                      ctx->current_type,
                                      ctx->last_time);
+#if HAVE_THREADS
+        else if (ctx->write_thread)
+            ret = write_thread_queue(ctx->write_thread, data, len);
+#endif
         else if (s->write_packet)
             ret = s->write_packet(s->opaque, (uint8_t *)data, len);
         if (ret < 0) {
@@ -249,7 +452,7 @@ void avio_write(AVIOContext *s, const unsigned char *buf, int size)
     }
 }
 
-void avio_flush(AVIOContext *s)
+static void flush_output(AVIOContext *s)
 {
     int seekback = s->write_flag ? FFMIN(0, s->buf_ptr - s->buf_ptr_max) : 0;
     flush_buffer(s);
@@ -257,6 +460,12 @@ void avio_flush(AVIOContext *s)
         avio_seek(s, seekback, SEEK_CUR);
 }
 
+void avio_flush(AVIOContext *s)
+{
+    flush_output(s);
+    write_thread_wait(s);
+}
+
 int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
 {
     FFIOContext *const ctx = ffiocontext(s);
@@ -270,8 +479,10 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
     if(!s)
         return AVERROR(EINVAL);
 
-    if ((whence & AVSEEK_SIZE))
+    if ((whence & AVSEEK_SIZE)) {
+        write_thread_wait(s);
         return s->seek ? s->seek(s->opaque, offset, AVSEEK_SIZE) : AVERROR(ENOSYS);
+    }
 
     buffer_size = s->buf_end - s->buffer;
     // pos is the absolute position that the beginning of s->buffer corresponds to in the file
@@ -329,6 +540,7 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         int64_t res;
         if (s->write_flag) {
             flush_buffer(s);
+            write_thread_wait(s);
         }
         if (!s->seek)
             return AVERROR(EPIPE);
@@ -362,6 +574,7 @@ int64_t avio_size(AVIOContext *s)
 
     if (!s->seek)
         return AVERROR(ENOSYS);
+    write_thread_wait(s);
     size = s->seek(s->opaque, 0, AVSEEK_SIZE);
     if (size < 0) {
         if ((size = s->seek(s->opaque, -1, SEEK_END)) < 0)
@@ -491,8 +704,9 @@ void avio_write_marker(AVIOContext *s, int64_t time, enum AVIODataMarkerType typ
 {
     FFIOContext *const ctx = ffiocontext(s);
     if (type == AVIO_DATA_MARKER_FLUSH_POINT) {
+        /* the data is only handed over to the background thread if any */
         if (s->buf_ptr - s->buffer >= s->min_packet_size)
-            avio_flush(s);
+            flush_output(s);
         return;
     }
     if (!s->write_data_type)
@@ -957,10 +1171,14 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
 {
     uint8_t *buffer = NULL;
     int buffer_size, max_packet_size;
+    int async_write = h->async_write && h->flags & AVIO_FLAG_WRITE &&
+                      !(h->flags & AVIO_FLAG_DIRECT);
 
     max_packet_size = h->max_packet_size;
     if (max_packet_size) {
         buffer_size = max_packet_size; /* no need to bufferize more than one packet */
+    } else if (async_write && h->async_write_size) {
+        buffer_size = h->async_write_size;
     } else {
         buffer_size = IO_BUFFER_SIZE;
     }
@@ -1006,6 +1224,22 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
     }
     ((FFIOContext*)(*s))->short_seek_get = (int (*)(void *))ffurl_get_short_seek;
     (*s)->av_class = &ff_avio_class;
+
+    if (async_write) {
+#if HAVE_THREADS
+        int ret = write_thread_start(ffiocontext(*s), buffer_size,
+                                     h->async_write_budget ? h->async_write_budget
+                                                           : ASYNC_WRITE_BUDGET);
+        if (ret < 0) {
+            av_freep(&(*s)->buffer);
+            av_opt_free(*s);
+            avio_context_free(s);
+            return ret;
+        }
+#else
+        av_log(h, AV_LOG_WARNING, "Writing synchronously, threads are not supported\n");
+#endif
+    }
     return 0;
 }
 
@@ -1023,7 +1257,8 @@ URLContext* ffio_geturlcontext(AVIOContext *s)
 int ffio_copy_url_options(AVIOContext* pb, AVDictionary** avio_opts)
 {
     const char *opts[] = {
-        "headers", "user_agent", "cookies", "http_proxy", "referer", "rw_timeout", "icy", NULL };
+        "headers", "user_agent", "cookies", "http_proxy", "referer", "rw_timeout", "icy",
+        "connection_pool", NULL };
     const char **opt = opts;
     uint8_t *buf = NULL;
     int ret = 0;
@@ -1259,6 +1494,9 @@ int avio_close(AVIOContext *s)
         return 0;
 
     avio_flush(s);
+#if HAVE_THREADS
+    write_thread_stop(ctx);
+#endif
     h         = s->opaque;
     s->opaque = NULL;
 
@@ -20,14 +20,17 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 #include <libxml/parser.h>
+#include "config.h"
 #include "libavutil/bprint.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
 #include "internal.h"
 #include "avio_internal.h"
 #include "dash.h"
+#include "segprefetch.h"
 
 #define INITIAL_BUFFER_SIZE 32768
 
@@ -115,6 +118,8 @@ struct representation {
     uint32_t init_sec_buf_read_offset;
     int64_t cur_timestamp;
     int is_restart_needed;
+
+    SegPrefetchQueue prefetch;              /* fragments, by absolute URL */
 };
 
 typedef struct DASHContext {
@@ -156,6 +161,22 @@ typedef struct DASHContext {
     int is_init_section_common_audio;
     int is_init_section_common_subtitle;
 
+    int prefetch_segments;
+    int64_t prefetch_size;
+    SegPrefetch prefetch;
+
+    /* Live manifest reloaded in the background, protected by prefetch.lock */
+    int manifest_started;
+    int manifest_reload;                    /* reload requested by the demuxer */
+    int64_t manifest_load_time;
+    AVDictionary *manifest_opts;
+    char *manifest_data;
+    int manifest_size;
+    char *manifest_url;                     /* location after redirections */
+    int manifest_error;
+#if HAVE_THREADS
+    pthread_t manifest_thread;
+#endif
 } DASHContext;
 
 static int ishttp(char *url)
@@ -346,6 +367,7 @@ static void free_timelines_list(struct representation *pls)
 
 static void free_representation(struct representation *pls)
 {
+    ff_segprefetch_free_queue(&pls->prefetch);
     free_fragment_list(pls);
     free_timelines_list(pls);
     free_fragment(&pls->cur_seg);
@@ -1222,7 +1244,9 @@ static int parse_manifest(AVFormatContext *s, const char *url, AVIOContext *in)
             return ret;
     }
 
-    if (av_opt_get(in, "location", AV_OPT_SEARCH_CHILDREN, (uint8_t**)&c->base_url) < 0)
+    /* the location of a manifest reloaded in the background is already set */
+    if (!c->base_url &&
+        av_opt_get(in, "location", AV_OPT_SEARCH_CHILDREN, (uint8_t**)&c->base_url) < 0)
         c->base_url = av_strdup(url);
 
     av_bprint_init(&buf, 0, INT_MAX); // xmlReadMemory uses integer bufsize
@@ -1474,6 +1498,373 @@ static void move_segments(struct representation *rep_src, struct representation
 }
 
 
+/*
+ * Build the fragment with the given sequence number from the fragment list or
+ * the URL template, without refreshing the manifest.
+ */
+static struct fragment *get_fragment(struct representation *pls, int64_t seq_no)
+{
+    DASHContext *c = pls->parent->priv_data;
+    struct fragment *seg;
+    char *tmpfilename;
+
+    seg = av_mallocz(sizeof(struct fragment));
+    if (!seg) {
+        return NULL;
+    }
+
+    if (seq_no < pls->n_fragments) {
+        struct fragment *seg_ptr = pls->fragments[seq_no];
+        seg->url = av_strdup(seg_ptr->url);
+        if (!seg->url) {
+            av_free(seg);
+            return NULL;
+        }
+        seg->size = seg_ptr->size;
+        seg->url_offset = seg_ptr->url_offset;
+        return seg;
+    }
+
+    if (!pls->url_template) {
+        av_log(pls->parent, AV_LOG_ERROR, "Cannot get fragment, missing template URL\n");
+        av_free(seg);
+        return NULL;
+    }
+    tmpfilename = av_mallocz(c->max_url_size);
+    if (!tmpfilename) {
+        av_free(seg);
+        return NULL;
+    }
+    ff_dash_fill_tmpl_params(tmpfilename, c->max_url_size, pls->url_template, 0, seq_no, 0, get_segment_start_time_based_on_timeline(pls, seq_no));
+    seg->url = av_strireplace(pls->url_template, pls->url_template, tmpfilename);
+    if (!seg->url) {
+        av_log(pls->parent, AV_LOG_WARNING, "Unable to resolve template url '%s', try to use origin template\n", pls->url_template);
+        seg->url = av_strdup(pls->url_template);
+        if (!seg->url) {
+            av_log(pls->parent, AV_LOG_ERROR, "Cannot resolve template url '%s'\n", pls->url_template);
+            av_free(tmpfilename);
+            av_free(seg);
+            return NULL;
+        }
+    }
+    av_free(tmpfilename);
+    seg->size = -1;
+
+    return seg;
+}
+
+#if HAVE_THREADS
+
+static int prefetch_download(DASHContext *c, struct representation *pls,
+                             SegPrefetchItem *pf)
+{
+    AVIOContext *pb = NULL;
+    AVDictionary *opts = NULL;
+    int ret;
+
+    if (pf->size >= 0) {
+        av_dict_set_int(&opts, "offset", pf->url_offset, 0);
+        av_dict_set_int(&opts, "end_offset", pf->url_offset + pf->size, 0);
+    }
+
+    av_log(pls->parent, AV_LOG_VERBOSE, "DASH prefetch for url '%s', offset %"PRId64"\n",
+           pf->url, pf->url_offset);
+
+    ret = open_url(pls->parent, &pb, pf->url, &pf->opts, opts, NULL);
+    av_dict_free(&opts);
+    if (ret >= 0)
+        ret = ff_segprefetch_fill(&c->prefetch, &pls->prefetch, pf, pb);
+
+    ff_format_io_close(pls->parent, &pb);
+    return ret;
+}
+
+/* Download the queued fragments of a representation in order. */
+static void *prefetch_thread(void *arg)
+{
+    struct representation *pls = arg;
+    DASHContext *c = pls->parent->priv_data;
+
+    pthread_mutex_lock(&c->prefetch.lock);
+    while (!c->prefetch.stop) {
+        SegPrefetchItem *pf = ff_segprefetch_next(&c->prefetch, &pls->prefetch);
+
+        if (pf) {
+            int ret;
+
+            pthread_mutex_unlock(&c->prefetch.lock);
+            ret = prefetch_download(c, pls, pf);
+            pthread_mutex_lock(&c->prefetch.lock);
+            ff_segprefetch_done(&c->prefetch, &pls->prefetch, pf, ret);
+            continue;
+        }
+        pthread_cond_wait(&c->prefetch.cond, &c->prefetch.lock);
+    }
+    pthread_mutex_unlock(&c->prefetch.lock);
+
+    return NULL;
+}
+
+static void prefetch_load_manifest(AVFormatContext *s, AVDictionary **opts)
+{
+    DASHContext *c = s->priv_data;
+    AVIOContext *in = NULL;
+    char *data = NULL, *location = NULL;
+    AVBPrint buf;
+    int size = 0;
+    int ret;
+
+    ret = avio_open2(&in, s->url, AVIO_FLAG_READ, c->interrupt_callback, opts);
+    av_dict_free(opts);
+
+    av_bprint_init(&buf, 0, INT_MAX);
+    if (ret >= 0) {
+        ret = avio_read_to_bprint(in, &buf, SIZE_MAX);
+        if (ret >= 0 && !av_bprint_is_complete(&buf))
+            ret = AVERROR(ENOMEM);
+        av_opt_get(in, "location", AV_OPT_SEARCH_CHILDREN, (uint8_t**)&location);
+        avio_close(in);
+    }
+    size = buf.len;
+    if (ret >= 0)
+        ret = av_bprint_finalize(&buf, &data);
+    else
+        av_bprint_finalize(&buf, NULL);
+
+    pthread_mutex_lock(&c->prefetch.lock);
+    av_freep(&c->manifest_data);
+    av_freep(&c->manifest_url);
+    c->manifest_data      = data;
+    c->manifest_size      = data ? size : 0;
+    c->manifest_url       = location;
+    c->manifest_error     = FFMIN(ret, 0);
+    c->manifest_load_time = av_gettime_relative();
+    c->manifest_reload    = 0;
+    pthread_cond_broadcast(&c->prefetch.cond);
+    pthread_mutex_unlock(&c->prefetch.lock);
+}
+
+/*
+ * Keep a fresh copy of a live manifest at hand, reloading it every
+ * minimumUpdatePeriod and whenever the demuxer asks for it.
+ */
+static void *manifest_thread(void *arg)
+{
+    AVFormatContext *s = arg;
+    DASHContext *c = s->priv_data;
+
+    pthread_mutex_lock(&c->prefetch.lock);
+    while (!c->prefetch.stop) {
+        int64_t reload_time = c->manifest_load_time +
+                              c->minimum_update_period * 1000000;
+        int64_t now = av_gettime_relative();
+
+        if (c->manifest_reload || (c->minimum_update_period && now >= reload_time)) {
+            AVDictionary *opts = NULL;
+            av_dict_copy(&opts, c->manifest_opts, 0);
+            pthread_mutex_unlock(&c->prefetch.lock);
+            prefetch_load_manifest(s, &opts);
+            pthread_mutex_lock(&c->prefetch.lock);
+            continue;
+        }
+
+        if (c->minimum_update_period)
+            ff_segprefetch_wait(&c->prefetch, reload_time - now);
+        else
+            pthread_cond_wait(&c->prefetch.cond, &c->prefetch.lock);
+    }
+    pthread_mutex_unlock(&c->prefetch.lock);
+
+    return NULL;
+}
+
+static int prefetch_init(AVFormatContext *s)
+{
+    DASHContext *c = s->priv_data;
+    int ret;
+
+    if (!c->prefetch_segments)
+        return 0;
+
+    if ((ret = ff_segprefetch_init(&c->prefetch, c->prefetch_size,
+                                   c->interrupt_callback)) < 0)
+        return ret;
+
+    if (c->is_live) {
+        av_dict_copy(&c->manifest_opts, c->avio_opts, 0);
+        c->manifest_load_time = av_gettime_relative();
+        ret = pthread_create(&c->manifest_thread, NULL, manifest_thread, s);
+        if (ret)
+            return AVERROR(ret);
+        c->manifest_started = 1;
+    }
+    return 0;
+}
+
+/* Queue the fragments following the current one for download. */
+static int prefetch_schedule(DASHContext *c, struct representation *pls)
+{
+    int64_t seq_no, end;
+    char *url;
+    int ret = 0;
+
+    if (!pls->prefetch.started) {
+        ret = ff_segprefetch_start(&c->prefetch, &pls->prefetch, prefetch_thread, pls);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (pls->n_fragments)
+        end = pls->n_fragments;
+    else if (c->is_live)
+        end = calc_max_seg_no(pls, c) + 1;
+    else
+        end = pls->last_seq_no + 1;
+    end    = FFMIN(end, pls->cur_seq_no + c->prefetch_segments);
+    seq_no = FFMAX(pls->prefetch.next_seq_no, pls->cur_seq_no);
+
+    url = av_mallocz(c->max_url_size);
+    if (!url)
+        return AVERROR(ENOMEM);
+
+    pthread_mutex_lock(&c->prefetch.lock);
+    av_dict_free(&c->manifest_opts);
+    av_dict_copy(&c->manifest_opts, c->avio_opts, 0);
+
+    /* drop the fragments which were skipped */
+    ff_segprefetch_drop_before(&c->prefetch, &pls->prefetch, pls->cur_seq_no);
+
+    for (; seq_no < end; seq_no++) {
+        struct fragment *seg = get_fragment(pls, seq_no);
+
+        if (!seg)
+            break;
+        ff_make_absolute_url(url, c->max_url_size, c->base_url, seg->url);
+        ret = ff_segprefetch_add(&c->prefetch, &pls->prefetch, seq_no, url,
+                                 seg->url_offset, seg->size, c->avio_opts);
+        free_fragment(&seg);
+        if (ret < 0)
+            break;
+    }
+    pls->prefetch.next_seq_no = seq_no;
+    pthread_mutex_unlock(&c->prefetch.lock);
+    av_free(url);
+
+    return ret;
+}
+
+/*
+ * Start reading the current fragment from the prefetch queue. Fragments are
+ * matched by URL, as sequence numbers may change on manifest refreshes.
+ */
+static int prefetch_open(DASHContext *c, struct representation *pls,
+                         struct fragment *seg)
+{
+    char *url;
+    int ret;
+
+    url = av_mallocz(c->max_url_size);
+    if (!url)
+        return AVERROR(ENOMEM);
+    ff_make_absolute_url(url, c->max_url_size, c->base_url, seg->url);
+    ret = ff_segprefetch_open(&c->prefetch, &pls->prefetch, 0, url, seg->url_offset);
+    av_free(url);
+
+    pls->cur_seg_offset = 0;
+    pls->cur_seg_size = seg->size;
+    return ret;
+}
+
+static void prefetch_join(struct representation **p, int n)
+{
+    for (int i = 0; i < n; i++)
+        ff_segprefetch_join(&p[i]->prefetch);
+}
+
+static void prefetch_stop(DASHContext *c)
+{
+    if (!c->prefetch.inited)
+        return;
+
+    ff_segprefetch_stop(&c->prefetch);
+    prefetch_join(c->videos, c->n_videos);
+    prefetch_join(c->audios, c->n_audios);
+    prefetch_join(c->subtitles, c->n_subtitles);
+    if (c->manifest_started)
+        pthread_join(c->manifest_thread, NULL);
+    c->manifest_started = 0;
+    ff_segprefetch_uninit(&c->prefetch);
+}
+
+#else
+
+static int prefetch_init(AVFormatContext *s)
+{
+    return 0;
+}
+
+static int prefetch_schedule(DASHContext *c, struct representation *pls)
+{
+    return AVERROR(ENOSYS);
+}
+
+static int prefetch_open(DASHContext *c, struct representation *pls,
+                         struct fragment *seg)
+{
+    return AVERROR(ENOSYS);
+}
+
+static void prefetch_stop(DASHContext *c)
+{
+}
+
+#endif /* HAVE_THREADS */
+
+static int reload_manifest(AVFormatContext *s)
+{
+#if HAVE_THREADS
+    DASHContext *c = s->priv_data;
+
+    if (c->manifest_started) {
+        FFIOContext pb;
+        char *data, *url;
+        int size, ret;
+
+        /* use the copy loaded by the manifest thread, asking for a new one
+         * if it has not been refreshed since the last reload */
+        pthread_mutex_lock(&c->prefetch.lock);
+        while (!c->manifest_data && !c->manifest_error) {
+            if (ff_check_interrupt(c->interrupt_callback)) {
+                pthread_mutex_unlock(&c->prefetch.lock);
+                return AVERROR_EXIT;
+            }
+            c->manifest_reload = 1;
+            pthread_cond_broadcast(&c->prefetch.cond);
+            ff_segprefetch_wait(&c->prefetch, 100000);
+        }
+        data = c->manifest_data;
+        size = c->manifest_size;
+        url  = c->manifest_url;
+        ret  = c->manifest_error;
+        c->manifest_data  = NULL;
+        c->manifest_url   = NULL;
+        c->manifest_error = 0;
+        pthread_mutex_unlock(&c->prefetch.lock);
+
+        if (ret >= 0) {
+            ffio_init_context(&pb, data, size, 0, NULL, NULL, NULL, NULL);
+            c->base_url = url;
+            url = NULL;
+            ret = parse_manifest(s, s->url, &pb.pub);
+        }
+        av_free(data);
+        av_free(url);
+        return ret;
+    }
+#endif
+    return parse_manifest(s, s->url, NULL);
+}
+
 static int refresh_manifest(AVFormatContext *s)
 {
     int ret = 0, i;
@@ -1494,7 +1885,7 @@ static int refresh_manifest(AVFormatContext *s)
     c->audios = NULL;
     c->n_subtitles = 0;
     c->subtitles = NULL;
-    ret = parse_manifest(s, s->url, NULL);
+    ret = reload_manifest(s);
     if (ret)
         goto finish;
 
@@ -1577,25 +1968,11 @@ static struct fragment *get_current_fragment(struct representation *pls)
 {
     int64_t min_seq_no = 0;
     int64_t max_seq_no = 0;
-    struct fragment *seg = NULL;
-    struct fragment *seg_ptr = NULL;
     DASHContext *c = pls->parent->priv_data;
 
     while (( !ff_check_interrupt(c->interrupt_callback)&& pls->n_fragments > 0)) {
         if (pls->cur_seq_no < pls->n_fragments) {
-            seg_ptr = pls->fragments[pls->cur_seq_no];
-            seg = av_mallocz(sizeof(struct fragment));
-            if (!seg) {
-                return NULL;
-            }
-            seg->url = av_strdup(seg_ptr->url);
-            if (!seg->url) {
-                av_free(seg);
-                return NULL;
-            }
-            seg->size = seg_ptr->size;
-            seg->url_offset = seg_ptr->url_offset;
-            return seg;
+            return get_fragment(pls, pls->cur_seq_no);
         } else if (c->is_live) {
             refresh_manifest(pls->parent);
         } else {
@@ -1615,45 +1992,12 @@ static struct fragment *get_current_fragment(struct representation *pls)
         } else if (pls->cur_seq_no > max_seq_no) {
             av_log(pls->parent, AV_LOG_VERBOSE, "new fragment: min[%"PRId64"] max[%"PRId64"]\n", min_seq_no, max_seq_no);
         }
-        seg = av_mallocz(sizeof(struct fragment));
-        if (!seg) {
-            return NULL;
-        }
+        return get_fragment(pls, pls->cur_seq_no);
     } else if (pls->cur_seq_no <= pls->last_seq_no) {
-        seg = av_mallocz(sizeof(struct fragment));
-        if (!seg) {
-            return NULL;
-        }
-    }
-    if (seg) {
-        char *tmpfilename;
-        if (!pls->url_template) {
-            av_log(pls->parent, AV_LOG_ERROR, "Cannot get fragment, missing template URL\n");
-            av_free(seg);
-            return NULL;
-        }
-        tmpfilename = av_mallocz(c->max_url_size);
-        if (!tmpfilename) {
-            av_free(seg);
-            return NULL;
-        }
-        ff_dash_fill_tmpl_params(tmpfilename, c->max_url_size, pls->url_template, 0, pls->cur_seq_no, 0, get_segment_start_time_based_on_timeline(pls, pls->cur_seq_no));
-        seg->url = av_strireplace(pls->url_template, pls->url_template, tmpfilename);
-        if (!seg->url) {
-            av_log(pls->parent, AV_LOG_WARNING, "Unable to resolve template url '%s', try to use origin template\n", pls->url_template);
-            seg->url = av_strdup(pls->url_template);
-            if (!seg->url) {
-                av_log(pls->parent, AV_LOG_ERROR, "Cannot resolve template url '%s'\n", pls->url_template);
-                av_free(tmpfilename);
-                av_free(seg);
-                return NULL;
-            }
-        }
-        av_free(tmpfilename);
-        seg->size = -1;
+        return get_fragment(pls, pls->cur_seq_no);
     }
 
-    return seg;
+    return NULL;
 }
 
 static int read_from_url(struct representation *pls, struct fragment *seg,
@@ -1665,7 +2009,13 @@ static int read_from_url(struct representation *pls, struct fragment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, pls->cur_seg_size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    if (pls->prefetch.cur) {
+        DASHContext *c = pls->parent->priv_data;
+        ret = ff_segprefetch_read(&c->prefetch, &pls->prefetch, pls->cur_seg_offset,
+                                  buf, buf_size);
+    } else {
+        ret = avio_read(pls->input, buf, buf_size);
+    }
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
@@ -1760,6 +2110,18 @@ static int64_t seek_data(void *opaque, int64_t offset, int whence)
     return AVERROR(ENOSYS);
 }
 
+/*
+ * Fragments are not prefetched when the nested demuxer may seek within them,
+ * see seek_data().
+ */
+static int use_prefetch(DASHContext *c, struct representation *v)
+{
+    if (!c->prefetch_segments)
+        return 0;
+    return c->is_live || !v->n_fragments ||
+           (v->n_fragments > 1 && v->init_sec_data_len);
+}
+
 static int read_data(void *opaque, uint8_t *buf, int buf_size)
 {
     int ret = 0;
@@ -1767,7 +2129,7 @@ static int read_data(void *opaque, uint8_t *buf, int buf_size)
     DASHContext *c = v->parent->priv_data;
 
 restart:
-    if (!v->input) {
+    if (!v->input && !v->prefetch.cur) {
         free_fragment(&v->cur_seg);
         v->cur_seg = get_current_fragment(v);
         if (!v->cur_seg) {
@@ -1780,7 +2142,16 @@ restart:
         if (ret)
             goto end;
 
-        ret = open_input(c, v, v->cur_seg);
+        ret = AVERROR(ENOENT);
+        if (use_prefetch(c, v)) {
+            ret = prefetch_schedule(c, v);
+            if (ret >= 0)
+                ret = prefetch_open(c, v, v->cur_seg);
+            if (ret == AVERROR(ENOENT))
+                ff_segprefetch_flush(&c->prefetch, &v->prefetch);
+        }
+        if (ret == AVERROR(ENOENT) || ret == AVERROR(ENOSYS))
+            ret = open_input(c, v, v->cur_seg);
         if (ret < 0) {
             if (ff_check_interrupt(c->interrupt_callback)) {
                 ret = AVERROR_EXIT;
@@ -2036,6 +2407,9 @@ static int dash_read_header(AVFormatContext *s)
         av_dict_set(&c->avio_opts, "seekable", "0", 0);
     }
 
+    if ((ret = prefetch_init(s)) < 0)
+        return ret;
+
     if(c->n_videos)
         c->is_init_section_common_video = is_common_init_section_exist(c->videos, c->n_videos);
 
@@ -2129,6 +2503,7 @@ static int dash_read_header(AVFormatContext *s)
 
 static void recheck_discard_flags(AVFormatContext *s, struct representation **p, int n)
 {
+    DASHContext *c = s->priv_data;
     int i, j;
 
     for (i = 0; i < n; i++) {
@@ -2147,6 +2522,7 @@ static void recheck_discard_flags(AVFormatContext *s, struct representation **p,
         } else if (!needed && pls->ctx) {
             close_demux_for_component(pls);
             ff_format_io_close(pls->parent, &pls->input);
+            ff_segprefetch_flush(&c->prefetch, &pls->prefetch);
             av_log(s, AV_LOG_INFO, "No longer receiving stream_index %d\n", pls->stream_index);
         }
     }
@@ -2208,6 +2584,7 @@ static int dash_read_packet(AVFormatContext *s, AVPacket *pkt)
             cur->cur_seg_offset = 0;
             cur->init_sec_buf_read_offset = 0;
             ff_format_io_close(cur->parent, &cur->input);
+            ff_segprefetch_release(&c->prefetch, &cur->prefetch, &c->avio_opts);
             ret = reopen_demux_for_component(s, cur);
             cur->is_restart_needed = 0;
         }
@@ -2218,16 +2595,21 @@ static int dash_read_packet(AVFormatContext *s, AVPacket *pkt)
 static int dash_close(AVFormatContext *s)
 {
     DASHContext *c = s->priv_data;
+    prefetch_stop(c);
     free_audio_list(c);
     free_video_list(c);
     free_subtitle_list(c);
     av_dict_free(&c->avio_opts);
+    av_dict_free(&c->manifest_opts);
+    av_freep(&c->manifest_data);
+    av_freep(&c->manifest_url);
     av_freep(&c->base_url);
     return 0;
 }
 
 static int dash_seek(AVFormatContext *s, struct representation *pls, int64_t seek_pos_msec, int flags, int dry_run)
 {
+    DASHContext *c = s->priv_data;
     int ret = 0;
     int i = 0;
     int j = 0;
@@ -2247,6 +2629,7 @@ static int dash_seek(AVFormatContext *s, struct representation *pls, int64_t see
     }
 
     ff_format_io_close(pls->parent, &pls->input);
+    ff_segprefetch_flush(&c->prefetch, &pls->prefetch);
 
     // find the nearest fragment
     if (pls->n_timelines > 0 && pls->fragment_timescale > 0) {
@@ -2344,6 +2727,10 @@ static const AVOption dash_options[] = {
         OFFSET(allowed_extensions), AV_OPT_TYPE_STRING,
         {.str = "aac,m4a,m4s,m4v,mov,mp4,webm,ts"},
         INT_MIN, INT_MAX, FLAGS},
+    {"prefetch_segments", "Number of fragments to download ahead of the one being read, 0 = disable",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 100, FLAGS},
+    {"prefetch_size", "Maximum amount of memory used for prefetched fragments",
+        OFFSET(prefetch_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
@@ -48,6 +48,7 @@
 #include "internal.h"
 #include "isom.h"
 #include "os_support.h"
+#include "uploadpool.h"
 #include "url.h"
 #include "vpcc.h"
 #include "dash.h"
@@ -197,6 +198,9 @@ typedef struct DASHContext {
     AVRational min_playback_rate;
     AVRational max_playback_rate;
     int64_t update_period;
+    int upload_threads;
+    int upload_retries;
+    UploadPool *upload_pool;
 } DASHContext;
 
 static struct codec_string {
@@ -484,6 +488,63 @@ static void set_http_options(AVDictionary **options, DASHContext *c)
         av_dict_set_int(options, "timeout", c->timeout, 0);
 }
 
+/* With an upload pool, manifests are written to a memory buffer and uploaded
+ * once complete, after all the segments queued before them. */
+static int dashenc_open_out(AVFormatContext *s, AVIOContext **pb, char *filename,
+                            AVDictionary **options)
+{
+    DASHContext *c = s->priv_data;
+
+    if (c->upload_pool)
+        return avio_open_dyn_buf(pb);
+    return dashenc_io_open(s, pb, filename, options);
+}
+
+static int dashenc_close_out(AVFormatContext *s, AVIOContext **pb, char *filename,
+                             const char *final_filename)
+{
+    DASHContext *c = s->priv_data;
+    AVDictionary *opts = NULL;
+    uint8_t *buffer;
+    int size;
+
+    if (!c->upload_pool) {
+        dashenc_io_close(s, pb, filename);
+        return 0;
+    }
+    if (!*pb)
+        return 0;
+    size = avio_close_dyn_buf(*pb, &buffer);
+    *pb = NULL;
+    set_http_options(&opts, c);
+    return ff_upload_pool_submit(c->upload_pool, filename, final_filename,
+                                 buffer, size, &opts, -1, 1);
+}
+
+static int upload_dynbuf(AVFormatContext *s, OutputStream *os, int group,
+                         int *range_length)
+{
+    DASHContext *c = s->priv_data;
+    AVDictionary *opts = NULL;
+    const char *proto = avio_find_protocol_name(s->url);
+    int use_rename = proto && !strcmp(proto, "file");
+    uint8_t *buffer;
+    int ret, err;
+
+    av_write_frame(os->ctx, NULL);
+    *range_length = avio_close_dyn_buf(os->ctx->pb, &buffer);
+    os->ctx->pb = NULL;
+    os->written_len = 0;
+
+    set_http_options(&opts, c);
+    err = ff_upload_pool_submit(c->upload_pool, os->temp_path,
+                                use_rename ? os->full_path : NULL, buffer,
+                                *range_length, &opts, group, 0);
+    if ((ret = avio_open_dyn_buf(&os->ctx->pb)) < 0)
+        return ret;
+    return c->ignore_io_errors ? 0 : err;
+}
+
 static void get_hls_playlist_name(char *playlist_name, int string_size,
                                   const char *base_url, int id) {
     if (base_url)
@@ -529,7 +590,7 @@ static void write_hls_media_playlist(OutputStream *os, AVFormatContext *s,
     snprintf(temp_filename_hls, sizeof(temp_filename_hls), use_rename ? "%s.tmp" : "%s", filename_hls);
 
     set_http_options(&http_opts, c);
-    ret = dashenc_io_open(s, &c->m3u8_out, temp_filename_hls, &http_opts);
+    ret = dashenc_open_out(s, &c->m3u8_out, temp_filename_hls, &http_opts);
     av_dict_free(&http_opts);
     if (ret < 0) {
         handle_io_open_error(s, ret, temp_filename_hls);
@@ -575,9 +636,10 @@ static void write_hls_media_playlist(OutputStream *os, AVFormatContext *s,
     if (final)
         ff_hls_write_end_list(c->m3u8_out);
 
-    dashenc_io_close(s, &c->m3u8_out, temp_filename_hls);
+    dashenc_close_out(s, &c->m3u8_out, temp_filename_hls,
+                      use_rename ? filename_hls : NULL);
 
-    if (use_rename)
+    if (use_rename && !c->upload_pool)
         ff_rename(temp_filename_hls, filename_hls, os->ctx);
 }
 
@@ -604,6 +666,8 @@ static void dash_free(AVFormatContext *s)
     DASHContext *c = s->priv_data;
     int i, j;
 
+    ff_upload_pool_free(&c->upload_pool);
+
     if (c->as) {
         for (i = 0; i < c->nb_as; i++) {
             av_dict_free(&c->as[i].metadata);
@@ -1146,7 +1210,7 @@ static int write_manifest(AVFormatContext *s, int final)
 
     snprintf(temp_filename, sizeof(temp_filename), use_rename ? "%s.tmp" : "%s", s->url);
     set_http_options(&opts, c);
-    ret = dashenc_io_open(s, &c->mpd_out, temp_filename, &opts);
+    ret = dashenc_open_out(s, &c->mpd_out, temp_filename, &opts);
     av_dict_free(&opts);
     if (ret < 0) {
         return handle_io_open_error(s, ret, temp_filename);
@@ -1238,9 +1302,12 @@ static int write_manifest(AVFormatContext *s, int final)
 
     avio_printf(out, "</MPD>\n");
     avio_flush(out);
-    dashenc_io_close(s, &c->mpd_out, temp_filename);
+    if ((ret = dashenc_close_out(s, &c->mpd_out, temp_filename,
+                                 use_rename ? s->url : NULL)) < 0 &&
+        !c->ignore_io_errors)
+        return ret;
 
-    if (use_rename) {
+    if (use_rename && !c->upload_pool) {
         if ((ret = ff_rename(temp_filename, s->url, s)) < 0)
             return ret;
     }
@@ -1261,7 +1328,7 @@ static int write_manifest(AVFormatContext *s, int final)
         snprintf(temp_filename, sizeof(temp_filename), use_rename ? "%s.tmp" : "%s", filename_hls);
 
         set_http_options(&opts, c);
-        ret = dashenc_io_open(s, &c->m3u8_out, temp_filename, &opts);
+        ret = dashenc_open_out(s, &c->m3u8_out, temp_filename, &opts);
         av_dict_free(&opts);
         if (ret < 0) {
             return handle_io_open_error(s, ret, temp_filename);
@@ -1354,8 +1421,11 @@ static int write_manifest(AVFormatContext *s, int final)
             }
         }
 
-        dashenc_io_close(s, &c->m3u8_out, temp_filename);
-        if (use_rename)
+        if ((ret = dashenc_close_out(s, &c->m3u8_out, temp_filename,
+                                     use_rename ? filename_hls : NULL)) < 0 &&
+            !c->ignore_io_errors)
+            return ret;
+        if (use_rename && !c->upload_pool)
             if ((ret = ff_rename(temp_filename, filename_hls, s)) < 0)
                 return ret;
         c->master_playlist_created = 1;
@@ -1459,6 +1529,18 @@ static int dash_init(AVFormatContext *s)
         c->min_playback_rate = c->max_playback_rate = (AVRational) {1, 1};
     }
 
+    if (c->upload_threads) {
+        if (c->single_file || c->streaming) {
+            av_log(s, AV_LOG_WARNING, "Upload threads option will be ignored as it requires "
+                   "separate segment files without streaming\n");
+        } else {
+            ret = ff_upload_pool_init(&c->upload_pool, s, c->upload_threads,
+                                      c->upload_retries, c->http_persistent);
+            if (ret < 0 && ret != AVERROR(ENOSYS))
+                return ret;
+        }
+    }
+
     av_strlcpy(c->dirname, s->url, sizeof(c->dirname));
     ptr = strrchr(c->dirname, '/');
     if (ptr) {
@@ -1957,14 +2039,17 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
         if (c->single_file)
             snprintf(os->full_path, sizeof(os->full_path), "%s%s", c->dirname, os->initfile);
 
-        ret = flush_dynbuf(c, os, &range_length);
+        if (c->upload_pool)
+            ret = upload_dynbuf(s, os, i, &range_length);
+        else
+            ret = flush_dynbuf(c, os, &range_length);
         if (ret < 0)
             break;
         os->packets_written = 0;
 
         if (c->single_file) {
             find_index_range(s, os->full_path, os->pos, &index_length);
-        } else {
+        } else if (!c->upload_pool) {
             dashenc_io_close(s, &os->out, os->temp_path);
 
             if (use_rename) {
@@ -2256,11 +2341,13 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
                  os->filename);
         snprintf(os->temp_path, sizeof(os->temp_path),
                  use_rename ? "%s.tmp" : "%s", os->full_path);
-        set_http_options(&opts, c);
-        ret = dashenc_io_open(s, &os->out, os->temp_path, &opts);
-        av_dict_free(&opts);
-        if (ret < 0) {
-            return handle_io_open_error(s, ret, os->temp_path);
+        if (!c->upload_pool) {
+            set_http_options(&opts, c);
+            ret = dashenc_io_open(s, &os->out, os->temp_path, &opts);
+            av_dict_free(&opts);
+            if (ret < 0) {
+                return handle_io_open_error(s, ret, os->temp_path);
+            }
         }
 
         // in streaming mode, the segments are available for playing
@@ -2295,7 +2382,7 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
 static int dash_write_trailer(AVFormatContext *s)
 {
     DASHContext *c = s->priv_data;
-    int i;
+    int i, ret = 0;
 
     if (s->nb_streams > 0) {
         OutputStream *os = &c->streams[0];
@@ -2311,6 +2398,12 @@ static int dash_write_trailer(AVFormatContext *s)
     }
     dash_flush(s, 1, -1);
 
+    if (c->upload_pool) {
+        ret = ff_upload_pool_flush(c->upload_pool);
+        if (c->ignore_io_errors)
+            ret = 0;
+    }
+
     if (c->remove_at_exit) {
         for (i = 0; i < s->nb_streams; ++i) {
             OutputStream *os = &c->streams[i];
@@ -2331,7 +2424,7 @@ static int dash_write_trailer(AVFormatContext *s)
         }
     }
 
-    return 0;
+    return ret;
 }
 
 static int dash_check_bitstream(AVFormatContext *s, AVStream *st,
@@ -2403,6 +2496,8 @@ static const AVOption options[] = {
     { "min_playback_rate", "Set desired minimum playback rate", OFFSET(min_playback_rate), AV_OPT_TYPE_RATIONAL, { .dbl = 1.0 }, 0.5, 1.5, E },
     { "max_playback_rate", "Set desired maximum playback rate", OFFSET(max_playback_rate), AV_OPT_TYPE_RATIONAL, { .dbl = 1.0 }, 0.5, 1.5, E },
     { "update_period", "Set the mpd update interval", OFFSET(update_period), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, E},
+    { "upload_threads", "Number of segments and manifests uploaded concurrently, 0 to write them from the muxing thread", OFFSET(upload_threads), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, E},
+    { "upload_retries", "Number of times a failed upload is retried", OFFSET(upload_retries), AV_OPT_TYPE_INT, {.i64 = 3}, 0, INT_MAX, E},
     { NULL },
 };
 
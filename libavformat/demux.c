@@ -31,6 +31,7 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/time.h"
 #include "libavutil/timestamp.h"
 
@@ -147,6 +148,17 @@ static int set_codec_from_probe_data(AVFormatContext *s, AVStream *st,
     return 0;
 }
 
+static int probe_input_buffer(AVFormatContext *s, const char *filename)
+{
+    if (s->probe_info) {
+        int score;
+        if ((s->iformat = ff_probe_info_format(s, &score)))
+            return score;
+    }
+    return av_probe_input_buffer2(s->pb, &s->iformat, filename,
+                                  s, 0, s->format_probesize);
+}
+
 static int init_input(AVFormatContext *s, const char *filename,
                       AVDictionary **options)
 {
@@ -157,8 +169,7 @@ static int init_input(AVFormatContext *s, const char *filename,
     if (s->pb) {
         s->flags |= AVFMT_FLAG_CUSTOM_IO;
         if (!s->iformat)
-            return av_probe_input_buffer2(s->pb, &s->iformat, filename,
-                                          s, 0, s->format_probesize);
+            return probe_input_buffer(s, filename);
         else if (s->iformat->flags & AVFMT_NOFILE)
             av_log(s, AV_LOG_WARNING, "Custom AVIOContext makes no sense and "
                                       "will be ignored with AVFMT_NOFILE format.\n");
@@ -174,8 +185,7 @@ static int init_input(AVFormatContext *s, const char *filename,
 
     if (s->iformat)
         return 0;
-    return av_probe_input_buffer2(s->pb, &s->iformat, filename,
-                                  s, 0, s->format_probesize);
+    return probe_input_buffer(s, filename);
 }
 
 static int update_stream_avctx(AVFormatContext *s)
@@ -2060,6 +2070,89 @@ fail:
     return ret;
 }
 
+/**
+ * Deferred try_decode_frame() calls, run concurrently for the different
+ * streams by avformat_find_stream_info() when probe_threads is not 1.
+ */
+typedef struct ProbeDecodeContext {
+    AVFormatContext *ic;
+    AVDictionary **options;
+    unsigned orig_nb_streams;
+    AVSliceThread *thread;
+    /* packets to decode, in reading order */
+    const AVPacket **pkts;
+    unsigned nb_pkts, pkts_size;
+    /* streams of the packets to decode, one job each */
+    int *streams;
+    unsigned nb_streams, streams_size;
+} ProbeDecodeContext;
+
+static void probe_decode_worker(void *priv, int jobnr, int threadnr,
+                                int nb_jobs, int nb_threads)
+{
+    ProbeDecodeContext *const pd = priv;
+    const int stream_index = pd->streams[jobnr];
+    AVStream *const st = pd->ic->streams[stream_index];
+
+    for (unsigned i = 0; i < pd->nb_pkts; i++)
+        if (pd->pkts[i]->stream_index == stream_index)
+            try_decode_frame(pd->ic, st, pd->pkts[i],
+                             (pd->options && stream_index < pd->orig_nb_streams)
+                             ? &pd->options[stream_index] : NULL);
+}
+
+static void probe_decode_flush(ProbeDecodeContext *pd)
+{
+    pd->nb_streams = 0;
+    for (unsigned i = 0; i < pd->nb_pkts; i++) {
+        const int stream_index = pd->pkts[i]->stream_index;
+        unsigned j;
+
+        for (j = 0; j < pd->nb_streams; j++)
+            if (pd->streams[j] == stream_index)
+                break;
+        if (j == pd->nb_streams)
+            pd->streams[pd->nb_streams++] = stream_index;
+    }
+    if (pd->nb_streams)
+        avpriv_slicethread_execute(pd->thread, pd->nb_streams, 0);
+    pd->nb_pkts = 0;
+}
+
+/**
+ * Queue the decoding of a packet, which must stay valid until the next
+ * probe_decode_flush(), and run the queue once it holds enough packets
+ * to keep the threads busy.
+ */
+static int probe_decode_packet(ProbeDecodeContext *pd, const AVPacket *pkt)
+{
+    AVFormatContext *const ic = pd->ic;
+    void *tmp;
+
+    tmp = av_fast_realloc(pd->pkts, &pd->pkts_size,
+                          (pd->nb_pkts + 1) * sizeof(*pd->pkts));
+    if (!tmp)
+        return AVERROR(ENOMEM);
+    pd->pkts = tmp;
+    tmp = av_fast_realloc(pd->streams, &pd->streams_size,
+                          FFMIN(pd->nb_pkts + 1, ic->nb_streams) * sizeof(*pd->streams));
+    if (!tmp)
+        return AVERROR(ENOMEM);
+    pd->streams = tmp;
+
+    pd->pkts[pd->nb_pkts++] = pkt;
+    if (pd->nb_pkts >= ic->nb_streams)
+        probe_decode_flush(pd);
+    return 0;
+}
+
+static void probe_decode_uninit(ProbeDecodeContext *pd)
+{
+    avpriv_slicethread_free(&pd->thread);
+    av_freep(&pd->pkts);
+    av_freep(&pd->streams);
+}
+
 static int chapter_start_cmp(const void *p1, const void *p2)
 {
     const AVChapter *const ch1 = *(AVChapter**)p1;
@@ -2403,9 +2496,23 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     int64_t probesize = ic->probesize;
     int eof_reached = 0;
     int *missing_streams = av_opt_ptr(ic->iformat->priv_class, ic->priv_data, "missing_streams");
+    const int required = ic->probe_required;
+    ProbeDecodeContext pd = { .ic = ic, .options = options,
+                              .orig_nb_streams = orig_nb_streams };
 
     flush_codecs = probesize > 0;
 
+    if (ic->probe_info) {
+        ret = ff_probe_info_apply(ic);
+        if (ret < 0)
+            goto find_stream_info_err;
+        if (ret > 0) {
+            av_log(ic, AV_LOG_DEBUG, "Stream information restored from probe info\n");
+            ret = compute_chapters_end(ic);
+            goto find_stream_info_err;
+        }
+    }
+
     av_opt_set_int(ic, "skip_clear", 1, AV_OPT_SEARCH_CHILDREN);
 
     max_stream_analyze_duration = max_analyze_duration;
@@ -2490,6 +2597,17 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
             av_dict_free(&thread_opt);
     }
 
+    /* The packets must outlive their deferred decoding. */
+    if (ic->probe_threads != 1 && !(ic->flags & AVFMT_FLAG_NOBUFFER)) {
+        ret = avpriv_slicethread_create(&pd.thread, &pd, probe_decode_worker,
+                                        NULL, ic->probe_threads);
+        if (ret <= 1)
+            avpriv_slicethread_free(&pd.thread);
+        else
+            av_log(ic, AV_LOG_DEBUG, "Decoding with %d threads\n", ret);
+        ret = 0;
+    }
+
     read_size = 0;
     for (;;) {
         const AVPacket *pkt;
@@ -2511,7 +2629,8 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
             int fps_analyze_framecount = 20;
             int count;
 
-            if (!has_codec_parameters(st, NULL))
+            if ((required & AVFMT_PROBE_REQUIRE_CODEC_PARAMS) &&
+                !has_codec_parameters(st, NULL))
                 break;
             /* If the timebase is coarse (like the usual millisecond precision
              * of mkv), we need to analyze more frames to reliably arrive at
@@ -2528,20 +2647,24 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
             count = (ic->iformat->flags & AVFMT_NOTIMESTAMPS) ?
                        sti->info->codec_info_duration_fields/2 :
                        sti->info->duration_count;
-            if (!(st->r_frame_rate.num && st->avg_frame_rate.num) &&
+            if ((required & AVFMT_PROBE_REQUIRE_FRAME_RATE) &&
+                !(st->r_frame_rate.num && st->avg_frame_rate.num) &&
                 st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
                 if (count < fps_analyze_framecount)
                     break;
             }
             // Look at the first 3 frames if there is evidence of frame delay
             // but the decoder delay is not set.
-            if (sti->info->frame_delay_evidence && count < 2 && sti->avctx->has_b_frames == 0)
+            if ((required & AVFMT_PROBE_REQUIRE_DECODE_DELAY) &&
+                sti->info->frame_delay_evidence && count < 2 && sti->avctx->has_b_frames == 0)
                 break;
-            if (!sti->avctx->extradata &&
+            if ((required & AVFMT_PROBE_REQUIRE_EXTRADATA) &&
+                !sti->avctx->extradata &&
                 (!sti->extract_extradata.inited || sti->extract_extradata.bsf) &&
                 extract_extradata_check(st))
                 break;
-            if (sti->first_dts == AV_NOPTS_VALUE &&
+            if ((required & AVFMT_PROBE_REQUIRE_START_TIME) &&
+                sti->first_dts == AV_NOPTS_VALUE &&
                 !(ic->iformat->flags & AVFMT_NOTIMESTAMPS) &&
                 sti->codec_info_nb_frames < ((st->disposition & AV_DISPOSITION_ATTACHED_PIC) ? 1 : ic->max_ts_probe) &&
                 (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO ||
@@ -2553,8 +2676,10 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
             if (i == ic->nb_streams) {
                 analyzed_all_streams = 1;
                 /* NOTE: If the format has no header, then we need to read some
-                 * packets to get most of the streams, so we cannot stop here. */
-                if (!(ic->ctx_flags & AVFMTCTX_NOHEADER)) {
+                 * packets to get most of the streams, so we cannot stop here,
+                 * and at least until the first stream appears. */
+                if (!(ic->ctx_flags & AVFMTCTX_NOHEADER) ||
+                    (ic->nb_streams && !(required & AVFMT_PROBE_REQUIRE_STREAMS))) {
                     /* If we found the info for all the codecs, we can stop. */
                     ret = count;
                     av_log(ic, AV_LOG_DEBUG, "All info found\n");
@@ -2718,8 +2843,13 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+        if (pd.thread) {
+            ret = probe_decode_packet(&pd, pkt);
+            if (ret < 0)
+                goto unref_then_goto_end;
+        } else
+            try_decode_frame(ic, st, pkt,
+                             (options && i < orig_nb_streams) ? &options[i] : NULL);
 
         if (ic->flags & AVFMT_FLAG_NOBUFFER)
             av_packet_unref(pkt1);
@@ -2728,6 +2858,9 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         count++;
     }
 
+    if (pd.thread)
+        probe_decode_flush(&pd);
+
     if (eof_reached) {
         for (unsigned stream_index = 0; stream_index < ic->nb_streams; stream_index++) {
             AVStream *const st = ic->streams[stream_index];
@@ -2928,6 +3061,7 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     }
 
 find_stream_info_err:
+    probe_decode_uninit(&pd);
     for (unsigned i = 0; i < ic->nb_streams; i++) {
         AVStream *const st  = ic->streams[i];
         FFStream *const sti = ffstream(st);
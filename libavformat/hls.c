@@ -27,13 +27,17 @@
  * https://www.rfc-editor.org/rfc/rfc8216.txt
  */
 
+#include "config.h"
+
 #include "libavformat/http.h"
 #include "libavutil/avstring.h"
 #include "libavutil/avassert.h"
+#include "libavutil/bprint.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "avformat.h"
 #include "internal.h"
@@ -41,6 +45,7 @@
 #include "id3v2.h"
 
 #include "hls_sample_encryption.h"
+#include "segprefetch.h"
 
 #define INITIAL_BUFFER_SIZE 32768
 
@@ -165,6 +170,19 @@ struct playlist {
      * playlist, if any. */
     int n_init_sections;
     struct segment **init_sections;
+
+    /* Segment prefetching. The fields following the queue are shared with
+     * the prefetch thread and protected by HLSContext.prefetch.lock. */
+    SegPrefetchQueue prefetch;
+    AVDictionary *prefetch_opts;
+    int prefetch_live;                      /* reload the playlist in the background */
+    int prefetch_reload;                    /* reload requested by the demuxer */
+    int64_t prefetch_reload_interval;
+    int64_t prefetch_load_time;
+    char *prefetch_pls_data;                /* last playlist loaded in the background */
+    int prefetch_pls_size;
+    char *prefetch_pls_url;
+    int prefetch_pls_error;
 };
 
 /*
@@ -220,6 +238,9 @@ typedef struct HLSContext {
     int http_seekable;
     AVIOContext *playlist_pb;
     HLSCryptoContext  crypto_ctx;
+    int prefetch_segments;
+    int64_t prefetch_size;
+    SegPrefetch prefetch;
 } HLSContext;
 
 static void free_segment_dynarray(struct segment **segments, int n_segments)
@@ -263,6 +284,10 @@ static void free_playlist_list(HLSContext *c)
         av_dict_free(&pls->id3_initial);
         ff_id3v2_free_extra_meta(&pls->id3_deferred_extra);
         av_freep(&pls->init_sec_buf);
+        ff_segprefetch_free_queue(&pls->prefetch);
+        av_dict_free(&pls->prefetch_opts);
+        av_freep(&pls->prefetch_pls_data);
+        av_freep(&pls->prefetch_pls_url);
         av_packet_free(&pls->pkt);
         av_freep(&pls->pb.pub.buffer);
         ff_format_io_close(c->ctx, &pls->input);
@@ -1026,6 +1051,255 @@ static struct segment *next_segment(struct playlist *pls)
     return pls->segments[n];
 }
 
+static int64_t default_reload_interval(struct playlist *pls)
+{
+    return pls->n_segments > 0 ?
+                          pls->segments[pls->n_segments - 1]->duration :
+                          pls->target_duration;
+}
+
+#if HAVE_THREADS
+
+static int prefetch_download(HLSContext *c, struct playlist *pls,
+                             SegPrefetchItem *ps, AVIOContext **pb)
+{
+    AVDictionary *opts = NULL;
+    int is_http = 0;
+    int ret;
+
+    if (c->http_persistent)
+        av_dict_set(&opts, "multiple_requests", "1", 0);
+    if (ps->size >= 0) {
+        av_dict_set_int(&opts, "offset", ps->url_offset, 0);
+        av_dict_set_int(&opts, "end_offset", ps->url_offset + ps->size, 0);
+    }
+
+    av_log(pls->parent, AV_LOG_VERBOSE, "HLS prefetch for url '%s', offset %"PRId64", playlist %d\n",
+           ps->url, ps->url_offset, pls->index);
+
+    ret = open_url(pls->parent, pb, ps->url, &ps->opts, opts, &is_http);
+    av_dict_free(&opts);
+    if (ret >= 0 && !is_http && ps->url_offset) {
+        int64_t seekret = avio_seek(*pb, ps->url_offset, SEEK_SET);
+        if (seekret < 0)
+            ret = seekret;
+    }
+    if (ret >= 0)
+        ret = ff_segprefetch_fill(&c->prefetch, &pls->prefetch, ps, *pb);
+
+    /* keep the connection open for the next request, as read_data() does */
+    if (ret < 0 || !is_http || !c->http_persistent)
+        ff_format_io_close(pls->parent, pb);
+    return ret;
+}
+
+static void prefetch_load_playlist(HLSContext *c, struct playlist *pls,
+                                   AVIOContext **pb, AVDictionary **opts)
+{
+    int is_http = av_strstart(pls->url, "http", NULL);
+    uint8_t *new_url = NULL;
+    char *data = NULL;
+    AVBPrint bp;
+    int ret = AVERROR(EIO);
+
+    if (*pb)
+        ret = open_url_keepalive(c->ctx, pb, pls->url, NULL);
+    if (ret < 0) {
+        if (c->http_persistent)
+            av_dict_set(opts, "multiple_requests", "1", 0);
+        ret = c->ctx->io_open(c->ctx, pb, pls->url, AVIO_FLAG_READ, opts);
+    }
+    av_dict_free(opts);
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    if (ret >= 0) {
+        ret = avio_read_to_bprint(*pb, &bp, INT_MAX);
+        if (ret >= 0 && !av_bprint_is_complete(&bp))
+            ret = AVERROR(ENOMEM);
+        av_opt_get(*pb, "location", AV_OPT_SEARCH_CHILDREN, &new_url);
+        if (ret < 0 || !is_http || !c->http_persistent)
+            ff_format_io_close(c->ctx, pb);
+    }
+    if (ret >= 0)
+        ret = av_bprint_finalize(&bp, &data);
+    else
+        av_bprint_finalize(&bp, NULL);
+
+    pthread_mutex_lock(&c->prefetch.lock);
+    av_freep(&pls->prefetch_pls_data);
+    av_freep(&pls->prefetch_pls_url);
+    pls->prefetch_pls_data  = data;
+    pls->prefetch_pls_size  = data ? strlen(data) : 0;
+    pls->prefetch_pls_url   = new_url;
+    pls->prefetch_pls_error = FFMIN(ret, 0);
+    pls->prefetch_load_time = av_gettime_relative();
+    pls->prefetch_reload    = 0;
+    pthread_cond_broadcast(&c->prefetch.cond);
+    pthread_mutex_unlock(&c->prefetch.lock);
+}
+
+/*
+ * Download the queued segments of a playlist in order and, for live
+ * playlists, keep a fresh copy of the playlist at hand.
+ */
+static void *prefetch_thread(void *arg)
+{
+    struct playlist *pls = arg;
+    HLSContext *c = pls->parent->priv_data;
+    AVIOContext *seg_pb = NULL, *pls_pb = NULL;
+
+    pthread_mutex_lock(&c->prefetch.lock);
+    while (!c->prefetch.stop) {
+        SegPrefetchItem *ps;
+        int64_t reload_time = pls->prefetch_load_time +
+                              FFMAX(pls->prefetch_reload_interval, 100000);
+        int64_t now = av_gettime_relative();
+
+        if (pls->prefetch_live && (pls->prefetch_reload || now >= reload_time)) {
+            AVDictionary *opts = NULL;
+            av_dict_copy(&opts, pls->prefetch_opts, 0);
+            pthread_mutex_unlock(&c->prefetch.lock);
+            prefetch_load_playlist(c, pls, &pls_pb, &opts);
+            pthread_mutex_lock(&c->prefetch.lock);
+            continue;
+        }
+
+        if ((ps = ff_segprefetch_next(&c->prefetch, &pls->prefetch))) {
+            int ret;
+
+            pthread_mutex_unlock(&c->prefetch.lock);
+            ret = prefetch_download(c, pls, ps, &seg_pb);
+            pthread_mutex_lock(&c->prefetch.lock);
+            ff_segprefetch_done(&c->prefetch, &pls->prefetch, ps, ret);
+            continue;
+        }
+
+        if (pls->prefetch_live)
+            ff_segprefetch_wait(&c->prefetch, reload_time - now);
+        else
+            pthread_cond_wait(&c->prefetch.cond, &c->prefetch.lock);
+    }
+    pthread_mutex_unlock(&c->prefetch.lock);
+
+    ff_format_io_close(pls->parent, &seg_pb);
+    ff_format_io_close(c->ctx, &pls_pb);
+    return NULL;
+}
+
+/* Queue the segments following the current one for download. */
+static int prefetch_schedule(HLSContext *c, struct playlist *pls)
+{
+    int64_t seq_no, end;
+    int ret = 0;
+
+    if (!pls->prefetch.started) {
+        pls->prefetch_live            = !pls->finished;
+        pls->prefetch_load_time       = pls->last_load_time;
+        pls->prefetch_reload_interval = default_reload_interval(pls);
+        av_dict_copy(&pls->prefetch_opts, c->avio_opts, 0);
+        ret = ff_segprefetch_start(&c->prefetch, &pls->prefetch, prefetch_thread, pls);
+        if (ret < 0)
+            return ret;
+    }
+
+    pthread_mutex_lock(&c->prefetch.lock);
+    av_dict_free(&pls->prefetch_opts);
+    av_dict_copy(&pls->prefetch_opts, c->avio_opts, 0);
+
+    /* drop the segments which were skipped */
+    ff_segprefetch_drop_before(&c->prefetch, &pls->prefetch, pls->cur_seq_no);
+
+    seq_no = FFMAX(pls->prefetch.next_seq_no, pls->cur_seq_no);
+    end    = FFMIN(pls->cur_seq_no + c->prefetch_segments,
+                   pls->start_seq_no + pls->n_segments);
+    for (; seq_no < end; seq_no++) {
+        struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+
+        /* encrypted segments need the key handling of open_input() */
+        if (seg->key_type != KEY_NONE)
+            break;
+        ret = ff_segprefetch_add(&c->prefetch, &pls->prefetch, seq_no, seg->url,
+                                 seg->url_offset, seg->size, c->avio_opts);
+        if (ret < 0)
+            break;
+    }
+    pls->prefetch.next_seq_no = seq_no;
+    pthread_mutex_unlock(&c->prefetch.lock);
+
+    return ret;
+}
+
+static void prefetch_stop(HLSContext *c)
+{
+    if (!c->prefetch.inited)
+        return;
+
+    ff_segprefetch_stop(&c->prefetch);
+    for (int i = 0; i < c->n_playlists; i++)
+        ff_segprefetch_join(&c->playlists[i]->prefetch);
+    ff_segprefetch_uninit(&c->prefetch);
+}
+
+#else
+
+static int prefetch_schedule(HLSContext *c, struct playlist *pls)
+{
+    return AVERROR(ENOSYS);
+}
+
+static void prefetch_stop(HLSContext *c)
+{
+}
+
+#endif /* HAVE_THREADS */
+
+static int reload_playlist(HLSContext *c, struct playlist *pls,
+                           int64_t reload_interval)
+{
+#if HAVE_THREADS
+    if (pls->prefetch.started) {
+        FFIOContext pb;
+        char *data, *url;
+        int size, ret;
+
+        /* use the copy loaded by the prefetch thread, asking for a new one
+         * if it has not been refreshed since the last reload */
+        pthread_mutex_lock(&c->prefetch.lock);
+        pls->prefetch_reload_interval = reload_interval;
+        while (!pls->prefetch_pls_data && !pls->prefetch_pls_error) {
+            if (ff_check_interrupt(c->interrupt_callback)) {
+                pthread_mutex_unlock(&c->prefetch.lock);
+                return AVERROR_EXIT;
+            }
+            pls->prefetch_reload = 1;
+            pthread_cond_broadcast(&c->prefetch.cond);
+            ff_segprefetch_wait(&c->prefetch, 100000);
+        }
+        data = pls->prefetch_pls_data;
+        size = pls->prefetch_pls_size;
+        url  = pls->prefetch_pls_url;
+        ret  = pls->prefetch_pls_error;
+        pls->prefetch_pls_data  = NULL;
+        pls->prefetch_pls_url   = NULL;
+        pls->prefetch_pls_error = 0;
+        pthread_mutex_unlock(&c->prefetch.lock);
+
+        if (ret >= 0) {
+            ffio_init_context(&pb, data, size, 0, NULL, NULL, NULL, NULL);
+            ret = parse_playlist(c, url ? url : pls->url, pls, &pb.pub);
+        }
+        av_free(data);
+        av_free(url);
+
+        pthread_mutex_lock(&c->prefetch.lock);
+        pls->prefetch_live = !pls->finished;
+        pthread_mutex_unlock(&c->prefetch.lock);
+        return ret;
+    }
+#endif
+    return parse_playlist(c, pls->url, pls, NULL);
+}
+
 static int read_from_url(struct playlist *pls, struct segment *seg,
                          uint8_t *buf, int buf_size)
 {
@@ -1035,7 +1309,13 @@ static int read_from_url(struct playlist *pls, struct segment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    if (pls->prefetch.cur) {
+        HLSContext *c = pls->parent->priv_data;
+        ret = ff_segprefetch_read(&c->prefetch, &pls->prefetch, pls->cur_seg_offset,
+                                  buf, buf_size);
+    } else {
+        ret = avio_read(pls->input, buf, buf_size);
+    }
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
@@ -1383,13 +1663,6 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
     return 0;
 }
 
-static int64_t default_reload_interval(struct playlist *pls)
-{
-    return pls->n_segments > 0 ?
-                          pls->segments[pls->n_segments - 1]->duration :
-                          pls->target_duration;
-}
-
 static int playlist_needed(struct playlist *pls)
 {
     AVFormatContext *s = pls->parent;
@@ -1449,7 +1722,7 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input || (c->http_persistent && v->input_read_done)) {
+    if (!v->prefetch.cur && (!v->input || (c->http_persistent && v->input_read_done))) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1457,6 +1730,7 @@ restart:
         v->needed = playlist_needed(v);
 
         if (!v->needed) {
+            ff_segprefetch_flush(&c->prefetch, &v->prefetch);
             av_log(v->parent, AV_LOG_INFO, "No longer receiving playlist %d ('%s')\n",
                    v->index, v->url);
             return AVERROR_EOF;
@@ -1472,7 +1746,7 @@ reload:
             return AVERROR_EOF;
         if (!v->finished &&
             av_gettime_relative() - v->last_load_time >= reload_interval) {
-            if ((ret = parse_playlist(c, v->url, v, NULL)) < 0) {
+            if ((ret = reload_playlist(c, v, reload_interval)) < 0) {
                 if (ret != AVERROR_EXIT)
                     av_log(v->parent, AV_LOG_WARNING, "Failed to reload playlist %d\n",
                            v->index);
@@ -1520,7 +1794,15 @@ reload:
         if (ret)
             return ret;
 
-        if (c->http_multiple == 1 && v->input_next_requested) {
+        if (c->prefetch_segments && seg->key_type == KEY_NONE) {
+            ret = prefetch_schedule(c, v);
+            if (ret >= 0)
+                ret = ff_segprefetch_open(&c->prefetch, &v->prefetch,
+                                          v->cur_seq_no, NULL, 0);
+            v->cur_seg_offset = 0;
+            if (ret == AVERROR(ENOENT))
+                ret = open_input(c, v, seg, &v->input);
+        } else if (c->http_multiple == 1 && v->input_next_requested) {
             FFSWAP(AVIOContext *, v->input, v->input_next);
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
@@ -1540,7 +1822,7 @@ reload:
         just_opened = 1;
     }
 
-    if (c->http_multiple == -1) {
+    if (c->http_multiple == -1 && v->input) {
         uint8_t *http_version_opt = NULL;
         int r = av_opt_get(v->input, "http_version", AV_OPT_SEARCH_CHILDREN, &http_version_opt);
         if (r >= 0) {
@@ -1583,7 +1865,9 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
+    if (v->prefetch.cur) {
+        ff_segprefetch_release(&c->prefetch, &v->prefetch, &c->avio_opts);
+    } else if (c->http_persistent &&
         seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         v->input_read_done = 1;
     } else {
@@ -1840,6 +2124,7 @@ static int hls_close(AVFormatContext *s)
 {
     HLSContext *c = s->priv_data;
 
+    prefetch_stop(c);
     free_playlist_list(c);
     free_variant_list(c);
     free_rendition_list(c);
@@ -1874,6 +2159,19 @@ static int hls_read_header(AVFormatContext *s)
        the range header */
     av_dict_set_int(&c->avio_opts, "seekable", c->http_seekable, 0);
 
+    if (c->prefetch_segments) {
+        ret = ff_segprefetch_init(&c->prefetch, c->prefetch_size, c->interrupt_callback);
+        if (ret == AVERROR(ENOSYS)) {
+            av_log(s, AV_LOG_WARNING, "Segment prefetching requires threading support, disabling\n");
+            c->prefetch_segments = 0;
+        } else if (ret < 0) {
+            return ret;
+        } else {
+            /* the next segments are fetched by the prefetch threads instead */
+            c->http_multiple = 0;
+        }
+    }
+
     if ((ret = parse_playlist(c, s->url, NULL, s->pb)) < 0)
         return ret;
 
@@ -2149,6 +2447,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
         if (cur_needed && !pls->needed) {
             pls->needed = 1;
             changed = 1;
+            ff_segprefetch_flush(&c->prefetch, &pls->prefetch);
             pls->cur_seq_no = select_cur_seq_no(c, pls);
             pls->pb.pub.eof_reached = 0;
             if (c->cur_timestamp != AV_NOPTS_VALUE) {
@@ -2159,6 +2458,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             }
             av_log(s, AV_LOG_INFO, "Now receiving playlist %d, segment %"PRId64"\n", i, pls->cur_seq_no);
         } else if (first && !cur_needed && pls->needed) {
+            ff_segprefetch_flush(&c->prefetch, &pls->prefetch);
             ff_format_io_close(pls->parent, &pls->input);
             pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
@@ -2415,6 +2715,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
         /* Reset reading */
         struct playlist *pls = c->playlists[i];
         AVIOContext *const pb = &pls->pb.pub;
+        ff_segprefetch_flush(&c->prefetch, &pls->prefetch);
         ff_format_io_close(pls->parent, &pls->input);
         pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
@@ -2482,6 +2783,10 @@ static const AVOption hls_options[] = {
         OFFSET(http_seekable), AV_OPT_TYPE_BOOL, { .i64 = -1}, -1, 1, FLAGS},
     {"seg_format_options", "Set options for segment demuxer",
         OFFSET(seg_format_opts), AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, FLAGS},
+    {"prefetch_segments", "Number of segments to download ahead of the one being read, 0 = disable",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 100, FLAGS},
+    {"prefetch_size", "Maximum amount of memory used for prefetched segments",
+        OFFSET(prefetch_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
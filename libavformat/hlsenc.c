@@ -54,6 +54,7 @@
 #include "hlsplaylist.h"
 #include "internal.h"
 #include "os_support.h"
+#include "uploadpool.h"
 
 typedef enum {
     HLS_START_SEQUENCE_AS_START_NUMBER = 0,
@@ -74,6 +75,13 @@ typedef enum {
 #define BUFSIZE (16 * 1024)
 #define POSTFIX_PATTERN "_%d"
 
+typedef struct HLSPart {
+    double duration; /* in seconds */
+    int64_t pos;
+    int64_t size;
+    int independent;
+} HLSPart;
+
 typedef struct HLSSegment {
     char filename[MAX_URL_SIZE];
     char sub_filename[MAX_URL_SIZE];
@@ -88,6 +96,9 @@ typedef struct HLSSegment {
     char key_uri[LINE_BUFFER_SIZE + 1];
     char iv_string[KEYSIZE*2 + 1];
 
+    HLSPart *parts;
+    int nb_parts;
+
     struct HLSSegment *next;
     double discont_program_date_time;
 } HLSSegment;
@@ -184,6 +195,14 @@ typedef struct VariantStream {
     const char *sgroup;   /* subtitle group name */
     const char *ccgroup;  /* closed caption group name */
     const char *varname;  /* variant name */
+
+    AVIOContext *part_out;  /* segment being written part by part */
+    HLSPart *parts;         /* parts of the segment being written */
+    int nb_parts;
+    int64_t segment_size;   /* bytes of the current segment written so far */
+    double part_start;      /* start of the current part in the segment, in seconds */
+    int part_independent;
+    int part_packets;
 } VariantStream;
 
 typedef struct ClosedCaptionsStream {
@@ -199,6 +218,7 @@ typedef struct HLSContext {
 
     int64_t time;          // Set by a private option.
     int64_t init_time;     // Set by a private option.
+    int64_t part_time;     // Set by a private option.
     int max_nb_segments;   // Set by a private option.
     int hls_delete_threshold; // Set by a private option.
     uint32_t flags;        // enum HLSFlags
@@ -256,6 +276,9 @@ typedef struct HLSContext {
     char *headers;
     int has_default_key; /* has DEFAULT field of var_stream_map */
     int has_video_m3u8; /* has video stream m3u8 list */
+    int upload_threads;
+    int upload_retries;
+    UploadPool *upload_pool;
 } HLSContext;
 
 static int strftime_expand(const char *fmt, char **dest)
@@ -558,12 +581,68 @@ static void reflush_dynbuf(VariantStream *vs, int *range_length)
     avio_write(vs->out, vs->temp_buffer, *range_length);
 }
 
+/* Hand the buffered segment over to the upload pool instead of writing it
+ * from the muxing thread. */
+static int hls_upload_segment(AVFormatContext *s, VariantStream *vs,
+                              const char *filename, AVDictionary **options,
+                              int *range_length)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *ctx = vs->avf;
+    AVIOContext *pb = NULL;
+    const char *proto = avio_find_protocol_name(ctx->url);
+    char *final_filename = NULL;
+    uint8_t *buffer;
+    int ret, size;
+
+    av_write_frame(ctx, NULL);
+    *range_length = avio_close_dyn_buf(ctx->pb, &vs->temp_buffer);
+    ctx->pb = NULL;
+    if ((ret = avio_open_dyn_buf(&ctx->pb)) < 0 ||
+        (ret = avio_open_dyn_buf(&pb)) < 0) {
+        av_freep(&vs->temp_buffer);
+        av_dict_free(options);
+        return ret;
+    }
+    if (hls->segment_type == SEGMENT_TYPE_FMP4)
+        write_styp(pb);
+    avio_write(pb, vs->temp_buffer, *range_length);
+    av_freep(&vs->temp_buffer);
+    size = avio_close_dyn_buf(pb, &buffer);
+    if (!buffer) {
+        av_dict_free(options);
+        return AVERROR(ENOMEM);
+    }
+
+    /* the temporary file is renamed by the pool once written, see
+     * hls_rename_temp_file() */
+    if (proto && !strcmp(proto, "file") && hls->flags & HLS_TEMP_FILE) {
+        final_filename = av_strndup(ctx->url, strlen(ctx->url) - 4);
+        if (!final_filename) {
+            av_free(buffer);
+            av_dict_free(options);
+            return AVERROR(ENOMEM);
+        }
+    }
+
+    ret = ff_upload_pool_submit(hls->upload_pool, filename, final_filename,
+                                buffer, size, options, vs->var_stream_idx, 0);
+    av_free(final_filename);
+    return ret;
+}
+
 #if HAVE_DOS_PATHS
 #define SEPARATOR '\\'
 #else
 #define SEPARATOR '/'
 #endif
 
+static void hls_free_segment(HLSSegment **en)
+{
+    av_freep(&(*en)->parts);
+    av_freep(en);
+}
+
 static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
                            const char *path, const char *proto)
 {
@@ -685,7 +764,7 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
         av_bprint_clear(&path);
         previous_segment = segment;
         segment = previous_segment->next;
-        av_freep(&previous_segment);
+        hls_free_segment(&previous_segment);
     }
 
 fail:
@@ -1114,6 +1193,8 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
     if (!en)
         return AVERROR(ENOMEM);
 
+    en->parts    = NULL;
+    en->nb_parts = 0;
     en->var_stream_idx = vs->var_stream_idx;
     ret = sls_flags_filename_process(s, hls, vs, en, duration, pos, size);
     if (ret < 0) {
@@ -1146,6 +1227,12 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
     en->discont  = 0;
     en->discont_program_date_time = 0;
 
+    /* The parts of the segment are now complete. */
+    en->parts    = vs->parts;
+    en->nb_parts = vs->nb_parts;
+    vs->parts    = NULL;
+    vs->nb_parts = 0;
+
     if (vs->discontinuity) {
         en->discont = 1;
         vs->discontinuity = 0;
@@ -1179,7 +1266,7 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
             if ((ret = hls_delete_old_segments(s, hls, vs)) < 0)
                 return ret;
         } else
-            av_freep(&en);
+            hls_free_segment(&en);
     } else
         vs->nb_entries++;
 
@@ -1309,12 +1396,13 @@ static void hls_free_segments(HLSSegment *p)
     while (p) {
         en = p;
         p = p->next;
-        av_freep(&en);
+        hls_free_segment(&en);
     }
 }
 
 static int hls_rename_temp_file(AVFormatContext *s, AVFormatContext *oc)
 {
+    HLSContext *c = s->priv_data;
     size_t len = strlen(oc->url);
     char *final_filename = av_strdup(oc->url);
     int ret;
@@ -1322,7 +1410,8 @@ static int hls_rename_temp_file(AVFormatContext *s, AVFormatContext *oc)
     if (!final_filename)
         return AVERROR(ENOMEM);
     final_filename[len-4] = '\0';
-    ret = ff_rename(oc->url, final_filename, s);
+    /* with an upload pool, the file is renamed once written */
+    ret = c->upload_pool ? 0 : ff_rename(oc->url, final_filename, s);
     oc->url[len-4] = '\0';
     av_freep(&final_filename);
     return ret;
@@ -1549,6 +1638,8 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     double prog_date_time = vs->initial_prog_date_time;
     double *prog_date_time_p = (hls->flags & HLS_PROGRAM_DATE_TIME) ? &prog_date_time : NULL;
     int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    double total_duration = 0, part_window = 0;
+    AVIOContext *out = vs->out;
 
     hls->version = 3;
     if (byterange_mode) {
@@ -1573,7 +1664,14 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 
     set_http_options(s, &options, hls);
     snprintf(temp_filename, sizeof(temp_filename), use_temp_file ? "%s.tmp" : "%s", vs->m3u8_name);
-    if ((ret = hlsenc_io_open(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename, &options)) < 0) {
+    if (hls->upload_pool) {
+        /* Written to memory, then uploaded after the segments it lists */
+        vs->out = NULL;
+        ret = avio_open_dyn_buf(&vs->out);
+    } else {
+        ret = hlsenc_io_open(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename, &options);
+    }
+    if (ret < 0) {
         if (hls->ignore_io_errors)
             ret = 0;
         goto fail;
@@ -1582,11 +1680,17 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     for (en = vs->segments; en; en = en->next) {
         if (target_duration <= en->duration)
             target_duration = lrint(en->duration);
+        total_duration += en->duration;
     }
 
     vs->discontinuity_set = 0;
     ff_hls_write_playlist_header(byterange_mode ? hls->m3u8_out : vs->out, hls->version, hls->allowcache,
                                  target_duration, sequence, hls->pl_type, hls->flags & HLS_I_FRAMES_ONLY);
+    if (hls->part_time) {
+        ff_hls_write_part_info(vs->out, hls->part_time / (double)AV_TIME_BASE);
+        /* Parts are only listed for the last three target durations. */
+        part_window = total_duration - 3 * target_duration;
+    }
 
     if ((hls->flags & HLS_DISCONT_START) && sequence==hls->start_sequence && vs->discontinuity_set==0) {
         avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-DISCONTINUITY\n");
@@ -1611,6 +1715,14 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
                                    hls->flags & HLS_SINGLE_FILE, vs->init_range_length, 0);
         }
 
+        if (!last && part_window < en->duration) {
+            for (int i = 0; i < en->nb_parts; i++)
+                ff_hls_write_part(vs->out, en->parts[i].duration, hls->baseurl,
+                                  en->filename, en->parts[i].size,
+                                  en->parts[i].pos, en->parts[i].independent);
+        }
+        part_window -= en->duration;
+
         ret = ff_hls_write_file_entry(byterange_mode ? hls->m3u8_out : vs->out, en->discont, byterange_mode,
                                       en->duration, hls->flags & HLS_ROUND_DURATIONS,
                                       en->size, en->pos, hls->baseurl,
@@ -1624,6 +1736,16 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         }
     }
 
+    if (hls->part_time && !last) {
+        const char *filename = hls->use_localtime_mkdir ? vs->avf->url : av_basename(vs->avf->url);
+
+        for (int i = 0; i < vs->nb_parts; i++)
+            ff_hls_write_part(vs->out, vs->parts[i].duration, hls->baseurl,
+                              filename, vs->parts[i].size,
+                              vs->parts[i].pos, vs->parts[i].independent);
+        ff_hls_write_preload_hint(vs->out, hls->baseurl, filename, vs->segment_size);
+    }
+
     if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
         ff_hls_write_end_list(byterange_mode ? hls->m3u8_out : vs->out);
 
@@ -1652,13 +1774,31 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 
 fail:
     av_dict_free(&options);
-    ret = hlsenc_io_close(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename);
+    if (hls->upload_pool) {
+        uint8_t *buffer;
+        int size;
+
+        if (vs->out) {
+            size = avio_close_dyn_buf(vs->out, &buffer);
+            set_http_options(s, &options, hls);
+            ret = ff_upload_pool_submit(hls->upload_pool, temp_filename,
+                                        use_temp_file ? vs->m3u8_name : NULL,
+                                        buffer, size, &options,
+                                        vs->var_stream_idx, 1);
+            if (hls->ignore_io_errors)
+                ret = 0;
+        }
+        vs->out = out;
+    } else {
+        ret = hlsenc_io_close(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename);
+    }
     if (ret < 0) {
         return ret;
     }
     hlsenc_io_close(s, &hls->sub_m3u8_out, vs->vtt_m3u8_name);
     if (use_temp_file) {
-        ff_rename(temp_filename, vs->m3u8_name, s);
+        if (!hls->upload_pool)
+            ff_rename(temp_filename, vs->m3u8_name, s);
         if (vs->vtt_m3u8_name)
             ff_rename(temp_vtt_filename, vs->vtt_m3u8_name, s);
     }
@@ -2396,6 +2536,72 @@ static int64_t append_single_file(AVFormatContext *s, VariantStream *vs)
 
     return ret;
 }
+/* Write the buffered fragment of the current segment as a partial
+ * segment, opening the segment file on its first part. */
+static int hls_write_part(AVFormatContext *s, VariantStream *vs, double end)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    HLSPart *part;
+    int64_t size = 0;
+    int range_length, ret;
+
+    if (!vs->init_range_length) {
+        /* With delay_moov, the first flush only writes the init segment. */
+        av_write_frame(oc, NULL);
+        range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
+        oc->pb = NULL;
+        if (range_length <= 0)
+            return AVERROR(EINVAL);
+        avio_write(vs->out, vs->init_buffer, range_length);
+        if (!hls->resend_init_file)
+            av_freep(&vs->init_buffer);
+        vs->init_range_length = range_length;
+        vs->start_pos = range_length;
+        hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
+        if ((ret = avio_open_dyn_buf(&oc->pb)) < 0)
+            return ret;
+    }
+
+    if (!vs->segment_size) {
+        AVDictionary *options = NULL;
+
+        set_http_options(s, &options, hls);
+        ret = hlsenc_io_open(s, &vs->part_out, oc->url, &options);
+        av_dict_free(&options);
+        if (ret < 0) {
+            av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+                   "Failed to open file '%s'\n", oc->url);
+            return hls->ignore_io_errors ? 0 : ret;
+        }
+        write_styp(vs->part_out);
+        size = 24;
+    }
+
+    av_write_frame(oc, NULL);
+    range_length = avio_close_dyn_buf(oc->pb, &vs->temp_buffer);
+    oc->pb = NULL;
+    avio_write(vs->part_out, vs->temp_buffer, range_length);
+    avio_flush(vs->part_out);
+    av_freep(&vs->temp_buffer);
+    if ((ret = avio_open_dyn_buf(&oc->pb)) < 0)
+        return ret;
+    size += range_length;
+
+    part = av_dynarray2_add((void **)&vs->parts, &vs->nb_parts, sizeof(*part), NULL);
+    if (!part)
+        return AVERROR(ENOMEM);
+    part->duration    = end - vs->part_start;
+    part->pos         = vs->segment_size;
+    part->size        = size;
+    part->independent = vs->part_independent;
+    vs->segment_size += size;
+    vs->part_start    = end;
+    vs->part_packets  = 0;
+
+    return vs->part_out->error;
+}
+
 static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
     HLSContext *hls = s->priv_data;
@@ -2519,7 +2725,16 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
             }
         }
 
-        if (hls->flags & HLS_SINGLE_FILE) {
+        if (hls->part_time) {
+            ret = hls_write_part(s, vs, (double)(pkt->pts - vs->end_pts) * st->time_base.num / st->time_base.den);
+            if (ret < 0)
+                return ret;
+            vs->size = vs->segment_size;
+            if (hlsenc_io_close(s, &vs->part_out, oc->url) < 0)
+                av_log(s, AV_LOG_WARNING, "upload segment '%s' failed\n", oc->url);
+            vs->segment_size = 0;
+            vs->part_start   = 0;
+        } else if (hls->flags & HLS_SINGLE_FILE) {
             ret = flush_dynbuf(vs, &range_length);
             av_freep(&vs->temp_buffer);
             if (ret < 0) {
@@ -2556,35 +2771,46 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
 
                 set_http_options(s, &options, hls);
 
-                ret = hlsenc_io_open(s, &vs->out, filename, &options);
-                if (ret < 0) {
-                    av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
-                           "Failed to open file '%s'\n", filename);
+                if (hls->upload_pool) {
+                    ret = hls_upload_segment(s, vs, filename, &options, &range_length);
                     av_freep(&filename);
-                    av_dict_free(&options);
-                    return hls->ignore_io_errors ? 0 : ret;
-                }
-                if (hls->segment_type == SEGMENT_TYPE_FMP4) {
-                    write_styp(vs->out);
-                }
-                ret = flush_dynbuf(vs, &range_length);
-                if (ret < 0) {
-                    av_freep(&filename);
-                    av_dict_free(&options);
-                    return ret;
-                }
-                ret = hlsenc_io_close(s, &vs->out, filename);
-                if (ret < 0) {
-                    av_log(s, AV_LOG_WARNING, "upload segment failed,"
-                           " will retry with a new http session.\n");
-                    ff_format_io_close(s, &vs->out);
+                    if (ret < 0) {
+                        av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+                               "Failed to upload segment\n");
+                        if (!hls->ignore_io_errors)
+                            return ret;
+                    }
+                } else {
                     ret = hlsenc_io_open(s, &vs->out, filename, &options);
-                    reflush_dynbuf(vs, &range_length);
+                    if (ret < 0) {
+                        av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+                               "Failed to open file '%s'\n", filename);
+                        av_freep(&filename);
+                        av_dict_free(&options);
+                        return hls->ignore_io_errors ? 0 : ret;
+                    }
+                    if (hls->segment_type == SEGMENT_TYPE_FMP4) {
+                        write_styp(vs->out);
+                    }
+                    ret = flush_dynbuf(vs, &range_length);
+                    if (ret < 0) {
+                        av_freep(&filename);
+                        av_dict_free(&options);
+                        return ret;
+                    }
                     ret = hlsenc_io_close(s, &vs->out, filename);
+                    if (ret < 0) {
+                        av_log(s, AV_LOG_WARNING, "upload segment failed,"
+                               " will retry with a new http session.\n");
+                        ff_format_io_close(s, &vs->out);
+                        ret = hlsenc_io_open(s, &vs->out, filename, &options);
+                        reflush_dynbuf(vs, &range_length);
+                        ret = hlsenc_io_close(s, &vs->out, filename);
+                    }
+                    av_dict_free(&options);
+                    av_freep(&vs->temp_buffer);
+                    av_freep(&filename);
                 }
-                av_dict_free(&options);
-                av_freep(&vs->temp_buffer);
-                av_freep(&filename);
             }
 
             if (use_temp_file)
@@ -2608,7 +2834,8 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         }
 
         // if we're building a VOD playlist, skip writing the manifest multiple times, and just wait until the end
-        if (hls->pl_type != PLAYLIST_TYPE_VOD) {
+        // with partial segments, the playlist is written once the next segment is started
+        if (hls->pl_type != PLAYLIST_TYPE_VOD && !hls->part_time) {
             if ((ret = hls_window(s, 0, vs)) < 0) {
                 av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
                 ff_format_io_close(s, &vs->out);
@@ -2653,8 +2880,34 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         if (ret < 0) {
             return ret;
         }
+        if (hls->part_time && hls->pl_type != PLAYLIST_TYPE_VOD) {
+            if ((ret = hls_window(s, 0, vs)) < 0) {
+                ff_format_io_close(s, &vs->out);
+                if ((ret = hls_window(s, 0, vs)) < 0)
+                    return ret;
+            }
+        }
+    } else if (hls->part_time && oc == vs->avf && is_ref_pkt && vs->part_packets) {
+        double end = (double)(pkt->pts - vs->end_pts) * st->time_base.num / st->time_base.den;
+
+        /* Cut a part before the packet that would make it exceed the
+         * part target duration. */
+        if (end + (double)pkt->duration * st->time_base.num / st->time_base.den - vs->part_start >
+            hls->part_time / (double)AV_TIME_BASE) {
+            if ((ret = hls_write_part(s, vs, end)) < 0)
+                return ret;
+            if (hls->pl_type != PLAYLIST_TYPE_VOD && (ret = hls_window(s, 0, vs)) < 0) {
+                av_log(s, AV_LOG_WARNING, "upload playlist failed\n");
+                ff_format_io_close(s, &vs->out);
+                if (!hls->ignore_io_errors)
+                    return ret;
+            }
+        }
     }
 
+    if (is_ref_pkt && oc == vs->avf && !vs->part_packets++)
+        vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
+
     vs->packets_written++;
     if (oc->pb) {
         ret = ff_write_chained(oc, stream_index, pkt, s, 0);
@@ -2677,6 +2930,8 @@ static void hls_deinit(AVFormatContext *s)
     int i = 0;
     VariantStream *vs = NULL;
 
+    ff_upload_pool_free(&hls->upload_pool);
+
     for (i = 0; i < hls->nb_varstreams; i++) {
         vs = &hls->var_streams[i];
 
@@ -2692,6 +2947,8 @@ static void hls_deinit(AVFormatContext *s)
             av_freep(&vs->init_buffer);
         hls_free_segments(vs->segments);
         hls_free_segments(vs->old_segments);
+        av_freep(&vs->parts);
+        ff_format_io_close(s, &vs->part_out);
         av_freep(&vs->m3u8_name);
         av_freep(&vs->streams);
     }
@@ -2761,6 +3018,24 @@ static int hls_write_trailer(struct AVFormatContext *s)
                 }
             }
         }
+        if (hls->part_time) {
+            ret = hls_write_part(s, vs, vs->duration + vs->dpp);
+            if (ret < 0)
+                goto failed;
+            vs->size = vs->segment_size;
+            ret = hlsenc_io_close(s, &vs->part_out, oc->url);
+            if (ret < 0)
+                av_log(s, AV_LOG_WARNING, "Failed to upload file '%s' at the end.\n", oc->url);
+            goto failed;
+        }
+        if (hls->upload_pool) {
+            set_http_options(s, &options, hls);
+            ret = hls_upload_segment(s, vs, filename, &options, &range_length);
+            vs->size = range_length;
+            if (ret < 0)
+                av_log(s, AV_LOG_WARNING, "Failed to upload file '%s' at the end.\n", oc->url);
+            goto failed;
+        }
         if (!(hls->flags & HLS_SINGLE_FILE)) {
             set_http_options(s, &options, hls);
             ret = hlsenc_io_open(s, &vs->out, filename, &options);
@@ -2839,6 +3114,14 @@ failed:
         av_free(old_filename);
     }
 
+    if (hls->upload_pool) {
+        ret = ff_upload_pool_flush(hls->upload_pool);
+        if (ret < 0) {
+            av_log(s, AV_LOG_ERROR, "Failed to upload all files at the end\n");
+            return hls->ignore_io_errors ? 0 : ret;
+        }
+    }
+
     return 0;
 }
 
@@ -2878,6 +3161,41 @@ static int hls_init(AVFormatContext *s)
         av_log(hls, AV_LOG_WARNING, "No HTTP method set, hls muxer defaulting to method PUT.\n");
     }
 
+    if (hls->part_time) {
+        if (hls->segment_type != SEGMENT_TYPE_FMP4 ||
+            hls->flags & HLS_SINGLE_FILE || hls->max_seg_size > 0 ||
+            hls->encrypt || hls->key_info_file) {
+            av_log(s, AV_LOG_ERROR, "Partial segments require fmp4 segments "
+                   "in separate files without encryption\n");
+            return AVERROR(EINVAL);
+        }
+        if (hls->part_time > hls->time) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time must not exceed hls_time\n");
+            return AVERROR(EINVAL);
+        }
+        if (hls->flags & HLS_TEMP_FILE) {
+            av_log(s, AV_LOG_WARNING, "Partial segments are written to their "
+                   "final name, ignoring temp_file\n");
+            hls->flags &= ~HLS_TEMP_FILE;
+        }
+    }
+
+    if (hls->upload_threads) {
+        if (hls->part_time || hls->flags & HLS_SINGLE_FILE || hls->max_seg_size > 0 ||
+            hls->flags & (HLS_SECOND_LEVEL_SEGMENT_SIZE | HLS_SECOND_LEVEL_SEGMENT_DURATION) ||
+            (hls->flags & HLS_TEMP_FILE && (hls->encrypt || hls->key_info_file))) {
+            av_log(s, AV_LOG_WARNING, "Upload threads require separate segment "
+                   "files without partial segments, byte ranges, second level "
+                   "segment names or encrypted temporary files, ignoring "
+                   "upload_threads\n");
+        } else {
+            ret = ff_upload_pool_init(&hls->upload_pool, s, hls->upload_threads,
+                                      hls->upload_retries, hls->http_persistent);
+            if (ret < 0 && ret != AVERROR(ENOSYS))
+                return ret;
+        }
+    }
+
     ret = validate_name(hls->nb_varstreams, s->url);
     if (ret < 0)
         return ret;
@@ -3099,6 +3417,7 @@ static int hls_init(AVFormatContext *s)
 static const AVOption options[] = {
     {"start_number",  "set first number in the sequence",        OFFSET(start_sequence),AV_OPT_TYPE_INT64,  {.i64 = 0},     0, INT64_MAX, E},
     {"hls_time",      "set segment length",                      OFFSET(time),          AV_OPT_TYPE_DURATION, {.i64 = 2000000}, 0, INT64_MAX, E},
+    {"hls_part_time", "set partial segment length for low-latency HLS", OFFSET(part_time), AV_OPT_TYPE_DURATION, {.i64 = 0}, 0, INT64_MAX, E},
     {"hls_init_time", "set segment length at init list",         OFFSET(init_time),     AV_OPT_TYPE_DURATION, {.i64 = 0},       0, INT64_MAX, E},
     {"hls_list_size", "set maximum number of playlist entries",  OFFSET(max_nb_segments),    AV_OPT_TYPE_INT,    {.i64 = 5},     0, INT_MAX, E},
     {"hls_delete_threshold", "set number of unreferenced segments to keep before deleting",  OFFSET(hls_delete_threshold),    AV_OPT_TYPE_INT,    {.i64 = 1},     1, INT_MAX, E},
@@ -3155,6 +3474,8 @@ static const AVOption options[] = {
     {"master_pl_name", "Create HLS master playlist with this name", OFFSET(master_pl_name), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
     {"master_pl_publish_rate", "Publish master play list every after this many segment intervals", OFFSET(master_publish_rate), AV_OPT_TYPE_INT, {.i64 = 0}, 0, UINT_MAX, E},
     {"http_persistent", "Use persistent HTTP connections", OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
+    {"upload_threads", "number of segments and playlists uploaded concurrently, 0 to write them from the muxing thread", OFFSET(upload_threads), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, E},
+    {"upload_retries", "number of times a failed upload is retried", OFFSET(upload_retries), AV_OPT_TYPE_INT, {.i64 = 3}, 0, INT_MAX, E},
     {"timeout", "set timeout for socket I/O operations", OFFSET(timeout), AV_OPT_TYPE_DURATION, { .i64 = -1 }, -1, INT_MAX, .flags = E },
     {"ignore_io_errors", "Ignore IO errors for stable long-duration runs with network output", OFFSET(ignore_io_errors), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     {"headers", "set custom HTTP headers, can override built in default headers", OFFSET(headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
@@ -21,6 +21,8 @@
 
 #include "config.h"
 
+#include <stdatomic.h>
+
 #if CONFIG_ZLIB
 #include <zlib.h>
 #endif /* CONFIG_ZLIB */
@@ -29,6 +31,7 @@
 #include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
 
@@ -38,6 +41,7 @@
 #include "internal.h"
 #include "network.h"
 #include "os_support.h"
+#include "tls.h"
 #include "url.h"
 
 /* XXX: POST protocol is not completely implemented because ffmpeg uses
@@ -52,6 +56,11 @@
 #define HTTP_SINGLE   1
 #define HTTP_MUTLI    2
 #define MAX_EXPIRY    19
+#define MAX_POOLED_CONNECTIONS 16
+#define POOL_IDLE_TIMEOUT      (30 * 1000000)
+#define RANGE_READ_SIZE        (256 * 1024)
+#define RANGE_MAX_ATTEMPTS     3
+#define RANGE_POLL_INTERVAL    100000
 #define WHITESPACES " \n\t\r"
 typedef enum {
     LOWER_PROTO,
@@ -133,6 +142,17 @@ typedef struct HTTPContext {
     char *new_location;
     AVDictionary *redirect_cache;
     uint64_t filesize_from_content_range;
+    /* Size of the response body from Content-Length, UINT64_MAX if unknown. */
+    uint64_t content_length;
+    /* Offset of the end of the response body, UINT64_MAX if unknown. */
+    uint64_t body_end;
+    int connection_pool;
+    /* Key of the connection in the pool, if it may be put back there. */
+    char *pool_key;
+    int parallel_ranges;
+    int range_size;
+    /* Range requests serving the reads, if parallel_ranges is used. */
+    struct HTTPRanges *ranges;
 } HTTPContext;
 
 #define OFFSET(x) offsetof(HTTPContext, x)
@@ -175,6 +195,9 @@ static const AVOption options[] = {
     { "resource", "The resource requested by a client", OFFSET(resource), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { "reply_code", "The http status code to return to a client", OFFSET(reply_code), AV_OPT_TYPE_INT, { .i64 = 200}, INT_MIN, 599, E},
     { "short_seek_size", "Threshold to favor readahead over seek.", OFFSET(short_seek_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D },
+    { "connection_pool", "reuse the persistent connections left by other contexts", OFFSET(connection_pool), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+    { "parallel_ranges", "number of concurrent range requests to read with", OFFSET(parallel_ranges), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, MAX_POOLED_CONNECTIONS, D },
+    { "range_size", "size of the range requests of parallel_ranges", OFFSET(range_size), AV_OPT_TYPE_INT, { .i64 = 8 << 20 }, 4096, INT_MAX, D },
     { NULL }
 };
 
@@ -183,6 +206,7 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
                         const char *proxyauth);
 static int http_read_header(URLContext *h);
 static int http_shutdown(URLContext *h, int flags);
+static void ranges_stop(HTTPContext *s);
 
 void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
 {
@@ -194,6 +218,142 @@ void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
            sizeof(HTTPAuthState));
 }
 
+/*
+ * Process-wide pool of the idle persistent connections, kept when closing
+ * a context after reading a complete response, for any later request to
+ * the same server with the same lower protocol options.
+ */
+typedef struct HTTPPooledConnection {
+    char *key;
+    URLContext *hd;
+    int64_t idle_since;
+} HTTPPooledConnection;
+
+static AVMutex pool_mutex = AV_MUTEX_INITIALIZER;
+static HTTPPooledConnection pool[MAX_POOLED_CONNECTIONS];
+static int nb_pooled;
+
+static void set_interrupt_callback(URLContext *hd, const AVIOInterruptCB *cb)
+{
+    hd->interrupt_callback = *cb;
+    if (!strcmp(hd->prot->name, "httpproxy"))
+        set_interrupt_callback(((HTTPContext *)hd->priv_data)->hd, cb);
+#if CONFIG_TLS_PROTOCOL
+    else if (!strcmp(hd->prot->name, "tls"))
+        set_interrupt_callback(ff_tls_get_shared(hd)->tcp, cb);
+#endif
+}
+
+static int pool_make_key(URLContext *h, char **key, const char *lower_url,
+                         AVDictionary *options)
+{
+    static const char *const opts[] = {
+        "ca_file", "cafile", "tls_verify", "cert_file", "key_file",
+        "verifyhost", "http_proxy", "timeout", "rw_timeout", NULL };
+    AVBPrint bp;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&bp, "%s", lower_url);
+    /* a pooled connection keeps the protocols it was opened with */
+    av_bprintf(&bp, " protocol_whitelist=%s protocol_blacklist=%s rw_timeout=%"PRId64,
+               h->protocol_whitelist ? h->protocol_whitelist : "",
+               h->protocol_blacklist ? h->protocol_blacklist : "", h->rw_timeout);
+    for (int i = 0; opts[i]; i++) {
+        AVDictionaryEntry *e = av_dict_get(options, opts[i], NULL, 0);
+        if (e)
+            av_bprintf(&bp, " %s=%s", opts[i], e->value);
+    }
+    return av_bprint_finalize(&bp, key);
+}
+
+static void pool_remove(int i, URLContext **closed, int *nb_closed)
+{
+    closed[(*nb_closed)++] = pool[i].hd;
+    av_free(pool[i].key);
+    memmove(&pool[i], &pool[i + 1], (nb_pooled - i - 1) * sizeof(*pool));
+    nb_pooled--;
+}
+
+static URLContext *pool_get(URLContext *h, const char *key)
+{
+    URLContext *closed[MAX_POOLED_CONNECTIONS], *hd = NULL;
+    int64_t now = av_gettime_relative();
+    int nb_closed = 0;
+
+    ff_mutex_lock(&pool_mutex);
+    for (int i = nb_pooled - 1; i >= 0; i--) {
+        if (now - pool[i].idle_since > POOL_IDLE_TIMEOUT) {
+            pool_remove(i, closed, &nb_closed);
+        } else if (!hd && !strcmp(pool[i].key, key)) {
+            hd = pool[i].hd;
+            pool[i].hd = NULL;
+            av_freep(&pool[i].key);
+            memmove(&pool[i], &pool[i + 1], (nb_pooled - i - 1) * sizeof(*pool));
+            nb_pooled--;
+        }
+    }
+    ff_mutex_unlock(&pool_mutex);
+
+    for (int i = 0; i < nb_closed; i++)
+        ffurl_closep(&closed[i]);
+    if (hd) {
+        av_log(h, AV_LOG_DEBUG, "Reusing the pooled connection %s\n", key);
+        set_interrupt_callback(hd, &h->interrupt_callback);
+    }
+    return hd;
+}
+
+static void pool_put(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    const AVIOInterruptCB no_cb = { 0 };
+    URLContext *closed[1];
+    int nb_closed = 0;
+
+    /* the context the callback was set for may be gone by the next use */
+    set_interrupt_callback(s->hd, &no_cb);
+
+    ff_mutex_lock(&pool_mutex);
+    if (nb_pooled == MAX_POOLED_CONNECTIONS)
+        pool_remove(0, closed, &nb_closed);
+    pool[nb_pooled].key        = s->pool_key;
+    pool[nb_pooled].hd         = s->hd;
+    pool[nb_pooled].idle_since = av_gettime_relative();
+    nb_pooled++;
+    ff_mutex_unlock(&pool_mutex);
+
+    s->pool_key = NULL;
+    s->hd       = NULL;
+    if (nb_closed)
+        ffurl_closep(&closed[0]);
+}
+
+void ff_http_close_pool(void)
+{
+    URLContext *closed[MAX_POOLED_CONNECTIONS];
+    int nb_closed = 0;
+
+    ff_mutex_lock(&pool_mutex);
+    while (nb_pooled)
+        pool_remove(nb_pooled - 1, closed, &nb_closed);
+    ff_mutex_unlock(&pool_mutex);
+
+    for (int i = 0; i < nb_closed; i++)
+        ffurl_closep(&closed[i]);
+}
+
+/* Return whether the connection can be used for another request. */
+static int connection_reusable(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+
+    if (!s->pool_key || s->willclose || s->buf_ptr != s->buf_end)
+        return 0;
+    if (s->chunksize != UINT64_MAX)
+        return s->chunkend;
+    return s->body_end != UINT64_MAX && s->off == s->body_end;
+}
+
 static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 {
     const char *path, *proxy_path, *lower_proto = "tcp", *local_path;
@@ -254,6 +414,25 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 
     ff_url_join(buf, sizeof(buf), lower_proto, NULL, hostname, port, NULL);
 
+    av_freep(&s->pool_key);
+    if (s->connection_pool && !(h->flags & AVIO_FLAG_WRITE) && !s->post_data &&
+        (!s->method || !strcmp(s->method, "GET"))) {
+        if ((err = pool_make_key(h, &s->pool_key, buf, *options)) < 0)
+            return err;
+        if (!s->hd && (s->hd = pool_get(h, s->pool_key))) {
+            uint64_t off = s->off;
+
+            s->line_count = 0;
+            err = http_connect(h, path, local_path, hoststr, auth, proxyauth);
+            /* the server may have closed the idle connection meanwhile */
+            if (err >= 0 || s->line_count)
+                return err;
+            av_log(h, AV_LOG_VERBOSE, "Pooled connection failed, opening a new one\n");
+            ffurl_closep(&s->hd);
+            s->off = off;
+        }
+    }
+
     if (!s->hd) {
         err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
                                    &h->interrupt_callback, options,
@@ -487,6 +666,8 @@ int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **opts)
         return AVERROR(EINVAL);
     }
 
+    ranges_stop(s);
+
     if (!s->end_chunked_post) {
         ret = http_shutdown(h, h->flags);
         if (ret < 0)
@@ -685,6 +866,400 @@ fail:
     return ret;
 }
 
+#if HAVE_THREADS
+/*
+ * Reading with parallel_ranges: the file is split into range_size aligned
+ * ranges, fetched by worker threads with one range request each, over the
+ * connections of the pool. The reader wants the data from its position to
+ * the end of its range and, once it reads sequentially, the parallel_ranges
+ * ranges after it. One worker is kept for the data being read. Twice as many
+ * ranges as workers are kept in memory, so that seeking back and forth
+ * between the recently read ranges needs no request.
+ */
+enum HTTPRangeState {
+    RANGE_EMPTY,
+    RANGE_WANTED,
+    RANGE_FETCHING,
+    RANGE_DONE,
+};
+
+typedef struct HTTPRangeSlot {
+    enum HTTPRangeState state;
+    int64_t pos;
+    int size;
+    int filled;         ///< bytes of the range received so far
+    int err;
+    int ahead;          ///< wanted as read ahead
+    int cancel;         ///< the reader moved away, stop fetching
+    uint8_t *data;
+    uint64_t order;     ///< ranges are fetched in this order, then by position
+    uint64_t last_use;
+} HTTPRangeSlot;
+
+typedef struct HTTPRanges {
+    URLContext *h;
+    char *url;
+    AVDictionary *options;
+    AVIOInterruptCB interrupt_callback;
+    int64_t end;
+    int range_size;
+    HTTPRangeSlot *slots;
+    int nb_slots;
+    HTTPRangeSlot *cur; ///< slot of the last read
+    pthread_t *threads;
+    int nb_threads;
+    int nb_fetching;
+    uint64_t clock;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    atomic_int abort;
+} HTTPRanges;
+
+/* Only the reader polls the user's interrupt callback, which may not be
+ * thread safe, and aborts the workers through r->abort. */
+static int ranges_interrupt_cb(void *opaque)
+{
+    HTTPRanges *r = opaque;
+    return atomic_load(&r->abort);
+}
+
+/* Return 0 on success or when cancelled, with the range incomplete. */
+static int ranges_fetch(HTTPRanges *r, HTTPRangeSlot *slot)
+{
+    URLContext *hd = NULL;
+    int ret = 0, attempts = 0, cancelled = 0;
+
+    if (!slot->data && !(slot->data = av_malloc(r->range_size)))
+        return AVERROR(ENOMEM);
+
+    while (slot->filled < slot->size) {
+        AVDictionary *options = NULL;
+
+        if ((ret = av_dict_copy(&options, r->options, 0)) < 0 ||
+            (ret = av_dict_set_int(&options, "offset", slot->pos + slot->filled, 0)) < 0 ||
+            (ret = av_dict_set_int(&options, "end_offset", slot->pos + slot->size, 0)) < 0) {
+            av_dict_free(&options);
+            return ret;
+        }
+        ret = ffurl_open_whitelist(&hd, r->url, AVIO_FLAG_READ, &r->interrupt_callback,
+                                   &options, r->h->protocol_whitelist,
+                                   r->h->protocol_blacklist, r->h);
+        av_dict_free(&options);
+
+        while (ret >= 0 && slot->filled < slot->size) {
+            ret = ffurl_read(hd, slot->data + slot->filled,
+                             FFMIN(slot->size - slot->filled, RANGE_READ_SIZE));
+            if (ret == 0)
+                ret = AVERROR_EOF;
+            if (ret > 0) {
+                pthread_mutex_lock(&r->mutex);
+                slot->filled += ret;
+                cancelled = slot->cancel;
+                pthread_cond_broadcast(&r->cond);
+                pthread_mutex_unlock(&r->mutex);
+                if (cancelled)
+                    ret = AVERROR_EXIT;
+            }
+        }
+        /* a complete response puts the connection back into the pool */
+        ffurl_closep(&hd);
+
+        if (cancelled) {
+            av_log(r->h, AV_LOG_DEBUG, "Range request at %"PRId64" cancelled\n",
+                   slot->pos + slot->filled);
+            return 0;
+        }
+        if (ret >= 0 || ret == AVERROR_EXIT || atomic_load(&r->abort))
+            break;
+        if (++attempts == RANGE_MAX_ATTEMPTS) {
+            av_log(r->h, AV_LOG_ERROR, "Range request at %"PRId64" failed: %s\n",
+                   slot->pos + slot->filled, av_err2str(ret));
+            break;
+        }
+        av_log(r->h, AV_LOG_WARNING, "Retrying the range request at %"PRId64": %s\n",
+               slot->pos + slot->filled, av_err2str(ret));
+    }
+    return ret < 0 ? ret : 0;
+}
+
+static void *ranges_worker(void *arg)
+{
+    HTTPRanges *r = arg;
+
+    pthread_mutex_lock(&r->mutex);
+    while (!atomic_load(&r->abort)) {
+        HTTPRangeSlot *slot = NULL;
+        int ret;
+
+        for (int i = 0; i < r->nb_slots; i++) {
+            HTTPRangeSlot *cur = &r->slots[i];
+            if (cur->state == RANGE_WANTED &&
+                (!slot || cur->order < slot->order ||
+                 (cur->order == slot->order && cur->pos < slot->pos)))
+                slot = cur;
+        }
+        if (slot && slot->order && r->nb_threads > 1 &&
+            r->nb_fetching == r->nb_threads - 1)
+            slot = NULL;
+        if (!slot) {
+            pthread_cond_wait(&r->cond, &r->mutex);
+            continue;
+        }
+        slot->state = RANGE_FETCHING;
+        r->nb_fetching++;
+        pthread_mutex_unlock(&r->mutex);
+
+        ret = ranges_fetch(r, slot);
+
+        pthread_mutex_lock(&r->mutex);
+        r->nb_fetching--;
+        slot->err   = ret;
+        slot->state = RANGE_DONE;
+        pthread_cond_broadcast(&r->cond);
+    }
+    pthread_mutex_unlock(&r->mutex);
+    return NULL;
+}
+
+/**
+ * Return the slot holding the data at pos, assigning the least recently used
+ * slot not used since stamp to the data from pos to the end of its range if
+ * it is not there. A range which failed or was cancelled before pos is
+ * fetched again.
+ * Must be called with the mutex locked.
+ */
+static HTTPRangeSlot *ranges_want(HTTPRanges *r, int64_t pos,
+                                  uint64_t stamp, uint64_t order)
+{
+    HTTPRangeSlot *slot = NULL;
+
+    if (pos >= r->end)
+        return NULL;
+    for (int i = 0; i < r->nb_slots; i++) {
+        HTTPRangeSlot *cur = &r->slots[i];
+        if (cur->state != RANGE_EMPTY && cur->pos <= pos && pos < cur->pos + cur->size) {
+            if (cur->state == RANGE_DONE && pos >= cur->pos + cur->filled) {
+                slot = cur;
+                break;
+            }
+            cur->last_use = stamp;
+            cur->cancel   = 0;
+            if (cur->state == RANGE_WANTED)
+                cur->order = FFMIN(cur->order, order);
+            return cur;
+        }
+        if (cur->state != RANGE_FETCHING && cur->last_use != stamp &&
+            (!slot || cur->last_use < slot->last_use))
+            slot = cur;
+    }
+    if (!slot)
+        return NULL;
+
+    slot->state    = RANGE_WANTED;
+    slot->pos      = pos;
+    slot->size     = FFMIN(pos - pos % r->range_size + r->range_size, r->end) - pos;
+    slot->filled   = 0;
+    slot->err      = 0;
+    slot->ahead    = order != 0;
+    slot->cancel   = 0;
+    slot->order    = order;
+    slot->last_use = stamp;
+    pthread_cond_broadcast(&r->cond);
+    return slot;
+}
+
+static int ranges_read(URLContext *h, uint8_t *buf, int size)
+{
+    HTTPContext *s = h->priv_data;
+    HTTPRanges *r = s->ranges;
+    HTTPRangeSlot *slot;
+    int64_t pos, offset;
+    uint64_t stamp;
+    int ret;
+
+    if (s->off >= r->end)
+        return AVERROR_EOF;
+    if (atomic_load(&r->abort))
+        return AVERROR_EXIT;
+    pos = s->off - s->off % r->range_size;
+
+    pthread_mutex_lock(&r->mutex);
+retry:
+    stamp = ++r->clock;
+    /* the data being read comes before any read ahead */
+    slot = ranges_want(r, s->off, stamp, 0);
+    av_assert0(slot);
+    offset = s->off - slot->pos;
+    if (slot->ahead || offset >= RANGE_READ_SIZE) {
+        for (int i = 1; i <= r->nb_threads; i++)
+            if (!ranges_want(r, pos + (int64_t)i * r->range_size, stamp, stamp))
+                break;
+    }
+    /* free the worker fetching the range the reader moved away from */
+    if (r->cur && r->cur != slot && r->cur->state == RANGE_FETCHING &&
+        r->cur->last_use != stamp)
+        r->cur->cancel = 1;
+    r->cur = slot;
+
+    while (slot->filled <= offset && !slot->err && slot->state != RANGE_DONE) {
+        int64_t t = av_gettime() + RANGE_POLL_INTERVAL;
+        struct timespec tv = { .tv_sec  =  t / 1000000,
+                               .tv_nsec = (t % 1000000) * 1000 };
+
+        if (ff_check_interrupt(&h->interrupt_callback)) {
+            atomic_store(&r->abort, 1);
+            pthread_cond_broadcast(&r->cond);
+            pthread_mutex_unlock(&r->mutex);
+            return AVERROR_EXIT;
+        }
+        pthread_cond_timedwait(&r->cond, &r->mutex, &tv);
+    }
+    /* cancelled just before the reader came back to it */
+    if (slot->filled <= offset && !slot->err)
+        goto retry;
+    if (slot->filled > offset)
+        ret = FFMIN(size, slot->filled - offset);
+    else
+        ret = slot->err ? slot->err : AVERROR(EIO);
+    pthread_mutex_unlock(&r->mutex);
+
+    if (ret > 0) {
+        memcpy(buf, slot->data + offset, ret);
+        s->off += ret;
+    }
+    return ret;
+}
+
+static void ranges_stop(HTTPContext *s)
+{
+    HTTPRanges *r = s->ranges;
+
+    if (!r)
+        return;
+
+    pthread_mutex_lock(&r->mutex);
+    atomic_store(&r->abort, 1);
+    pthread_cond_broadcast(&r->cond);
+    pthread_mutex_unlock(&r->mutex);
+    for (int i = 0; i < r->nb_threads; i++)
+        pthread_join(r->threads[i], NULL);
+
+    for (int i = 0; i < r->nb_slots; i++)
+        av_freep(&r->slots[i].data);
+    av_freep(&r->slots);
+    av_freep(&r->threads);
+    av_freep(&r->url);
+    av_dict_free(&r->options);
+    pthread_cond_destroy(&r->cond);
+    pthread_mutex_destroy(&r->mutex);
+    av_freep(&s->ranges);
+}
+
+/**
+ * Serve the reads with parallel_ranges concurrent range requests if the
+ * server supports them and the file is larger than one range.
+ */
+static int ranges_start(URLContext *h)
+{
+    static const char *const opts[] = {
+        "http_proxy", "headers", "user_agent", "referer", "cookies",
+        "auth_type", "reconnect_on_network_error", NULL };
+    HTTPContext *s = h->priv_data;
+    HTTPRanges *r;
+    uint64_t end = s->end_off ? FFMIN(s->end_off, s->filesize) : s->filesize;
+    int ret;
+
+    if (h->is_streamed || (h->flags & AVIO_FLAG_WRITE) || s->post_data ||
+        (s->method && strcmp(s->method, "GET")) || s->icy_metaint ||
+        s->chunksize != UINT64_MAX || end == UINT64_MAX ||
+        end - s->off <= s->range_size)
+        return 0;
+#if CONFIG_ZLIB
+    if (s->compressed)
+        return 0;
+#endif
+
+    if (!(r = av_mallocz(sizeof(*r))))
+        return AVERROR(ENOMEM);
+    r->h          = h;
+    r->end        = end;
+    r->range_size = s->range_size;
+    r->nb_slots   = 2 * s->parallel_ranges;
+    r->interrupt_callback.callback = ranges_interrupt_cb;
+    r->interrupt_callback.opaque   = r;
+    atomic_init(&r->abort, 0);
+
+    if (!(r->url     = av_strdup(s->location)) ||
+        !(r->slots   = av_calloc(r->nb_slots, sizeof(*r->slots))) ||
+        !(r->threads = av_calloc(s->parallel_ranges, sizeof(*r->threads)))) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = av_dict_copy(&r->options, s->chained_options, 0)) < 0)
+        goto fail;
+    for (int i = 0; opts[i]; i++) {
+        uint8_t *val;
+        if ((ret = av_opt_get(s, opts[i], 0, &val)) < 0)
+            goto fail;
+        if (val && *val)
+            ret = av_dict_set(&r->options, opts[i], val, AV_DICT_DONT_STRDUP_VAL);
+        else
+            av_free(val);
+        if (ret < 0)
+            goto fail;
+    }
+    if ((ret = av_dict_set(&r->options, "icy", "0", 0)) < 0 ||
+        (ret = av_dict_set(&r->options, "seekable", "1", 0)) < 0 ||
+        (ret = av_dict_set(&r->options, "connection_pool", "1", 0)) < 0 ||
+        (ret = av_dict_set(&r->options, "parallel_ranges", "0", 0)) < 0)
+        goto fail;
+
+    if ((ret = pthread_mutex_init(&r->mutex, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&r->cond, NULL))) {
+        pthread_mutex_destroy(&r->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    s->ranges = r;
+    for (; r->nb_threads < s->parallel_ranges; r->nb_threads++) {
+        if ((ret = pthread_create(&r->threads[r->nb_threads], NULL, ranges_worker, r))) {
+            ranges_stop(s);
+            return AVERROR(ret);
+        }
+    }
+
+    av_log(h, AV_LOG_VERBOSE, "Reading with %d parallel range requests of %d bytes\n",
+           r->nb_threads, r->range_size);
+    /* the reads are served by the range requests from now on */
+    ffurl_closep(&s->hd);
+    return 0;
+fail:
+    av_freep(&r->url);
+    av_freep(&r->slots);
+    av_freep(&r->threads);
+    av_dict_free(&r->options);
+    av_free(r);
+    return ret;
+}
+#else
+static int ranges_start(URLContext *h)
+{
+    return 0;
+}
+
+static void ranges_stop(HTTPContext *s)
+{
+}
+
+static int ranges_read(URLContext *h, uint8_t *buf, int size)
+{
+    return AVERROR(ENOSYS);
+}
+#endif /* HAVE_THREADS */
+
 static int http_open(URLContext *h, const char *uri, int flags,
                      AVDictionary **options)
 {
@@ -727,8 +1302,11 @@ static int http_open(URLContext *h, const char *uri, int flags,
         return http_listen(h, uri, flags, options);
     }
     ret = http_open_cnx(h, options);
+    if (ret >= 0 && s->parallel_ranges && (ret = ranges_start(h)) < 0)
+        ffurl_closep(&s->hd);
 bail_out:
     if (ret < 0) {
+        av_freep(&s->pool_key);
         av_dict_free(&s->chained_options);
         av_dict_free(&s->cookie_dict);
         av_dict_free(&s->redirect_cache);
@@ -837,8 +1415,12 @@ static void parse_content_range(URLContext *h, const char *p)
     const char *slash;
 
     if (!strncmp(p, "bytes ", 6)) {
+        const char *dash;
+
         p     += 6;
         s->off = strtoull(p, NULL, 10);
+        if ((dash = strchr(p, '-')))
+            s->body_end = strtoull(dash + 1, NULL, 10) + 1;
         if ((slash = strchr(p, '/')) && strlen(slash) > 0)
             s->filesize_from_content_range = strtoull(slash + 1, NULL, 10);
     }
@@ -1184,7 +1766,7 @@ static int process_line(URLContext *h, char *line, int line_count)
                 return ret;
         } else if (!av_strcasecmp(tag, "Content-Length") &&
                    s->filesize == UINT64_MAX) {
-            s->filesize = strtoull(p, NULL, 10);
+            s->filesize = s->content_length = strtoull(p, NULL, 10);
         } else if (!av_strcasecmp(tag, "Content-Range")) {
             parse_content_range(h, p);
         } else if (!av_strcasecmp(tag, "Accept-Ranges") &&
@@ -1343,6 +1925,8 @@ static int http_read_header(URLContext *h)
     s->expires = 0;
     s->chunksize = UINT64_MAX;
     s->filesize_from_content_range = UINT64_MAX;
+    s->content_length              = UINT64_MAX;
+    s->body_end                    = UINT64_MAX;
 
     for (;;) {
         if ((err = http_get_line(s, line, sizeof(line))) < 0)
@@ -1361,6 +1945,8 @@ static int http_read_header(URLContext *h)
     // filesize from Content-Range can always be used, even if using chunked Transfer-Encoding
     if (s->filesize_from_content_range != UINT64_MAX)
         s->filesize = s->filesize_from_content_range;
+    if (s->body_end == UINT64_MAX && s->content_length != UINT64_MAX)
+        s->body_end = s->off + s->content_length;
 
     if (s->seekable == -1 && s->is_mediagateway && s->filesize == 2000000000)
         h->is_streamed = 1; /* we can in fact _not_ seek */
@@ -1482,7 +2068,8 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
         av_bprintf(&request, "Expect: 100-continue\r\n");
 
     if (!has_header(s->headers, "\r\nConnection: "))
-        av_bprintf(&request, "Connection: %s\r\n", s->multiple_requests ? "keep-alive" : "close");
+        av_bprintf(&request, "Connection: %s\r\n",
+                   s->multiple_requests || s->pool_key ? "keep-alive" : "close");
 
     if (!has_header(s->headers, "\r\nHost: "))
         av_bprintf(&request, "Host: %s\r\n", hoststr);
@@ -1587,7 +2174,7 @@ static int http_buf_read(URLContext *h, uint8_t *buf, int size)
                    "Chunked encoding data size: %"PRIu64"\n",
                     s->chunksize);
 
-            if (!s->chunksize && s->multiple_requests) {
+            if (!s->chunksize && (s->multiple_requests || s->pool_key)) {
                 http_get_line(s, line, sizeof(line)); // read empty chunk
                 s->chunkend = 1;
                 return 0;
@@ -1810,6 +2397,9 @@ static int http_read(URLContext *h, uint8_t *buf, int size)
 {
     HTTPContext *s = h->priv_data;
 
+    if (s->ranges)
+        return ranges_read(h, buf, size);
+
     if (s->icy_metaint > 0) {
         size = store_icy(h, size);
         if (size < 0)
@@ -1888,10 +2478,14 @@ static int http_close(URLContext *h)
     av_freep(&s->inflate_buffer);
 #endif /* CONFIG_ZLIB */
 
+    ranges_stop(s);
+
     if (s->hd && !s->end_chunked_post)
         /* Close the write direction by sending the end of chunked encoding. */
         ret = http_shutdown(h, h->flags);
 
+    if (s->hd && connection_reusable(h))
+        pool_put(h);
     if (s->hd)
         ffurl_closep(&s->hd);
     av_dict_free(&s->chained_options);
@@ -1899,6 +2493,7 @@ static int http_close(URLContext *h)
     av_dict_free(&s->redirect_cache);
     av_freep(&s->new_location);
     av_freep(&s->uri);
+    av_freep(&s->pool_key);
     return ret;
 }
 
@@ -1930,6 +2525,10 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
         return AVERROR(EINVAL);
     s->off = off;
 
+    /* the range requests start at the position of the next read */
+    if (s->ranges)
+        return off;
+
     if (s->off && h->is_streamed)
         return AVERROR(ENOSYS);
 
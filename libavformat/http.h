@@ -71,4 +71,10 @@ int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **optio
 
 int ff_http_averror(int status_code, int default_averror);
 
+/**
+ * Close the idle connections kept in the process-wide connection pool.
+ * Connections in use are pooled again when they are closed.
+ */
+void ff_http_close_pool(void);
+
 #endif /* AVFORMAT_HTTP_H */
@@ -69,6 +69,7 @@ typedef struct FFFrac {
     int64_t val, num, den;
 } FFFrac;
 
+#define MAX_INTERLEAVE_LEVELS 16
 
 typedef struct FFFormatContext {
     /**
@@ -106,6 +107,16 @@ typedef struct FFFormatContext {
      */
     PacketList packet_buffer;
 
+    /**
+     * Skip list over packet_buffer, used by the default muxing interleaver
+     * to find insertion points in logarithmic time; see mux.c.
+     * Level 0 is packet_buffer itself.
+     */
+    PacketListEntry *interleave_skip_head[MAX_INTERLEAVE_LEVELS];
+    PacketListEntry *interleave_skip_tail[MAX_INTERLEAVE_LEVELS];
+    int interleave_levels;
+    unsigned interleave_seed;
+
     /* av_seek_frame() support */
     int64_t data_offset; /**< offset of the first packet */
 
@@ -169,6 +180,14 @@ typedef struct FFFormatContext {
      */
     int streams_initialized;
 
+    /**
+     * Set by the muxer while s->pb is written from another thread.
+     * The generic muxing code does not access s->pb then, write errors
+     * are returned by the muxer callbacks and the muxer writes the
+     * trailer data marker itself.
+     */
+    int pb_busy;
+
     /**
      * ID3v2 tag useful for MP3 demuxing
      */
@@ -934,6 +953,13 @@ int ff_format_io_close(AVFormatContext *s, AVIOContext **pb);
  * instead. */
 void ff_format_io_close_default(AVFormatContext *s, AVIOContext *pb);
 
+/**
+ * Check whether the I/O callbacks of s are the default ones, so that files
+ * can be opened and closed directly with the protocol whitelist of s,
+ * e.g. from another thread.
+ */
+int ff_format_io_is_default(const AVFormatContext *s);
+
 /**
  * Utility function to check if the file uses http or https protocol
  *
@@ -1023,4 +1049,37 @@ void avpriv_register_devices(const AVOutputFormat * const o[], const AVInputForm
  */
 int ff_format_shift_data(AVFormatContext *s, int64_t read_start, int shift_size);
 
+/**
+ * Insert space at pos in the output without rewriting the data after it,
+ * when the output is a local file on a filesystem supporting it. The output
+ * is flushed first.
+ *
+ * @return the size of the inserted space, at least min_size and at most
+ *         max_size, by which the data from pos is moved; AVERROR(ENOSYS) if
+ *         the space could not be inserted but the output is unchanged, e.g.
+ *         because it does not support it; another negative AVERROR code on
+ *         failure
+ */
+int64_t ff_format_insert_space(AVFormatContext *s, int64_t pos,
+                               int64_t min_size, int64_t max_size);
+
+/**
+ * Get the input format recorded in AVFormatContext.probe_info, to be used
+ * instead of probing the opened AVFormatContext.pb.
+ *
+ * @param score set to the probe score recorded with it
+ * @return the input format, or NULL if the probe info is invalid, was
+ *         saved by another libavformat version or for an input of another size
+ */
+const AVInputFormat *ff_probe_info_format(AVFormatContext *s, int *score);
+
+/**
+ * Restore the stream information recorded in AVFormatContext.probe_info
+ * into the streams created by read_header().
+ *
+ * @return 1 if it was restored, 0 if it is invalid or does not match the input,
+ *         a negative AVERROR code on failure
+ */
+int ff_probe_info_apply(AVFormatContext *s);
+
 #endif /* AVFORMAT_INTERNAL_H */
@@ -240,6 +240,13 @@ typedef struct MOVStreamContext {
     uint32_t format;
 
     int has_sidx;  // If there is an sidx entry for this stream.
+
+    /* samples read ahead with the one read after a seek, see track_readahead */
+    uint8_t *readahead;
+    unsigned int readahead_alloc;
+    int64_t readahead_pos;
+    int readahead_size;
+
     struct {
         struct AVAESCTR* aes_ctr;
         struct AVAES *aes_ctx;
@@ -306,6 +313,7 @@ typedef struct MOVContext {
     int have_read_mfra_size;
     uint32_t mfra_size;
     uint32_t max_stts_delta;
+    int track_readahead;
 } MOVContext;
 
 int ff_mp4_read_descr_len(AVIOContext *pb);
@@ -31,6 +31,7 @@
 #include "config.h"
 
 #include <inttypes.h>
+#include <stdatomic.h>
 #include <stdio.h>
 
 #include "libavutil/avstring.h"
@@ -46,6 +47,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/time_internal.h"
 #include "libavutil/spherical.h"
+#include "libavutil/thread.h"
 
 #include "libavcodec/bytestream.h"
 #include "libavcodec/flac.h"
@@ -83,6 +85,8 @@
 #define UNKNOWN_EQUIV         50 * 1024 /* An unknown element is considered equivalent
                                          * to this many bytes of unknown data for the
                                          * SKIP_THRESHOLD check. */
+#define BLOCK_ARENA_SIZE     256 * 1024 /* Size of the buffers the blocks are read into. */
+#define BLOCK_ARENA_MAX_SIZE  16 * 1024 /* Larger blocks get their own buffer. */
 
 typedef enum {
     EBML_NONE,
@@ -360,6 +364,11 @@ typedef struct MatroskaCluster {
     int64_t pos;
 } MatroskaCluster;
 
+typedef struct MatroskaClusterIndexEntry {
+    int64_t  pos;
+    uint64_t timecode;
+} MatroskaClusterIndexEntry;
+
 typedef struct MatroskaLevel1Element {
     int64_t  pos;
     uint32_t id;
@@ -419,6 +428,28 @@ typedef struct MatroskaDemuxContext {
 
     /* Bandwidth value for WebM DASH Manifest */
     int bandwidth;
+
+    /* Sparse index of the clusters found while seeking in files without
+     * Cues or by the background indexer, sorted by position. */
+    MatroskaClusterIndexEntry *cluster_index;
+    int nb_cluster_index;
+    unsigned cluster_index_size;
+    int cueless_seek;
+    int index_clusters;
+#if HAVE_THREADS
+    pthread_t indexer_thread;
+    pthread_mutex_t cluster_index_lock;
+    AVIOContext *indexer_pb;
+    int64_t indexer_start;
+    int64_t indexer_end;
+    atomic_int indexer_stop;
+    int indexer_started;
+#endif
+
+    /* Buffer the small blocks are read into one after the other, so that
+     * their packets reference it instead of getting their own buffer. */
+    AVBufferRef *block_arena;
+    int block_arena_used;
 } MatroskaDemuxContext;
 
 #define CHILD_OF(parent) { .def = { .n = parent } }
@@ -1082,6 +1113,49 @@ static int ebml_read_binary(AVIOContext *pb, int length,
     return 0;
 }
 
+/*
+ * Read the data of a Block or SimpleBlock of at most BLOCK_ARENA_MAX_SIZE
+ * bytes into the block arena, or into its own buffer if it is larger.
+ * In the former case, bin->buf is left unset: the block is parsed before
+ * the arena can be replaced, and its packets reference the arena directly.
+ * 0 is success, < 0 or NEEDS_CHECKING is failure.
+ */
+static int ebml_read_block(MatroskaDemuxContext *matroska, AVIOContext *pb,
+                           int length, int64_t pos, EbmlBin *bin)
+{
+    int size = FFALIGN(length + AV_INPUT_BUFFER_PADDING_SIZE, 64);
+    int ret;
+
+    if (length > BLOCK_ARENA_MAX_SIZE)
+        return ebml_read_binary(pb, length, pos, bin);
+
+    if (!matroska->block_arena ||
+        matroska->block_arena_used + size > matroska->block_arena->size) {
+        /* reuse the arena if no packet references it anymore */
+        if (!matroska->block_arena || !av_buffer_is_writable(matroska->block_arena)) {
+            av_buffer_unref(&matroska->block_arena);
+            matroska->block_arena = av_buffer_alloc(BLOCK_ARENA_SIZE);
+            if (!matroska->block_arena)
+                return AVERROR(ENOMEM);
+        }
+        matroska->block_arena_used = 0;
+    }
+
+    av_buffer_unref(&bin->buf);
+    bin->data = matroska->block_arena->data + matroska->block_arena_used;
+    bin->size = length;
+    bin->pos  = pos;
+    if ((ret = avio_read(pb, bin->data, length)) != length) {
+        bin->data = NULL;
+        bin->size = 0;
+        return ret < 0 ? ret : NEEDS_CHECKING;
+    }
+    memset(bin->data + length, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    matroska->block_arena_used += size;
+
+    return 0;
+}
+
 /*
  * Read the next element, but only the header. The contents
  * are supposed to be sub-elements which can be read separately.
@@ -1459,7 +1533,10 @@ static int ebml_parse(MatroskaDemuxContext *matroska,
         res = ebml_read_ascii(pb, length, syntax->def.s, data);
         break;
     case EBML_BIN:
-        res = ebml_read_binary(pb, length, pos_alt, data);
+        if (id == MATROSKA_ID_SIMPLEBLOCK || id == MATROSKA_ID_BLOCK)
+            res = ebml_read_block(matroska, pb, length, pos_alt, data);
+        else
+            res = ebml_read_binary(pb, length, pos_alt, data);
         break;
     case EBML_LEVEL1:
     case EBML_NEST:
@@ -2990,6 +3067,291 @@ static int matroska_parse_tracks(AVFormatContext *s)
     return 0;
 }
 
+/* Minimum size of the byte range which is bisected when looking for a
+ * cluster in a file without Cues, below it the clusters are parsed. */
+#define CLUSTER_BISECT_MIN (64 * 1024)
+/* Spacing at which the background indexer stops refining the index. */
+#define CLUSTER_INDEX_SPACING (4 * 1024 * 1024)
+
+static void cluster_index_lock(MatroskaDemuxContext *matroska)
+{
+#if HAVE_THREADS
+    if (matroska->indexer_started)
+        pthread_mutex_lock(&matroska->cluster_index_lock);
+#endif
+}
+
+static void cluster_index_unlock(MatroskaDemuxContext *matroska)
+{
+#if HAVE_THREADS
+    if (matroska->indexer_started)
+        pthread_mutex_unlock(&matroska->cluster_index_lock);
+#endif
+}
+
+static void cluster_index_add(MatroskaDemuxContext *matroska,
+                              int64_t pos, uint64_t timecode)
+{
+    MatroskaClusterIndexEntry *entries;
+    int lo = 0, hi;
+
+    cluster_index_lock(matroska);
+    hi = matroska->nb_cluster_index;
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (matroska->cluster_index[mid].pos < pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < matroska->nb_cluster_index && matroska->cluster_index[lo].pos == pos)
+        goto end;
+    entries = av_fast_realloc(matroska->cluster_index, &matroska->cluster_index_size,
+                              (matroska->nb_cluster_index + 1) * sizeof(*entries));
+    if (!entries)
+        goto end;
+    memmove(entries + lo + 1, entries + lo,
+            (matroska->nb_cluster_index - lo) * sizeof(*entries));
+    entries[lo].pos      = pos;
+    entries[lo].timecode = timecode;
+    matroska->cluster_index = entries;
+    matroska->nb_cluster_index++;
+end:
+    cluster_index_unlock(matroska);
+}
+
+/*
+ * Read an EBML number like ebml_read_num(), but without logging errors
+ * as the position it is read from is only a guess.
+ */
+static int probe_ebml_num(AVIOContext *pb, int max_size, uint64_t *number)
+{
+    uint64_t total = avio_r8(pb);
+    int read, n;
+
+    if (!total || pb->eof_reached)
+        return AVERROR_INVALIDDATA;
+    read = 8 - ff_log2_tab[total];
+    if (read > max_size)
+        return AVERROR_INVALIDDATA;
+    total ^= 1 << ff_log2_tab[total];
+    for (n = 1; n < read; n++)
+        total = (total << 8) | avio_r8(pb);
+    *number = total;
+    return pb->eof_reached ? AVERROR_INVALIDDATA : read;
+}
+
+/*
+ * Check that a cluster starts right after its ID and read its timestamp,
+ * which muxers write as its first child, possibly after a CRC-32.
+ */
+static int probe_cluster_timecode(AVIOContext *pb, uint64_t *timecode)
+{
+    uint64_t length, id;
+    int n;
+
+    if (probe_ebml_num(pb, 8, &length) < 0)
+        return AVERROR_INVALIDDATA;
+    id = avio_r8(pb);
+    if (id == EBML_ID_CRC32 && probe_ebml_num(pb, 8, &length) >= 0 &&
+        length == 4) {
+        avio_skip(pb, 4);
+        id = avio_r8(pb);
+    }
+    if (id != MATROSKA_ID_CLUSTERTIMECODE ||
+        probe_ebml_num(pb, 8, &length) < 0 || !length || length > 8)
+        return AVERROR_INVALIDDATA;
+    for (*timecode = 0, n = 0; n < length; n++)
+        *timecode = (*timecode << 8) | avio_r8(pb);
+    return pb->eof_reached ? AVERROR_INVALIDDATA : 0;
+}
+
+/*
+ * Find the first cluster starting in [pos, end) and read its timestamp.
+ * Returns its position, AVERROR(ENOENT) if there is none, or another
+ * negative error code.
+ */
+static int64_t find_cluster(AVIOContext *pb, int64_t pos, int64_t end,
+                            uint64_t *timecode)
+{
+    uint32_t id = 0;
+    int64_t ret;
+
+    if ((ret = avio_seek(pb, pos, SEEK_SET)) < 0)
+        return ret;
+    while (pos < end) {
+        id = (id << 8) | avio_r8(pb);
+        if (avio_feof(pb))
+            return pb->error ? pb->error : AVERROR(ENOENT);
+        pos++;
+        if (id == MATROSKA_ID_CLUSTER) {
+            if (probe_cluster_timecode(pb, timecode) >= 0)
+                return pos - 4;
+            if ((ret = avio_seek(pb, pos, SEEK_SET)) < 0)
+                return ret;
+            id = 0;
+        }
+    }
+    return AVERROR(ENOENT);
+}
+
+/*
+ * Find by bisection the last cluster starting in [lo, hi) with a timestamp
+ * not above timecode, starting from the bounds known from the sparse
+ * cluster index and adding the clusters found to it. Below
+ * CLUSTER_BISECT_MIN bytes, the first cluster of the remaining range is
+ * returned and the caller is expected to parse the clusters from there.
+ */
+static int64_t matroska_bisect_cluster(MatroskaDemuxContext *matroska,
+                                       uint64_t timecode, int64_t lo, int64_t hi,
+                                       uint64_t *found_timecode)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    int64_t found = -1, pos;
+    uint64_t tc;
+    int i;
+
+    cluster_index_lock(matroska);
+    for (i = 0; i < matroska->nb_cluster_index; i++) {
+        const MatroskaClusterIndexEntry *e = &matroska->cluster_index[i];
+        if (e->pos < lo || e->pos >= hi)
+            continue;
+        if (e->timecode > timecode) {
+            hi = e->pos;
+            break;
+        }
+        found           = e->pos;
+        *found_timecode = e->timecode;
+    }
+    cluster_index_unlock(matroska);
+    if (found >= 0)
+        lo = found + 1;
+
+    while (hi - lo > CLUSTER_BISECT_MIN) {
+        int64_t mid = lo + (hi - lo) / 2;
+
+        pos = find_cluster(pb, mid, hi, &tc);
+        if (pos == AVERROR(ENOENT)) {
+            hi = mid;
+            continue;
+        } else if (pos < 0)
+            return pos;
+        cluster_index_add(matroska, pos, tc);
+        if (tc <= timecode) {
+            found           = pos;
+            *found_timecode = tc;
+            lo              = pos + 1;
+        } else
+            hi = mid;
+    }
+
+    if (found < 0) {
+        found = find_cluster(pb, lo, hi, &tc);
+        if (found >= 0) {
+            cluster_index_add(matroska, found, tc);
+            *found_timecode = tc;
+        }
+    }
+    return found;
+}
+
+#if HAVE_THREADS
+/*
+ * Build a sparse cluster index in the background, probing the file at
+ * positions halving the spacing at each pass, so that the seeks made while
+ * it runs already benefit from the coarse passes.
+ */
+static void *matroska_cluster_indexer(void *arg)
+{
+    MatroskaDemuxContext *matroska = arg;
+    int64_t start = matroska->indexer_start, size = matroska->indexer_end - start;
+    int level, nb_entries;
+
+    for (level = 1; size >> level >= CLUSTER_INDEX_SPACING; level++) {
+        int64_t step = size >> level, k;
+
+        for (k = 1; k < 1LL << level; k += 2) {
+            uint64_t tc;
+            int64_t pos;
+
+            if (atomic_load(&matroska->indexer_stop))
+                return NULL;
+            pos = find_cluster(matroska->indexer_pb, start + k * step,
+                               start + (k + 1) * step, &tc);
+            if (pos >= 0)
+                cluster_index_add(matroska, pos, tc);
+            else if (pos != AVERROR(ENOENT))
+                return NULL;
+        }
+    }
+    cluster_index_lock(matroska);
+    nb_entries = matroska->nb_cluster_index;
+    cluster_index_unlock(matroska);
+    av_log(matroska->ctx, AV_LOG_VERBOSE, "Cluster index done, %d entries\n",
+           nb_entries);
+    return NULL;
+}
+#endif
+
+static int matroska_start_indexer(AVFormatContext *s)
+{
+#if HAVE_THREADS
+    MatroskaDemuxContext *matroska = s->priv_data;
+    AVDictionary *opts = NULL;
+    int64_t size = avio_size(s->pb);
+    int i, ret;
+
+    if (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL) || size <= 0 || !s->url)
+        return 0;
+    for (i = 0; i < matroska->num_level1_elems; i++)
+        if (matroska->level1_elems[i].id == MATROSKA_ID_CUES)
+            return 0;
+
+    /* opened here, the indexer thread only reads from it */
+    if ((ret = ffio_copy_url_options(s->pb, &opts)) < 0) {
+        av_dict_free(&opts);
+        return ret;
+    }
+    ret = s->io_open(s, &matroska->indexer_pb, s->url, AVIO_FLAG_READ, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        av_log(s, AV_LOG_WARNING, "Cannot open the input for the cluster indexer\n");
+        return 0;
+    }
+    matroska->indexer_start = FFMAX(ffformatcontext(s)->data_offset, matroska->segment_start);
+    matroska->indexer_end   = size;
+    atomic_init(&matroska->indexer_stop, 0);
+    if ((ret = pthread_mutex_init(&matroska->cluster_index_lock, NULL))) {
+        ff_format_io_close(s, &matroska->indexer_pb);
+        return AVERROR(ret);
+    }
+    matroska->indexer_started = 1;
+    if ((ret = pthread_create(&matroska->indexer_thread, NULL,
+                              matroska_cluster_indexer, matroska))) {
+        matroska->indexer_started = 0;
+        pthread_mutex_destroy(&matroska->cluster_index_lock);
+        ff_format_io_close(s, &matroska->indexer_pb);
+        return AVERROR(ret);
+    }
+#endif
+    return 0;
+}
+
+static void matroska_stop_indexer(AVFormatContext *s)
+{
+#if HAVE_THREADS
+    MatroskaDemuxContext *matroska = s->priv_data;
+
+    if (!matroska->indexer_started)
+        return;
+    atomic_store(&matroska->indexer_stop, 1);
+    pthread_join(matroska->indexer_thread, NULL);
+    matroska->indexer_started = 0;
+    pthread_mutex_destroy(&matroska->cluster_index_lock);
+    ff_format_io_close(s, &matroska->indexer_pb);
+#endif
+}
+
 static int matroska_read_header(AVFormatContext *s)
 {
     FFFormatContext *const si = ffformatcontext(s);
@@ -3137,6 +3499,10 @@ static int matroska_read_header(AVFormatContext *s)
 
     matroska_convert_tags(s);
 
+    /* the index is only used by the bisection */
+    if (matroska->index_clusters && matroska->cueless_seek)
+        return matroska_start_indexer(s);
+
     return 0;
 }
 
@@ -3610,6 +3976,20 @@ static int matroska_parse_frame(MatroskaDemuxContext *matroska,
     if (!pkt_size && !additional_size)
         goto no_output;
 
+    /* The packets of sparse streams, e.g. subtitles, may be kept around for
+     * long; do not let them pin a whole block arena meanwhile. */
+    if (buf && buf == matroska->block_arena &&
+        st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO &&
+        st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) {
+        uint8_t *copy = av_malloc(pkt_size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!copy)
+            return AVERROR(ENOMEM);
+        memcpy(copy, pkt_data, pkt_size);
+        memset(copy + pkt_size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+        pkt_data = copy;
+        buf      = NULL;
+    }
+
     if (!buf)
         pkt->buf = av_buffer_create(pkt_data, pkt_size + AV_INPUT_BUFFER_PADDING_SIZE,
                                     NULL, NULL, 0);
@@ -3685,6 +4065,7 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
                                 int64_t cluster_pos, int64_t discard_padding)
 {
     uint64_t timecode = AV_NOPTS_VALUE;
+    uint8_t *block_data = data;
     MatroskaTrack *track;
     FFIOContext pb;
     int res = 0;
@@ -3783,14 +4164,27 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
         int      out_size = lace_size[n];
 
         if (track->needs_decoding) {
-            res = matroska_decode_buffer(&out_data, &out_size, track);
-            if (res < 0)
-                return res;
-            /* Given that we are here means that out_data is no longer
-             * owned by buf, so set it to NULL. This depends upon
-             * zero-length header removal compression being ignored. */
-            av_assert1(out_data != data);
-            buf = NULL;
+            const MatroskaTrackEncoding *encodings = track->encodings.elem;
+            const EbmlBin *header = &encodings[0].compression.settings;
+
+            /* The header stripped from the first frame can be put back in
+             * place of the block header, which has been parsed already. */
+            if (!n && buf && header->data &&
+                encodings[0].compression.algo == MATROSKA_TRACK_ENCODING_COMP_HEADERSTRIP &&
+                header->size <= data - block_data) {
+                out_data -= header->size;
+                out_size += header->size;
+                memcpy(out_data, header->data, header->size);
+            } else {
+                res = matroska_decode_buffer(&out_data, &out_size, track);
+                if (res < 0)
+                    return res;
+                /* Given that we are here means that out_data is no longer
+                 * owned by buf, so set it to NULL. This depends upon
+                 * zero-length header removal compression being ignored. */
+                av_assert1(out_data != data);
+                buf = NULL;
+            }
         }
 
         if (track->audio.buf) {
@@ -3857,8 +4251,9 @@ static int matroska_parse_cluster(MatroskaDemuxContext *matroska)
             int is_keyframe = block->non_simple ? block->reference.count == 0 : -1;
             uint8_t* additional = block->additional.size > 0 ?
                                     block->additional.data : NULL;
+            AVBufferRef *buf = block->bin.buf ? block->bin.buf : matroska->block_arena;
 
-            res = matroska_parse_block(matroska, block->bin.buf, block->bin.data,
+            res = matroska_parse_block(matroska, buf, block->bin.data,
                                        block->bin.size, block->bin.pos,
                                        cluster->timecode, block->duration,
                                        is_keyframe, additional, block->additional_id,
@@ -3904,6 +4299,61 @@ static int matroska_read_packet(AVFormatContext *s, AVPacket *pkt)
     return 0;
 }
 
+/*
+ * Seek in a file without Cues: bisect to the cluster containing the target
+ * and parse the clusters up to it to index their keyframes. If there is no
+ * keyframe before the target in them, start again from further back, with
+ * the distance doubling each time.
+ * Returns the index entry to seek to, or a negative value to fall back to
+ * the linear search.
+ */
+static int matroska_seek_cueless(MatroskaDemuxContext *matroska, AVStream *st,
+                                 int64_t timestamp, int flags)
+{
+    FFStream *const sti = ffstream(st);
+    AVIOContext *pb = matroska->ctx->pb;
+    MatroskaTrack *tracks = matroska->tracks.elem;
+    int64_t lo = ffformatcontext(matroska->ctx)->data_offset;
+    int64_t hi = avio_size(pb);
+    uint64_t target, timecode, backoff = 1000000000 / matroska->time_scale;
+    double track_time_scale = 1.0;
+    int i, index;
+
+    if (!(pb->seekable & AVIO_SEEKABLE_NORMAL) || hi <= 0)
+        return -1;
+    lo = FFMAX(lo, matroska->segment_start);
+    for (i = 0; i < matroska->tracks.nb_elem; i++)
+        if (tracks[i].stream == st)
+            track_time_scale = tracks[i].time_scale;
+    target = timecode = FFMAX(timestamp, 0) * track_time_scale;
+
+    for (;;) {
+        uint64_t cluster_timecode;
+        int64_t pos = matroska_bisect_cluster(matroska, timecode, lo, hi,
+                                              &cluster_timecode);
+        if (pos < 0)
+            return -1;
+
+        matroska_reset_status(matroska, 0, pos);
+        matroska->current_cluster.timecode = cluster_timecode;
+        while (matroska->current_cluster.timecode <= target) {
+            matroska_clear_queue(matroska);
+            if (matroska_parse_cluster(matroska) < 0)
+                break;
+        }
+        matroska_clear_queue(matroska);
+
+        index = av_index_search_timestamp(st, timestamp, flags);
+        if (index >= 0 && sti->index_entries[index].pos >= pos)
+            return index;
+        if (pos <= lo || !timecode)
+            return -1;
+        timecode = target > backoff ? target - backoff : 0;
+        backoff *= 2;
+        hi       = pos;
+    }
+}
+
 static int matroska_read_seek(AVFormatContext *s, int stream_index,
                               int64_t timestamp, int flags)
 {
@@ -3923,8 +4373,15 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
         goto err;
     timestamp = FFMAX(timestamp, sti->index_entries[0].timestamp);
 
-    if ((index = av_index_search_timestamp(st, timestamp, flags)) < 0 ||
-         index == sti->nb_index_entries - 1) {
+    /* Without Cues, the keyframes indexed while bisecting leave gaps in
+     * the index, so it is only used as a fallback. */
+    index = -1;
+    if (matroska->cueless_seek && matroska->index.nb_elem < 2)
+        index = matroska_seek_cueless(matroska, st, timestamp, flags);
+
+    if (index < 0 &&
+        ((index = av_index_search_timestamp(st, timestamp, flags)) < 0 ||
+         index == sti->nb_index_entries - 1)) {
         matroska_reset_status(matroska, 0, sti->index_entries[sti->nb_index_entries - 1].pos);
         while ((index = av_index_search_timestamp(st, timestamp, flags)) < 0 ||
                index == sti->nb_index_entries - 1) {
@@ -3978,6 +4435,9 @@ static int matroska_read_close(AVFormatContext *s)
     MatroskaTrack *tracks = matroska->tracks.elem;
     int n;
 
+    matroska_stop_indexer(s);
+    av_freep(&matroska->cluster_index);
+    av_buffer_unref(&matroska->block_arena);
     matroska_clear_queue(matroska);
 
     for (n = 0; n < matroska->tracks.nb_elem; n++)
@@ -3988,6 +4448,8 @@ static int matroska_read_close(AVFormatContext *s)
     return 0;
 }
 
+#define OFFSET(x) offsetof(MatroskaDemuxContext, x)
+
 #if CONFIG_WEBM_DASH_MANIFEST_DEMUXER
 typedef struct {
     int64_t start_time_ns;
@@ -4397,7 +4859,6 @@ static int webm_dash_manifest_read_packet(AVFormatContext *s, AVPacket *pkt)
     return AVERROR_EOF;
 }
 
-#define OFFSET(x) offsetof(MatroskaDemuxContext, x)
 static const AVOption options[] = {
     { "live", "flag indicating that the input is a live file that only has the headers.", OFFSET(is_live), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "bandwidth", "bandwidth of this stream to be specified in the DASH manifest.", OFFSET(bandwidth), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_DECODING_PARAM },
@@ -4423,10 +4884,24 @@ const AVInputFormat ff_webm_dash_manifest_demuxer = {
 };
 #endif
 
+static const AVOption matroska_options[] = {
+    { "cueless_seek", "seek by bisection in files without Cues", OFFSET(cueless_seek), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "index_clusters", "build a sparse cluster index in the background for files without Cues", OFFSET(index_clusters), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { NULL },
+};
+
+static const AVClass matroska_class = {
+    .class_name = "matroska,webm demuxer",
+    .item_name  = av_default_item_name,
+    .option     = matroska_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 const AVInputFormat ff_matroska_demuxer = {
     .name           = "matroska,webm",
     .long_name      = NULL_IF_CONFIG_SMALL("Matroska / WebM"),
     .extensions     = "mkv,mk3d,mka,mks,webm",
+    .priv_class     = &matroska_class,
     .priv_data_size = sizeof(MatroskaDemuxContext),
     .flags_internal = FF_FMT_INIT_CLEANUP,
     .read_probe     = matroska_probe,
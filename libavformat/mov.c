@@ -7699,6 +7699,7 @@ static int mov_read_close(AVFormatContext *s)
         av_freep(&sc->keyframes);
         av_freep(&sc->stts_data);
         av_freep(&sc->sdtp_data);
+        av_freep(&sc->readahead);
         av_freep(&sc->stps_data);
         av_freep(&sc->elst_data);
         av_freep(&sc->rap_group);
@@ -8129,6 +8130,51 @@ static int should_retry(AVIOContext *pb, int error_code) {
     return 1;
 }
 
+/**
+ * Read the samples of the track stored contiguously after the given one,
+ * which the input is positioned at, into the track read ahead buffer.
+ * With poorly interleaved files, the demuxer then alternates between the
+ * tracks in large reads instead of seeking for every sample, which matters
+ * when every seek is a new request to network storage.
+ */
+static int mov_fill_readahead(MOVContext *mov, AVStream *st, AVIndexEntry *sample)
+{
+    MOVStreamContext *sc = st->priv_data;
+    FFStream *const sti = ffstream(st);
+    int64_t end = sample->pos + sample->size;
+    int ret;
+
+    for (AVIndexEntry *e = sample + 1; e < sti->index_entries + sti->nb_index_entries; e++) {
+        if (e->pos != end || end + e->size - sample->pos > mov->track_readahead)
+            break;
+        end += e->size;
+    }
+    sc->readahead_size = 0;
+    if (end - sample->pos == sample->size)
+        return 0;
+
+    av_fast_malloc(&sc->readahead, &sc->readahead_alloc, end - sample->pos);
+    if (!sc->readahead)
+        return AVERROR(ENOMEM);
+    ret = avio_read(sc->pb, sc->readahead, end - sample->pos);
+    if (ret < 0)
+        return ret;
+    /* a truncated first sample is read as usual, from its position */
+    if (ret < sample->size) {
+        int64_t ret64 = avio_seek(sc->pb, sample->pos, SEEK_SET);
+        return ret64 < 0 ? (int)ret64 : 0;
+    }
+    sc->readahead_pos  = sample->pos;
+    sc->readahead_size = ret;
+    return 0;
+}
+
+static int mov_in_readahead(MOVStreamContext *sc, AVIndexEntry *sample)
+{
+    return sc->readahead_size && sample->pos >= sc->readahead_pos &&
+           sample->pos + sample->size <= sc->readahead_pos + sc->readahead_size;
+}
+
 static int mov_switch_root(AVFormatContext *s, int64_t target, int index)
 {
     int ret;
@@ -8237,7 +8283,8 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         sample->size = FFMIN(sample->size, (mov->next_root_atom - sample->pos));
     }
 
-    if (st->discard != AVDISCARD_ALL) {
+    if (st->discard != AVDISCARD_ALL && !mov_in_readahead(sc, sample)) {
+        int seek = avio_tell(sc->pb) != sample->pos;
         int64_t ret64 = avio_seek(sc->pb, sample->pos, SEEK_SET);
         if (ret64 != sample->pos) {
             av_log(mov->fc, AV_LOG_ERROR, "stream %d, offset 0x%"PRIx64": partial file\n",
@@ -8250,12 +8297,25 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             return AVERROR_INVALIDDATA;
         }
 
+        if (seek && mov->track_readahead && !mov->next_root_atom &&
+            st->codecpar->codec_id != AV_CODEC_ID_EIA_608 &&
+            (ret = mov_fill_readahead(mov, st, sample)) < 0) {
+            if (should_retry(sc->pb, ret))
+                mov_current_sample_dec(sc);
+            return ret;
+        }
+    }
+
+    if (st->discard != AVDISCARD_ALL) {
         if (st->discard == AVDISCARD_NONKEY && !(sample->flags & AVINDEX_KEYFRAME)) {
             av_log(mov->fc, AV_LOG_DEBUG, "Nonkey frame from stream %d discarded due to AVDISCARD_NONKEY\n", sc->ffindex);
             goto retry;
         }
 
-        if (st->codecpar->codec_id == AV_CODEC_ID_EIA_608 && sample->size > 8)
+        if (mov_in_readahead(sc, sample)) {
+            if ((ret = av_new_packet(pkt, sample->size)) >= 0)
+                memcpy(pkt->data, sc->readahead + sample->pos - sc->readahead_pos, sample->size);
+        } else if (st->codecpar->codec_id == AV_CODEC_ID_EIA_608 && sample->size > 8)
             ret = get_eia608_packet(sc->pb, pkt, sample->size);
         else
             ret = av_get_packet(sc->pb, pkt, sample->size);
@@ -8552,6 +8612,8 @@ static const AVOption mov_options[] = {
     { "enable_drefs", "Enable external track support.", OFFSET(enable_drefs), AV_OPT_TYPE_BOOL,
         {.i64 = 0}, 0, 1, FLAGS },
     { "max_stts_delta", "treat offsets above this value as invalid", OFFSET(max_stts_delta), AV_OPT_TYPE_INT, {.i64 = UINT_MAX-48000*10 }, 0, UINT_MAX, .flags = AV_OPT_FLAG_DECODING_PARAM },
+    { "track_readahead", "max size of the contiguous samples of a track to read at once after a seek",
+        OFFSET(track_readahead), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, .flags = AV_OPT_FLAG_DECODING_PARAM },
 
     { NULL },
 };
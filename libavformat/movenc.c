@@ -55,6 +55,9 @@
 #include "libavutil/timecode.h"
 #include "libavutil/dovi_meta.h"
 #include "libavutil/color_utils.h"
+#include "libavutil/fifo.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
 #include "hevc.h"
 #include "rtpenc.h"
 #include "mov_chan.h"
@@ -88,6 +91,9 @@ static const AVOption options[] = {
     { "use_metadata_tags", "Use mdta atom for metadata.", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_USE_MDTA}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "skip_trailer", "Skip writing the mfra/tfra/mfro trailer for fragmented files", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_SKIP_TRAILER}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "negative_cts_offsets", "Use negative CTS offsets (reducing the need for edit lists)", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_NEGATIVE_CTS_OFFSETS}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
+    { "reserve_moov", "Reserve space estimated from the expected duration for the moov atom at the beginning of the file", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_RESERVE_MOOV}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
+    { "insert_moov", "Insert the space for the moov atom at the beginning of the file instead of moving the data, when the filesystem supports it", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_INSERT_MOOV}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
+    { "expected_duration", "Expected duration of the output, used to estimate the space reserved for the moov atom", offsetof(MOVMuxContext, expected_duration), AV_OPT_TYPE_DURATION, {.i64 = 0}, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM},
     FF_RTP_FLAG_OPTS(MOVMuxContext, rtp_flags),
     { "skip_iods", "Skip writing iods atom.", offsetof(MOVMuxContext, iods_skip), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
     { "iods_audio_profile", "iods audio profile atom.", offsetof(MOVMuxContext, iods_audio_profile), AV_OPT_TYPE_INT, {.i64 = -1}, -1, 255, AV_OPT_FLAG_ENCODING_PARAM},
@@ -112,6 +118,10 @@ static const AVOption options[] = {
     { "pts", NULL, 0, AV_OPT_TYPE_CONST, {.i64 = MOV_PRFT_SRC_PTS}, 0, 0, AV_OPT_FLAG_ENCODING_PARAM, "prft"},
     { "empty_hdlr_name", "write zero-length name string in hdlr atoms within mdia and minf atoms", offsetof(MOVMuxContext, empty_hdlr_name), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
     { "movie_timescale", "set movie timescale", offsetof(MOVMuxContext, movie_timescale), AV_OPT_TYPE_INT, {.i64 = MOV_TIMESCALE}, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM},
+    { "frag_write_thread", "Write fragments from a separate thread", offsetof(MOVMuxContext, frag_write_thread), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
+    { "frag_write_buffer", "Maximum number of bytes queued for the fragment writer thread", offsetof(MOVMuxContext, frag_write_buffer), AV_OPT_TYPE_INT, {.i64 = 32 << 20}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM},
+    { "frag_write_queued", "Number of bytes waiting in the fragment writer queue", offsetof(MOVMuxContext, frag_write_queued), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY},
+    { "frag_write_latency", "Maximum time between queuing a fragment and writing it, in microseconds", offsetof(MOVMuxContext, frag_write_latency), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY},
     { NULL },
 };
 
@@ -4632,7 +4642,7 @@ static int mov_add_tfra_entries(AVIOContext *pb, MOVMuxContext *mov, int tracks,
             track->frag_info_capacity = new_capacity;
         }
         info = &track->frag_info[track->nb_frag_info - 1];
-        info->offset   = avio_tell(pb);
+        info->offset   = avio_tell(pb) + mov->frag_pos_base;
         info->size     = size;
         // Try to recreate the original pts for the first packet
         // from the fields we have stored
@@ -4734,7 +4744,7 @@ static int mov_write_moof_tag_internal(AVIOContext *pb, MOVMuxContext *mov,
             continue;
         if (!track->entry)
             continue;
-        mov_write_traf_tag(pb, mov, track, pos, moof_size);
+        mov_write_traf_tag(pb, mov, track, pos + mov->frag_pos_base, moof_size);
     }
 
     return update_size(pb, pos);
@@ -5393,9 +5403,287 @@ static int mov_write_squashed_packets(AVFormatContext *s)
     return 0;
 }
 
+#if HAVE_THREADS
+typedef struct MOVFragMarker {
+    int64_t pos;                    ///< offset of the marker in the fragment data
+    int64_t time;
+    enum AVIODataMarkerType type;
+} MOVFragMarker;
+
+typedef struct MOVQueuedFragment {
+    uint8_t *data;
+    int size;
+    MOVFragMarker *markers;
+    int nb_markers;
+    int64_t queue_time;
+} MOVQueuedFragment;
+
+typedef struct MOVFragWriter {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    AVFifo *queue;                  ///< MOVQueuedFragment entries, owned by the queue
+    int64_t queued_bytes;
+    int finish;
+    int abort;
+    int error;
+
+    AVIOContext *pb;                ///< dynamic buffer of the fragment being built
+    MOVQueuedFragment frag;
+} MOVFragWriter;
+
+static void frag_writer_free_fragment(MOVQueuedFragment *frag)
+{
+    av_freep(&frag->data);
+    av_freep(&frag->markers);
+    frag->nb_markers = 0;
+}
+
+static void *frag_writer_thread(void *arg)
+{
+    AVFormatContext *s = arg;
+    MOVMuxContext *mov = s->priv_data;
+    MOVFragWriter *w = mov->frag_writer;
+    MOVQueuedFragment frag;
+
+    pthread_mutex_lock(&w->lock);
+    while (!w->abort) {
+        int64_t pos = 0, latency;
+
+        if (av_fifo_peek(w->queue, &frag, 1, 0) < 0) {
+            if (w->finish)
+                break;
+            pthread_cond_wait(&w->cond, &w->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&w->lock);
+
+        /* Replay the data markers at their original position, so that
+         * custom IO callbacks and the flushing behaviour see the same
+         * stream as with synchronous writing. */
+        for (int i = 0; i < frag.nb_markers; i++) {
+            const MOVFragMarker *m = &frag.markers[i];
+            avio_write(s->pb, frag.data + pos, m->pos - pos);
+            avio_write_marker(s->pb, m->time, m->type);
+            pos = m->pos;
+        }
+        avio_write(s->pb, frag.data + pos, frag.size - pos);
+        latency = av_gettime_relative() - frag.queue_time;
+
+        pthread_mutex_lock(&w->lock);
+        av_fifo_drain2(w->queue, 1);
+        w->queued_bytes         -= frag.size;
+        mov->frag_write_queued   = w->queued_bytes;
+        mov->frag_write_latency  = FFMAX(mov->frag_write_latency, latency);
+        if (s->pb->error < 0 && !w->error)
+            w->error = s->pb->error;
+        frag_writer_free_fragment(&frag);
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    return NULL;
+}
+
+static int frag_writer_start(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    MOVFragWriter *w;
+    int ret;
+
+    w = av_mallocz(sizeof(*w));
+    if (!w)
+        return AVERROR(ENOMEM);
+    w->queue = av_fifo_alloc2(8, sizeof(MOVQueuedFragment), AV_FIFO_FLAG_AUTO_GROW);
+    if (!w->queue) {
+        av_free(w);
+        return AVERROR(ENOMEM);
+    }
+    if ((ret = pthread_mutex_init(&w->lock, NULL))) {
+        av_fifo_freep2(&w->queue);
+        av_free(w);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&w->cond, NULL))) {
+        pthread_mutex_destroy(&w->lock);
+        av_fifo_freep2(&w->queue);
+        av_free(w);
+        return AVERROR(ret);
+    }
+
+    /* From here on the writer thread owns s->pb; the fragments are
+     * built in memory, positioned at the logical end of the output. */
+    mov->frag_pos_base = avio_tell(s->pb);
+    mov->frag_writer   = w;
+    if ((ret = pthread_create(&w->thread, NULL, frag_writer_thread, s))) {
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->lock);
+        av_fifo_freep2(&w->queue);
+        av_freep(&mov->frag_writer);
+        mov->frag_pos_base = 0;
+        return AVERROR(ret);
+    }
+    ffformatcontext(s)->pb_busy = 1;
+    return 0;
+}
+
+/**
+ * Stop the writer thread and give s->pb back to the muxing thread.
+ * Unless abort is set, all queued fragments are written first.
+ */
+static int frag_writer_stop(AVFormatContext *s, int abort)
+{
+    MOVMuxContext *mov = s->priv_data;
+    MOVFragWriter *w = mov->frag_writer;
+    MOVQueuedFragment frag;
+    int ret;
+
+    if (!w)
+        return 0;
+
+    pthread_mutex_lock(&w->lock);
+    w->finish = 1;
+    w->abort  = abort;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+    ffformatcontext(s)->pb_busy = 0;
+
+    while (av_fifo_read(w->queue, &frag, 1) >= 0)
+        frag_writer_free_fragment(&frag);
+    ffio_free_dyn_buf(&w->pb);
+    frag_writer_free_fragment(&w->frag);
+    ret = w->error;
+
+    av_log(s, AV_LOG_VERBOSE, "Fragment writer: maximum latency %"PRId64" us\n",
+           mov->frag_write_latency);
+
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->lock);
+    av_fifo_freep2(&w->queue);
+    av_freep(&mov->frag_writer);
+    mov->frag_pos_base     = 0;
+    mov->frag_write_queued = 0;
+    return ret;
+}
+
+/**
+ * Wait until all the queued fragments have been written.
+ */
+static int frag_writer_drain(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    MOVFragWriter *w = mov->frag_writer;
+    int ret;
+
+    if (!w)
+        return 0;
+    pthread_mutex_lock(&w->lock);
+    while (av_fifo_can_read(w->queue) && !w->error)
+        pthread_cond_wait(&w->cond, &w->lock);
+    ret = w->error;
+    pthread_mutex_unlock(&w->lock);
+    return ret;
+}
+
+static int frag_writer_submit(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    MOVFragWriter *w = mov->frag_writer;
+    MOVQueuedFragment frag = w->frag;
+    int ret;
+
+    frag.size = avio_close_dyn_buf(w->pb, &frag.data);
+    w->pb = NULL;
+    memset(&w->frag, 0, sizeof(w->frag));
+    if (!frag.data) {
+        frag_writer_free_fragment(&frag);
+        return AVERROR(ENOMEM);
+    }
+    frag.queue_time = av_gettime_relative();
+
+    pthread_mutex_lock(&w->lock);
+    /* Block only when the byte budget is exhausted; a single fragment
+     * larger than the budget is still accepted into an empty queue. */
+    while (!w->error && w->queued_bytes &&
+           w->queued_bytes + frag.size > mov->frag_write_buffer)
+        pthread_cond_wait(&w->cond, &w->lock);
+    if (!(ret = w->error))
+        ret = av_fifo_write(w->queue, &frag, 1);
+    if (ret >= 0) {
+        w->queued_bytes       += frag.size;
+        mov->frag_write_queued = w->queued_bytes;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    if (ret < 0) {
+        frag_writer_free_fragment(&frag);
+        return ret;
+    }
+    mov->frag_pos_base += frag.size;
+    return 0;
+}
+#endif
+
+/**
+ * Get the context the next moof/mdat pair is written to: the output
+ * itself, or a memory buffer that is handed over to the writer thread.
+ */
+static int mov_frag_open_pb(AVFormatContext *s, AVIOContext **pb)
+{
+    MOVMuxContext *mov = s->priv_data;
+
+    *pb = s->pb;
+#if HAVE_THREADS
+    if (mov->frag_write_thread) {
+        int ret;
+        if (!mov->frag_writer && (ret = frag_writer_start(s)) < 0)
+            return ret;
+        if ((ret = avio_open_dyn_buf(&mov->frag_writer->pb)) < 0)
+            return ret;
+        *pb = mov->frag_writer->pb;
+    }
+#endif
+    return 0;
+}
+
+static int mov_frag_write_marker(AVFormatContext *s, AVIOContext *pb,
+                                 int64_t time, enum AVIODataMarkerType type)
+{
+#if HAVE_THREADS
+    MOVMuxContext *mov = s->priv_data;
+    MOVFragWriter *w = mov->frag_writer;
+
+    if (w && pb == w->pb) {
+        MOVFragMarker *m = av_dynarray2_add((void **)&w->frag.markers,
+                                            &w->frag.nb_markers,
+                                            sizeof(*m), NULL);
+        if (!m)
+            return AVERROR(ENOMEM);
+        m->pos  = avio_tell(pb);
+        m->time = time;
+        m->type = type;
+        return 0;
+    }
+#endif
+    avio_write_marker(pb, time, type);
+    return 0;
+}
+
+static int mov_frag_close_pb(AVFormatContext *s, AVIOContext *pb)
+{
+#if HAVE_THREADS
+    if (pb != s->pb)
+        return frag_writer_submit(s);
+#endif
+    return 0;
+}
+
 static int mov_flush_fragment(AVFormatContext *s, int force)
 {
     MOVMuxContext *mov = s->priv_data;
+    AVIOContext *pb;
     int i, first_track = -1;
     int64_t mdat_size = 0;
     int ret;
@@ -5548,9 +5836,12 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
     if (!mdat_size)
         return 0;
 
-    avio_write_marker(s->pb,
-                      av_rescale(mov->tracks[first_track].cluster[0].dts, AV_TIME_BASE, mov->tracks[first_track].timescale),
-                      (has_video ? starts_with_key : mov->tracks[first_track].cluster[0].flags & MOV_SYNC_SAMPLE) ? AVIO_DATA_MARKER_SYNC_POINT : AVIO_DATA_MARKER_BOUNDARY_POINT);
+    if ((ret = mov_frag_open_pb(s, &pb)) < 0)
+        return ret;
+
+    ret = mov_frag_write_marker(s, pb,
+                                av_rescale(mov->tracks[first_track].cluster[0].dts, AV_TIME_BASE, mov->tracks[first_track].timescale),
+                                (has_video ? starts_with_key : mov->tracks[first_track].cluster[0].flags & MOV_SYNC_SAMPLE) ? AVIO_DATA_MARKER_SYNC_POINT : AVIO_DATA_MARKER_BOUNDARY_POINT);
 
     for (i = 0; i < mov->nb_streams; i++) {
         MOVTrack *track = &mov->tracks[i];
@@ -5567,13 +5858,14 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
         }
 
         if (write_moof) {
-            avio_write_marker(s->pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_FLUSH_POINT);
+            if (ret >= 0)
+                ret = mov_frag_write_marker(s, pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_FLUSH_POINT);
 
-            mov_write_moof_tag(s->pb, mov, moof_tracks, mdat_size);
+            mov_write_moof_tag(pb, mov, moof_tracks, mdat_size);
             mov->fragments++;
 
-            avio_wb32(s->pb, mdat_size + 8);
-            ffio_wfourcc(s->pb, "mdat");
+            avio_wb32(pb, mdat_size + 8);
+            ffio_wfourcc(pb, "mdat");
         }
 
         track->entry = 0;
@@ -5591,14 +5883,24 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
             mov->mdat_buf = NULL;
         }
 
-        avio_write(s->pb, buf, buf_size);
+        avio_write(pb, buf, buf_size);
         av_free(buf);
     }
 
     mov->mdat_size = 0;
 
-    avio_write_marker(s->pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_FLUSH_POINT);
-    return 0;
+    if (ret >= 0)
+        ret = mov_frag_write_marker(s, pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_FLUSH_POINT);
+    if (ret < 0) {
+#if HAVE_THREADS
+        if (pb != s->pb) {
+            ffio_free_dyn_buf(&mov->frag_writer->pb);
+            frag_writer_free_fragment(&mov->frag_writer->frag);
+        }
+#endif
+        return ret;
+    }
+    return mov_frag_close_pb(s, pb);
 }
 
 static int mov_auto_flush_fragment(AVFormatContext *s, int force)
@@ -6113,6 +6415,15 @@ static int mov_write_packet(AVFormatContext *s, AVPacket *pkt)
 
     if (!pkt) {
         mov_flush_fragment(s, 1);
+#if HAVE_THREADS
+        /* The caller expects the fragment to be in the output when
+         * this returns, e.g. to close or switch the output. */
+        if (mov->frag_writer) {
+            int ret = frag_writer_drain(s);
+            if (ret < 0)
+                return ret;
+        }
+#endif
         return 1;
     }
 
@@ -6448,6 +6759,10 @@ static void mov_free(AVFormatContext *s)
     MOVMuxContext *mov = s->priv_data;
     int i;
 
+#if HAVE_THREADS
+    frag_writer_stop(s, 1);
+#endif
+
     if (!mov->tracks)
         return;
 
@@ -6608,6 +6923,11 @@ static int mov_init(AVFormatContext *s)
         mov->reserved_moov_size = -1;
     }
 
+    if (mov->flags & FF_MOV_FLAG_RESERVE_MOOV && mov->flags & FF_MOV_FLAG_FRAGMENT) {
+        av_log(s, AV_LOG_WARNING, "The reserve_moov flag is not supported with fragmentation, ignoring it\n");
+        mov->flags &= ~FF_MOV_FLAG_RESERVE_MOOV;
+    }
+
     if (mov->use_editlist < 0) {
         mov->use_editlist = 1;
         if (mov->flags & FF_MOV_FLAG_FRAGMENT &&
@@ -6651,6 +6971,27 @@ static int mov_init(AVFormatContext *s)
         return AVERROR(EINVAL);
     }
 
+    if (mov->frag_write_thread) {
+        if (!HAVE_THREADS) {
+            av_log(s, AV_LOG_WARNING, "Fragment writer thread not supported "
+                   "without threads, writing synchronously\n");
+            mov->frag_write_thread = 0;
+        } else if (!(mov->flags & FF_MOV_FLAG_FRAGMENT) || mov->ism_lookahead) {
+            av_log(s, AV_LOG_WARNING, "The fragment writer thread requires "
+                   "fragmented output without ism_lookahead, ignoring\n");
+            mov->frag_write_thread = 0;
+        } else if (s->flush_packets == 1 || s->flags & AVFMT_FLAG_FLUSH_PACKETS) {
+            av_log(s, AV_LOG_WARNING, "Flushing after every packet is not "
+                   "possible with the fragment writer thread, writing "
+                   "synchronously\n");
+            mov->frag_write_thread = 0;
+        } else if (s->flush_packets < 0) {
+            /* The output is only accessed by the writer thread while it
+             * runs; it replays the flush points of every fragment. */
+            s->flush_packets = 0;
+        }
+    }
+
     /* Non-seekable output is ok if using fragmentation. If ism_lookahead
      * is enabled, we don't support non-seekable output at all. */
     if (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL) &&
@@ -6926,6 +7267,71 @@ static int mov_init(AVFormatContext *s)
     return 0;
 }
 
+/*
+ * Estimate the size of the moov atom once the expected duration has been
+ * written, assuming one chunk per sample and the worst case for the tables
+ * which can be compacted.
+ */
+static int64_t estimate_moov_size(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    const AVDictionaryEntry *t = NULL;
+    int64_t duration = mov->expected_duration;
+    int64_t size = 4096, data_size = 0;
+    int chunk_entry_size;
+
+    if (duration <= 0) {
+        for (int i = 0; i < s->nb_streams; i++) {
+            AVStream *st = s->streams[i];
+            if (st->duration > 0)
+                duration = FFMAX(duration, av_rescale_q(st->duration, st->time_base,
+                                                        AV_TIME_BASE_Q));
+        }
+    }
+    if (duration <= 0)
+        return 0;
+
+    for (int i = 0; i < mov->nb_streams; i++) {
+        int64_t bit_rate = mov->tracks[i].par->bit_rate;
+        data_size = bit_rate > 0 && data_size >= 0 ?
+                    data_size + av_rescale(bit_rate, duration, 8 * AV_TIME_BASE) : -1;
+    }
+    /* stsc entry and stco or co64 entry */
+    chunk_entry_size = 12 + (data_size >= 0 && data_size < UINT32_MAX ? 4 : 8);
+
+    while ((t = av_dict_get(s->metadata, "", t, AV_DICT_IGNORE_SUFFIX)))
+        size += strlen(t->key) + strlen(t->value) + 32;
+    size += s->nb_chapters * 64;
+
+    for (int i = 0; i < mov->nb_streams; i++) {
+        MOVTrack *track = &mov->tracks[i];
+        AVCodecParameters *par = track->par;
+        const AVCodecDescriptor *desc = avcodec_descriptor_get(par->codec_id);
+        int entry_size = 4 + chunk_entry_size; /* stsz */
+        AVRational rate = { 1, 1 };
+
+        size += 1024 + par->extradata_size;
+        if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+            if (track->st && track->st->avg_frame_rate.num > 0 && track->st->avg_frame_rate.den > 0)
+                rate = track->st->avg_frame_rate;
+            else if (track->st && track->st->time_base.num > 0 &&
+                     track->st->time_base.den <= 1000 * track->st->time_base.num)
+                rate = av_inv_q(track->st->time_base);
+            else
+                rate = (AVRational){ 60, 1 };
+            if (!desc || !(desc->props & AV_CODEC_PROP_INTRA_ONLY))
+                entry_size += 4 + 8; /* stss, ctts */
+        } else if (par->codec_type == AVMEDIA_TYPE_AUDIO && par->sample_rate > 0) {
+            rate = par->frame_size > 0 ? (AVRational){ par->sample_rate, par->frame_size } :
+                                         (AVRational){ 50, 1 };
+        }
+        size += (av_rescale(duration, rate.num, (int64_t)rate.den * AV_TIME_BASE) + 1) * entry_size;
+    }
+
+    /* margin for samples beyond the expected duration */
+    return FFMIN(size + size / 16, INT_MAX);
+}
+
 static int mov_write_header(AVFormatContext *s)
 {
     AVIOContext *pb = s->pb;
@@ -6990,6 +7396,18 @@ static int mov_write_header(AVFormatContext *s)
             return ret;
     }
 
+    if (mov->flags & FF_MOV_FLAG_RESERVE_MOOV && mov->reserved_moov_size <= 0) {
+        int64_t size = estimate_moov_size(s);
+        if (size > 0) {
+            av_log(s, AV_LOG_VERBOSE, "Reserving %"PRId64" bytes for the moov atom\n", size);
+            mov->reserved_moov_size = size;
+        } else {
+            av_log(s, AV_LOG_WARNING, "Unknown output duration, cannot reserve space for "
+                   "the moov atom, it will be moved to the beginning in a second pass\n");
+            mov->reserved_moov_size = -1;
+        }
+    }
+
     if (mov->reserved_moov_size){
         mov->reserved_header_pos = avio_tell(pb);
         if (mov->reserved_moov_size > 0)
@@ -7004,7 +7422,7 @@ static int mov_write_header(AVFormatContext *s)
             !mov->max_fragment_duration && !mov->max_fragment_size)
             mov->flags |= FF_MOV_FLAG_FRAG_KEYFRAME;
     } else {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->reserved_moov_size < 0)
             mov->reserved_header_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
@@ -7153,6 +7571,79 @@ static int shift_data(AVFormatContext *s)
     return ff_format_shift_data(s, mov->reserved_header_pos, moov_size);
 }
 
+/*
+ * Insert the space missing for the moov atom and a free atom after it at the
+ * beginning of the output, without moving the data when the output supports
+ * it.
+ * @return the size of the inserted space, 0 if nothing was inserted
+ */
+static int insert_moov_space(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    int reserved = FFMAX(mov->reserved_moov_size, 0);
+    int64_t margin, size;
+    int moov_size;
+
+    moov_size = get_moov_size(s);
+    if (moov_size < 0 || moov_size + 8 <= reserved)
+        return FFMIN(moov_size, 0);
+
+    /* the chunk offsets may switch to co64 once the data is moved */
+    margin = moov_size + 8 - reserved + (1 << 16);
+    for (int i = 0; i < mov->nb_streams; i++)
+        mov->tracks[i].data_offset += margin;
+    moov_size = get_moov_size(s);
+    for (int i = 0; i < mov->nb_streams; i++)
+        mov->tracks[i].data_offset -= margin;
+    if (moov_size < 0)
+        return moov_size;
+
+    /* the reserved size has to fit in an int once the space is inserted */
+    size = ff_format_insert_space(s, mov->reserved_header_pos + reserved,
+                                  moov_size + 8 - reserved, INT_MAX - reserved);
+    if (size == AVERROR(ENOSYS)) {
+        av_log(s, AV_LOG_VERBOSE, "Cannot insert space in the output, moving the data\n");
+        return 0;
+    }
+    if (size < 0)
+        return size;
+
+    for (int i = 0; i < mov->nb_streams; i++)
+        mov->tracks[i].data_offset += size;
+    return size;
+}
+
+/*
+ * Enlarge the space reserved for the moov atom when it turns out too small,
+ * keeping room for a free atom after it.
+ */
+static int shift_reserved_data(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    int moov_size, moov_size2, shift;
+
+    moov_size = get_moov_size(s);
+    if (moov_size < 0)
+        return moov_size;
+    shift = moov_size + 8 - mov->reserved_moov_size;
+    for (int i = 0; i < mov->nb_streams; i++)
+        mov->tracks[i].data_offset += shift;
+
+    /* the chunk offsets may have switched from stco to co64 */
+    moov_size2 = get_moov_size(s);
+    if (moov_size2 < 0)
+        return moov_size2;
+    if (moov_size2 != moov_size) {
+        for (int i = 0; i < mov->nb_streams; i++)
+            mov->tracks[i].data_offset += moov_size2 - moov_size;
+        shift += moov_size2 - moov_size;
+    }
+
+    mov->reserved_moov_size += shift;
+    return ff_format_shift_data(s, mov->reserved_header_pos + mov->reserved_moov_size - shift,
+                                shift);
+}
+
 static int mov_write_trailer(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -7161,6 +7652,19 @@ static int mov_write_trailer(AVFormatContext *s)
     int i;
     int64_t moov_pos;
 
+#if HAVE_THREADS
+    /* The generic code leaves the trailer marker to us while the writer
+     * thread owns the output: it must follow the queued fragments. The
+     * rest of the trailer is written synchronously. */
+    if (mov->frag_writer) {
+        res = frag_writer_stop(s, 0);
+        mov->frag_write_thread = 0;
+        avio_write_marker(pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_TRAILER);
+        if (res < 0)
+            return res;
+    }
+#endif
+
     if (mov->need_rewrite_extradata) {
         for (i = 0; i < s->nb_streams; i++) {
             MOVTrack *track = &mov->tracks[i];
@@ -7224,7 +7728,37 @@ static int mov_write_trailer(AVFormatContext *s)
         }
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
-        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+        if (mov->flags & FF_MOV_FLAG_INSERT_MOOV && mov->reserved_moov_size) {
+            res = insert_moov_space(s);
+            if (res < 0)
+                return res;
+            if (res > 0) {
+                av_log(s, AV_LOG_VERBOSE, "Inserted %d bytes for the moov atom\n", res);
+                moov_pos += res;
+                mov->reserved_moov_size = FFMAX(mov->reserved_moov_size, 0) + res;
+                avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
+            }
+        }
+
+        if (mov->flags & (FF_MOV_FLAG_RESERVE_MOOV | FF_MOV_FLAG_INSERT_MOOV) &&
+            mov->reserved_moov_size > 0) {
+            int moov_size = get_moov_size(s);
+            if (moov_size < 0)
+                return moov_size;
+            if (moov_size + 8 > mov->reserved_moov_size) {
+                av_log(s, AV_LOG_INFO, "Reserved moov space too small by %d bytes, "
+                       "starting second pass: moving the data\n",
+                       moov_size + 8 - mov->reserved_moov_size);
+                avio_seek(pb, moov_pos, SEEK_SET);
+                res = shift_reserved_data(s);
+                if (res < 0)
+                    return res;
+                moov_pos = avio_tell(pb);
+                avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
+            }
+        }
+
+        if (mov->reserved_moov_size < 0) {
             av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
             res = shift_data(s);
             if (res < 0)
@@ -213,6 +213,7 @@ typedef struct MOVMuxContext {
 
     int reserved_moov_size; ///< 0 for disabled, -1 for automatic, size otherwise
     int64_t reserved_header_pos;
+    int64_t expected_duration; ///< used to estimate the reserved moov size with FF_MOV_FLAG_RESERVE_MOOV
 
     char *major_brand;
 
@@ -242,6 +243,13 @@ typedef struct MOVMuxContext {
     MOVPrftBox write_prft;
     int empty_hdlr_name;
     int movie_timescale;
+
+    int frag_write_thread;
+    int frag_write_buffer;     ///< maximum number of bytes queued for the writer thread
+    int64_t frag_write_queued; ///< exported number of bytes waiting to be written
+    int64_t frag_write_latency; ///< exported maximum fragment write latency, in microseconds
+    int64_t frag_pos_base;     ///< output position of the fragment being built
+    struct MOVFragWriter *frag_writer;
 } MOVMuxContext;
 
 #define FF_MOV_FLAG_RTP_HINT              (1 <<  0)
@@ -268,6 +276,8 @@ typedef struct MOVMuxContext {
 #define FF_MOV_FLAG_SKIP_SIDX             (1 << 21)
 #define FF_MOV_FLAG_CMAF                  (1 << 22)
 #define FF_MOV_FLAG_PREFER_ICC            (1 << 23)
+#define FF_MOV_FLAG_RESERVE_MOOV          (1 << 24)
+#define FF_MOV_FLAG_INSERT_MOOV           (1 << 25)
 
 int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt);
 
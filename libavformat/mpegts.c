@@ -162,6 +162,14 @@ struct MpegTSContext {
     int merge_pmt_versions;
     int max_packet_size;
 
+    /** lists of the only programs and PIDs to demux, set by the user */
+    char *programs;
+    char *pids_list;
+    int *selected_programs;
+    int nb_selected_programs;
+    /** bitmap of the selected PIDs, NULL if all are */
+    uint8_t *selected_pids;
+
     /******************************************/
     /* private mpegts data */
     /* scan context */
@@ -199,6 +207,10 @@ static const AVOption options[] = {
      {.i64 = 0}, 0, 1, 0 },
     {"max_packet_size", "maximum size of emitted packet", offsetof(MpegTSContext, max_packet_size), AV_OPT_TYPE_INT,
      {.i64 = 204800}, 1, INT_MAX/2, AV_OPT_FLAG_DECODING_PARAM },
+    {"programs", "only demux the programs with these numbers, separated by commas", offsetof(MpegTSContext, programs), AV_OPT_TYPE_STRING,
+     {.str = NULL}, 0, 0, AV_OPT_FLAG_DECODING_PARAM },
+    {"pids", "only demux the elementary streams with these PIDs, separated by commas", offsetof(MpegTSContext, pids_list), AV_OPT_TYPE_STRING,
+     {.str = NULL}, 0, 0, AV_OPT_FLAG_DECODING_PARAM },
     { NULL },
 };
 
@@ -409,6 +421,31 @@ static int discard_pid(MpegTSContext *ts, unsigned int pid)
     return !used && discarded;
 }
 
+static int program_selected(MpegTSContext *ts, int program_num)
+{
+    int i;
+
+    if (!ts->nb_selected_programs)
+        return 1;
+    for (i = 0; i < ts->nb_selected_programs; i++)
+        if (ts->selected_programs[i] == program_num)
+            return 1;
+    return 0;
+}
+
+static int pid_selected(MpegTSContext *ts, unsigned int pid)
+{
+    return !ts->selected_pids || ts->selected_pids[pid >> 3] & (1 << (pid & 7));
+}
+
+/**
+ * @return 1 if a stream may be created for a PID not announced in any PMT
+ */
+static int guess_pid(MpegTSContext *ts, unsigned int pid)
+{
+    return ts->auto_guess && !ts->nb_selected_programs && pid_selected(ts, pid);
+}
+
 /**
  *  Assemble PES packets out of TS packets, and then call the "section_cb"
  *  function when they are complete.
@@ -577,24 +614,26 @@ static int analyze(const uint8_t *buf, int size, int packet_size,
 {
     int stat[TS_MAX_PACKET_SIZE];
     int stat_all = 0;
-    int i;
     int best_score = 0;
+    const uint8_t *p = buf, *end = buf + size - 3;
 
     memset(stat, 0, packet_size * sizeof(*stat));
 
-    for (i = 0; i < size - 3; i++) {
-        if (buf[i] == 0x47) {
-            int pid = AV_RB16(buf+1) & 0x1FFF;
-            int asc = buf[i + 3] & 0x30;
-            if (!probe || pid == 0x1FFF || asc) {
-                int x = i % packet_size;
-                stat[x]++;
-                stat_all++;
-                if (stat[x] > best_score) {
-                    best_score = stat[x];
-                }
+    /* jump from one sync byte candidate to the next with memchr(), which
+     * is vectorized in most C libraries */
+    while (p < end && (p = memchr(p, 0x47, end - p))) {
+        int i   = p - buf;
+        int pid = AV_RB16(buf+1) & 0x1FFF;
+        int asc = buf[i + 3] & 0x30;
+        if (!probe || pid == 0x1FFF || asc) {
+            int x = i % packet_size;
+            stat[x]++;
+            stat_all++;
+            if (stat[x] > best_score) {
+                best_score = stat[x];
             }
         }
+        p++;
     }
 
     return best_score - FFMAX(stat_all - 10*best_score, 0)/10;
@@ -2347,6 +2386,8 @@ static void pmt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
 
     if (ts->skip_unknown_pmt && !prg)
         return;
+    if (!program_selected(ts, h->id))
+        return;
     if (prg && prg->nb_pids && prg->pids[0] != ts->current_pid)
         return;
     if (!ts->skip_clear)
@@ -2402,7 +2443,7 @@ static void pmt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
     if (prg)
         prg->pmt_found = 1;
 
-    for (i = 0; i < MAX_STREAMS_PER_PROGRAM; i++) {
+    for (i = 0; i < MAX_STREAMS_PER_PROGRAM;) {
         st = 0;
         pes = NULL;
         stream_type = get8(&p, p_end);
@@ -2415,6 +2456,14 @@ static void pmt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
         if (pid == ts->current_pid)
             goto out;
 
+        if (!pid_selected(ts, pid)) {
+            desc_list_len = get16(&p, p_end);
+            if (desc_list_len < 0)
+                goto out;
+            p += desc_list_len & 0xfff;
+            continue;
+        }
+
         stream_identifier = parse_stream_identifier_desc(p, p_end) + 1;
 
         /* now create stream */
@@ -2510,6 +2559,7 @@ static void pmt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
             }
         }
         p = desc_list_end;
+        i++;
     }
 
     if (!ts->pids[pcr_pid])
@@ -2562,7 +2612,7 @@ static void pat_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
 
         if (sid == 0x0000) {
             /* NIT info */
-        } else {
+        } else if (program_selected(ts, sid)) {
             MpegTSFilter *fil = ts->pids[pmt_pid];
             struct Program *prg;
             program = av_new_program(ts->stream, sid);
@@ -2723,7 +2773,7 @@ static void sdt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
                 if (!provider_name)
                     break;
                 name = getstr8(&p, p_end);
-                if (name) {
+                if (name && program_selected(ts, sid)) {
                     AVProgram *program = av_new_program(ts->stream, sid);
                     if (program) {
                         av_dict_set(&program->metadata, "service_name", name, 0);
@@ -2757,7 +2807,7 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet, int64_t pos)
     pid = AV_RB16(packet + 1) & 0x1fff;
     is_start = packet[1] & 0x40;
     tss = ts->pids[pid];
-    if (ts->auto_guess && !tss && is_start) {
+    if (!tss && is_start && guess_pid(ts, pid)) {
         add_pes_stream(ts, pid, -1);
         tss = ts->pids[pid];
     }
@@ -2889,7 +2939,7 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
 {
     MpegTSContext *ts = s->priv_data;
     AVIOContext *pb = s->pb;
-    int c, i;
+    int i;
     uint64_t pos = avio_tell(pb);
     int64_t back = FFMIN(seekback, pos);
 
@@ -2901,25 +2951,39 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
 
     avio_seek(pb, -back, SEEK_CUR);
 
-    for (i = 0; i < ts->resync_size; i++) {
-        c = avio_r8(pb);
-        if (avio_feof(pb))
-            return AVERROR_EOF;
-        if (c == 0x47) {
-            int new_packet_size, ret;
+    for (i = 0; i < ts->resync_size;) {
+        int new_packet_size, ret;
+        const uint8_t *sync;
+        int left = FFMIN(pb->buf_end - pb->buf_ptr, ts->resync_size - i);
+
+        if (left <= 0) {
+            /* refill the buffer */
+            avio_r8(pb);
+            if (avio_feof(pb))
+                return AVERROR_EOF;
             avio_seek(pb, -1, SEEK_CUR);
-            pos = avio_tell(pb);
-            ret = ffio_ensure_seekback(pb, PROBE_PACKET_MAX_BUF);
-            if (ret < 0)
-                return ret;
-            new_packet_size = get_packet_size(s);
-            if (new_packet_size > 0 && new_packet_size != ts->raw_packet_size) {
-                av_log(ts->stream, AV_LOG_WARNING, "changing packet size to %d\n", new_packet_size);
-                ts->raw_packet_size = new_packet_size;
-            }
-            avio_seek(pb, pos, SEEK_SET);
-            return 0;
+            continue;
+        }
+        /* look for the sync byte in all the buffered data at once */
+        sync = memchr(pb->buf_ptr, 0x47, left);
+        if (!sync) {
+            avio_skip(pb, left);
+            i += left;
+            continue;
+        }
+        avio_skip(pb, sync - pb->buf_ptr);
+
+        pos = avio_tell(pb);
+        ret = ffio_ensure_seekback(pb, PROBE_PACKET_MAX_BUF);
+        if (ret < 0)
+            return ret;
+        new_packet_size = get_packet_size(s);
+        if (new_packet_size > 0 && new_packet_size != ts->raw_packet_size) {
+            av_log(ts->stream, AV_LOG_WARNING, "changing packet size to %d\n", new_packet_size);
+            ts->raw_packet_size = new_packet_size;
         }
+        avio_seek(pb, pos, SEEK_SET);
+        return 0;
     }
     av_log(s, AV_LOG_ERROR,
            "max resync size reached, could not find sync byte\n");
@@ -2961,13 +3025,44 @@ static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
         avio_skip(pb, skip);
 }
 
+/**
+ * Classify the packets which are already in the I/O buffer by PID and skip
+ * the leading ones which handle_packet() would ignore anyway, i.e. those
+ * of PIDs without a filter or with a discarded filter, without reading
+ * them one by one.
+ *
+ * @return the number of packets skipped, at most max_packets
+ */
+static int skip_unused_packets(MpegTSContext *ts, int64_t max_packets)
+{
+    AVIOContext *pb = ts->stream->pb;
+    int raw_packet_size = ts->raw_packet_size;
+    const uint8_t *p = pb->buf_ptr;
+    int n = FFMIN((pb->buf_end - p) / raw_packet_size, max_packets);
+    int i;
+
+    for (i = 0; i < n; i++, p += raw_packet_size) {
+        int pid = AV_RB16(p + 1) & 0x1fff;
+        int is_start = p[1] & 0x40;
+        MpegTSFilter *tss = ts->pids[pid];
+
+        if (p[0] != 0x47)
+            break;
+        if (tss ? !tss->discard || is_start : is_start && guess_pid(ts, pid))
+            break;
+    }
+    if (i)
+        avio_skip(pb, i * raw_packet_size);
+    return i;
+}
+
 static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
 {
     AVFormatContext *s = ts->stream;
     uint8_t packet[TS_PACKET_SIZE + AV_INPUT_BUFFER_PADDING_SIZE];
     const uint8_t *data;
     int64_t packet_num;
-    int ret = 0;
+    int ret = 0, skipped;
 
     if (avio_tell(s->pb) != ts->last_pos) {
         int i;
@@ -3002,6 +3097,12 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
+        skipped = skip_unused_packets(ts, nb_packets ? nb_packets - packet_num : INT64_MAX);
+        if (skipped > 0) {
+            packet_num += skipped - 1;
+            continue;
+        }
+
         ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
@@ -3092,6 +3193,59 @@ static void seek_back(AVFormatContext *s, AVIOContext *pb, int64_t pos) {
         av_log(s, (pb->seekable & AVIO_SEEKABLE_NORMAL) ? AV_LOG_ERROR : AV_LOG_INFO, "Unable to seek back to the start\n");
 }
 
+/**
+ * Parse a comma separated list of numbers between 0 and max, in decimal
+ * or hexadecimal with a 0x prefix.
+ */
+static int parse_id_list(AVFormatContext *s, const char *name, const char *str,
+                         int max, int **ids, int *nb_ids)
+{
+    while (*str) {
+        char *end;
+        /* decimal unless 0x prefixed, a leading 0 does not mean octal */
+        int hex = str[0] == '0' && (str[1] == 'x' || str[1] == 'X');
+        long id = strtol(str, &end, hex ? 16 : 10);
+        int ret;
+
+        if (end == str || id < 0 || id > max || (*end && *end != ',')) {
+            av_log(s, AV_LOG_ERROR, "Invalid %s list '%s'\n", name, str);
+            return AVERROR(EINVAL);
+        }
+        if ((ret = av_reallocp_array(ids, *nb_ids + 1, sizeof(**ids))) < 0) {
+            *nb_ids = 0;
+            return ret;
+        }
+        (*ids)[(*nb_ids)++] = id;
+        str = *end ? end + 1 : end;
+    }
+    return 0;
+}
+
+static int parse_selection(AVFormatContext *s)
+{
+    MpegTSContext *ts = s->priv_data;
+    int ret;
+
+    if (ts->programs &&
+        (ret = parse_id_list(s, "program", ts->programs, 0xffff,
+                             &ts->selected_programs, &ts->nb_selected_programs)) < 0)
+        return ret;
+
+    if (ts->pids_list) {
+        int *pids = NULL, nb_pids = 0;
+
+        ret = parse_id_list(s, "PID", ts->pids_list, NB_PID_MAX - 1, &pids, &nb_pids);
+        if (ret >= 0 && !(ts->selected_pids = av_mallocz(NB_PID_MAX / 8)))
+            ret = AVERROR(ENOMEM);
+        for (int i = 0; ret >= 0 && i < nb_pids; i++)
+            ts->selected_pids[pids[i] >> 3] |= 1 << (pids[i] & 7);
+        av_free(pids);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
 static int mpegts_read_header(AVFormatContext *s)
 {
     MpegTSContext *ts = s->priv_data;
@@ -3115,6 +3269,12 @@ static int mpegts_read_header(AVFormatContext *s)
 
     if (s->iformat == &ff_mpegts_demuxer) {
         /* normal demux */
+        int ret = parse_selection(s);
+        if (ret < 0) {
+            av_freep(&ts->selected_programs);
+            av_freep(&ts->selected_pids);
+            return ret;
+        }
 
         /* first do a scan to get all the services */
         seek_back(s, pb, pos);
@@ -3284,6 +3444,9 @@ static void mpegts_free(MpegTSContext *ts)
     for (i = 0; i < NB_PID_MAX; i++)
         if (ts->pids[i])
             mpegts_close_filter(ts, ts->pids[i]);
+
+    av_freep(&ts->selected_programs);
+    av_freep(&ts->selected_pids);
 }
 
 static int mpegts_read_close(AVFormatContext *s)
@@ -436,7 +436,7 @@ static int init_pts(AVFormatContext *s)
 
 static void flush_if_needed(AVFormatContext *s)
 {
-    if (s->pb && s->pb->error >= 0) {
+    if (s->pb && !ffformatcontext(s)->pb_busy && s->pb->error >= 0) {
         if (s->flush_packets == 1 || s->flags & AVFMT_FLAG_FLUSH_PACKETS)
             avio_flush(s->pb);
         else if (s->flush_packets && !(s->oformat->flags & AVFMT_NOFILE))
@@ -489,13 +489,13 @@ int avformat_write_header(AVFormatContext *s, AVDictionary **options)
         avio_write_marker(s->pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_HEADER);
     if (s->oformat->write_header) {
         ret = s->oformat->write_header(s);
-        if (ret >= 0 && s->pb && s->pb->error < 0)
+        if (ret >= 0 && s->pb && !si->pb_busy && s->pb->error < 0)
             ret = s->pb->error;
         if (ret < 0)
             goto fail;
         flush_if_needed(s);
     }
-    if (!(s->oformat->flags & AVFMT_NOFILE) && s->pb)
+    if (!(s->oformat->flags & AVFMT_NOFILE) && s->pb && !si->pb_busy)
         avio_write_marker(s->pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_UNKNOWN);
 
     if (!si->streams_initialized) {
@@ -753,7 +753,7 @@ static int write_packet(AVFormatContext *s, AVPacket *pkt)
         ret = s->oformat->write_packet(s, pkt);
     }
 
-    if (s->pb && ret >= 0) {
+    if (s->pb && !si->pb_busy && ret >= 0) {
         flush_if_needed(s);
         if (s->pb->error < 0)
             ret = s->pb->error;
@@ -839,6 +839,128 @@ static int prepare_input_packet(AVFormatContext *s, AVStream *st, AVPacket *pkt)
 
 #define CHUNK_START 0x1000
 
+/**
+ * Entry of packet_buffer when it is indexed by a skip list: a plain
+ * PacketListEntry (whose next pointer is level 0) followed by the links of
+ * the higher levels the entry belongs to.
+ */
+typedef struct InterleaveListEntry {
+    PacketListEntry entry; ///< must be first, entries are freed as PacketListEntry
+    PacketListEntry *skip[];
+} InterleaveListEntry;
+
+/**
+ * The skip list is only maintained with the default interleaver, as other
+ * interleavers remove packets from packet_buffer by themselves.
+ * Chunked interleaving does not keep the queue sorted.
+ */
+static int interleave_use_skip_list(AVFormatContext *s)
+{
+    return ffformatcontext(s)->interleave_packet == ff_interleave_packet_per_dts &&
+           !s->max_chunk_size && !s->max_chunk_duration;
+}
+
+static PacketListEntry **skip_link(FFFormatContext *si, PacketListEntry *pktl, int level)
+{
+    if (!pktl)
+        return level ? &si->interleave_skip_head[level] : &si->packet_buffer.head;
+    return level ? &((InterleaveListEntry *)pktl)->skip[level - 1] : &pktl->next;
+}
+
+/**
+ * Must be called before removing the head of packet_buffer while the skip
+ * list is in use.
+ */
+static void skip_list_remove_head(FFFormatContext *si)
+{
+    PacketListEntry *pktl = si->packet_buffer.head;
+
+    for (int i = 1; i < si->interleave_levels && si->interleave_skip_head[i] == pktl; i++) {
+        si->interleave_skip_head[i] = ((InterleaveListEntry *)pktl)->skip[i - 1];
+        if (si->interleave_skip_tail[i] == pktl)
+            si->interleave_skip_tail[i] = NULL;
+    }
+}
+
+/**
+ * Insert pkt into the sorted packet_buffer, at the same position as the
+ * linear search done by ff_interleave_add_packet() would, i.e. after all
+ * packets that do not compare greater than it.
+ */
+static int skip_list_add_packet(AVFormatContext *s, AVPacket *pkt,
+                                int (*compare)(AVFormatContext *, const AVPacket *, const AVPacket *))
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    FFStream *const sti = ffstream(s->streams[pkt->stream_index]);
+    PacketListEntry *update[MAX_INTERLEAVE_LEVELS], *this_pktl;
+    int levels = 1, ret;
+
+    if (!si->packet_buffer.head) {
+        memset(si->interleave_skip_head, 0, sizeof(si->interleave_skip_head));
+        memset(si->interleave_skip_tail, 0, sizeof(si->interleave_skip_tail));
+        si->interleave_levels = 1;
+    }
+
+    // geometric distribution with p = 1/4, deterministic for reproducibility
+    while (levels < MAX_INTERLEAVE_LEVELS) {
+        si->interleave_seed = si->interleave_seed * 1664525 + 1013904223;
+        if (si->interleave_seed >> 30)
+            break;
+        levels++;
+    }
+
+    this_pktl = av_malloc(offsetof(InterleaveListEntry, skip) +
+                          (levels - 1) * sizeof(PacketListEntry *));
+    if (!this_pktl) {
+        av_packet_unref(pkt);
+        return AVERROR(ENOMEM);
+    }
+    if ((ret = av_packet_make_refcounted(pkt)) < 0) {
+        av_free(this_pktl);
+        av_packet_unref(pkt);
+        return ret;
+    }
+    av_packet_move_ref(&this_pktl->pkt, pkt);
+    pkt = &this_pktl->pkt;
+
+    for (int i = si->interleave_levels; i < levels; i++) {
+        si->interleave_skip_head[i] = NULL;
+        si->interleave_skip_tail[i] = NULL;
+    }
+    si->interleave_levels = FFMAX(si->interleave_levels, levels);
+
+    if (!si->packet_buffer.tail || !compare(s, &si->packet_buffer.tail->pkt, pkt)) {
+        update[0] = si->packet_buffer.tail;
+        for (int i = 1; i < levels; i++)
+            update[i] = si->interleave_skip_tail[i];
+    } else {
+        PacketListEntry *cur = NULL, *next;
+
+        for (int i = si->interleave_levels - 1; i >= 0; i--) {
+            while ((next = *skip_link(si, cur, i)) && !compare(s, &next->pkt, pkt))
+                cur = next;
+            if (i < levels)
+                update[i] = cur;
+        }
+    }
+
+    for (int i = 0; i < levels; i++) {
+        PacketListEntry **link = skip_link(si, update[i], i);
+
+        *skip_link(si, this_pktl, i) = *link;
+        *link = this_pktl;
+        if (!*skip_link(si, this_pktl, i)) {
+            if (i)
+                si->interleave_skip_tail[i] = this_pktl;
+            else
+                si->packet_buffer.tail = this_pktl;
+        }
+    }
+    sti->last_in_packet_buffer = this_pktl;
+
+    return 0;
+}
+
 int ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
                              int (*compare)(AVFormatContext *, const AVPacket *, const AVPacket *))
 {
@@ -953,7 +1075,11 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *pkt,
     int eof = flush;
 
     if (has_packet) {
-        if ((ret = ff_interleave_add_packet(s, pkt, interleave_compare_dts)) < 0)
+        if (interleave_use_skip_list(s))
+            ret = skip_list_add_packet(s, pkt, interleave_compare_dts);
+        else
+            ret = ff_interleave_add_packet(s, pkt, interleave_compare_dts);
+        if (ret < 0)
             return ret;
     }
 
@@ -1031,6 +1157,7 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *pkt,
             if (si->shortest_end + 1 >= top_dts)
                 break;
 
+            skip_list_remove_head(si);
             si->packet_buffer.head = pktl->next;
             if (!si->packet_buffer.head)
                 si->packet_buffer.tail = NULL;
@@ -1051,6 +1178,7 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *pkt,
 
         if (sti->last_in_packet_buffer == pktl)
             sti->last_in_packet_buffer = NULL;
+        skip_list_remove_head(si);
         avpriv_packet_list_get(&si->packet_buffer, pkt);
 
         return 1;
@@ -1223,7 +1351,7 @@ int av_write_frame(AVFormatContext *s, AVPacket *in)
         if (s->oformat->flags & AVFMT_ALLOW_FLUSH) {
             ret = s->oformat->write_packet(s, NULL);
             flush_if_needed(s);
-            if (ret >= 0 && s->pb && s->pb->error < 0)
+            if (ret >= 0 && s->pb && !si->pb_busy && s->pb->error < 0)
                 ret = s->pb->error;
             return ret;
         }
@@ -1297,7 +1425,7 @@ int av_write_trailer(AVFormatContext *s)
         ret = ret1;
 
     if (s->oformat->write_trailer) {
-        if (!(s->oformat->flags & AVFMT_NOFILE) && s->pb)
+        if (!(s->oformat->flags & AVFMT_NOFILE) && s->pb && !si->pb_busy)
             avio_write_marker(s->pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_TRAILER);
         if (ret >= 0) {
         ret = s->oformat->write_trailer(s);
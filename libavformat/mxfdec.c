@@ -44,7 +44,10 @@
  * Only tracks with associated descriptors will be decoded. "Highly Desirable" SMPTE 377M D.1
  */
 
+#include "config.h"
+
 #include <inttypes.h>
+#include <stdatomic.h>
 
 #include "libavutil/aes.h"
 #include "libavutil/avstring.h"
@@ -57,7 +60,9 @@
 #include "libavutil/parseutils.h"
 #include "libavutil/timecode.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 #include "avformat.h"
+#include "avio_internal.h"
 #include "avlanguage.h"
 #include "internal.h"
 #include "mxf.h"
@@ -284,6 +289,22 @@ typedef struct MXFIndexTable {
     int8_t *offsets;            /* temporal offsets for display order to stored order conversion */
 } MXFIndexTable;
 
+#if HAVE_THREADS
+typedef struct MXFPrefetchEntry {
+    int64_t pos;
+    uint8_t *data;
+    int size;
+    int done;
+} MXFPrefetchEntry;
+
+typedef struct MXFPrefetchWorker {
+    struct MXFContext *mxf;
+    AVIOContext *pb;
+    pthread_t thread;
+    int started;
+} MXFPrefetchWorker;
+#endif
+
 typedef struct MXFContext {
     const AVClass *class;     /**< Class for private options. */
     MXFPartition *partitions;
@@ -309,6 +330,23 @@ typedef struct MXFContext {
     int nb_index_tables;
     MXFIndexTable *index_tables;
     int eia608_extract;
+    int partition_threads;
+    int64_t *rip_offsets;       /* partition offsets from the RandomIndexPack */
+    int nb_rip_offsets;
+#if HAVE_THREADS
+    /* partitions read ahead by worker threads while parsing the header */
+    MXFPrefetchEntry *prefetch;
+    int nb_prefetch;
+    int prefetch_next;
+    MXFPrefetchWorker *prefetch_workers;
+    int nb_prefetch_workers;
+    pthread_mutex_t prefetch_lock;
+    pthread_cond_t prefetch_cond;
+    atomic_int prefetch_stop;
+    AVIOContext *prefetch_pb;   /* serves reads from the prefetched partitions */
+    AVIOContext *prefetch_orig_pb;
+    int64_t prefetch_pos;
+#endif
 } MXFContext;
 
 /* NOTE: klv_offset is not set (-1) for local keys */
@@ -3626,8 +3664,22 @@ static void mxf_read_random_index_pack(AVFormatContext *s)
         goto end;
     }
 
-    avio_skip(s->pb, klv.length - 12);
-    mxf->footer_partition = avio_rb64(s->pb);
+    if (mxf->partition_threads > 0) {
+        int nb_entries = (klv.length - 4) / 12;
+        av_freep(&mxf->rip_offsets);
+        mxf->nb_rip_offsets = 0;
+        if (!(mxf->rip_offsets = av_malloc_array(nb_entries, sizeof(*mxf->rip_offsets))))
+            goto end;
+        for (int i = 0; i < nb_entries; i++) {
+            avio_skip(s->pb, 4); /* BodySID */
+            mxf->rip_offsets[i] = avio_rb64(s->pb);
+        }
+        mxf->nb_rip_offsets = nb_entries;
+        mxf->footer_partition = mxf->rip_offsets[nb_entries - 1];
+    } else {
+        avio_skip(s->pb, klv.length - 12);
+        mxf->footer_partition = avio_rb64(s->pb);
+    }
 
     /* sanity check */
     if (mxf->run_in + mxf->footer_partition >= file_size) {
@@ -3639,6 +3691,249 @@ end:
     avio_seek(s->pb, mxf->run_in, SEEK_SET);
 }
 
+#if HAVE_THREADS
+#define PREFETCH_SLACK      (16 << 10)
+#define PREFETCH_MAX_SIZE   (64 << 20)
+#define PREFETCH_BUFFER_SIZE 32768
+
+/**
+ * Read a partition pack, the header metadata and the index table segments
+ * following it into memory.
+ */
+static void mxf_prefetch_partition(AVIOContext *pb, MXFPrefetchEntry *entry)
+{
+    uint8_t key[16];
+    int64_t length, header_byte_count, index_byte_count, size;
+    int ret;
+
+    if (avio_seek(pb, entry->pos, SEEK_SET) < 0 ||
+        avio_read(pb, key, 16) != 16 || !mxf_is_partition_pack_key(key))
+        return;
+    length = klv_decode_ber_length(pb);
+    if (length < 88 || length > PREFETCH_MAX_SIZE)
+        return;
+    avio_skip(pb, 32);
+    header_byte_count = avio_rb64(pb);
+    index_byte_count  = avio_rb64(pb);
+    if (avio_feof(pb) || header_byte_count < 0 || index_byte_count < 0)
+        return;
+
+    size = avio_tell(pb) - 48 - entry->pos + length + PREFETCH_SLACK;
+    if (header_byte_count > PREFETCH_MAX_SIZE || index_byte_count > PREFETCH_MAX_SIZE ||
+        (size += header_byte_count + index_byte_count) > PREFETCH_MAX_SIZE)
+        return;
+    if (!(entry->data = av_malloc(size)))
+        return;
+    if (avio_seek(pb, entry->pos, SEEK_SET) < 0 ||
+        (ret = avio_read(pb, entry->data, size)) <= 0) {
+        av_freep(&entry->data);
+        return;
+    }
+    entry->size = ret;
+}
+
+static void *mxf_prefetch_worker(void *arg)
+{
+    MXFPrefetchWorker *w = arg;
+    MXFContext *mxf = w->mxf;
+
+    pthread_mutex_lock(&mxf->prefetch_lock);
+    /* the header is parsed backwards from the footer, fetch in that order */
+    while (!atomic_load(&mxf->prefetch_stop) && mxf->prefetch_next >= 0) {
+        MXFPrefetchEntry *entry = &mxf->prefetch[mxf->prefetch_next--];
+        pthread_mutex_unlock(&mxf->prefetch_lock);
+        mxf_prefetch_partition(w->pb, entry);
+        pthread_mutex_lock(&mxf->prefetch_lock);
+        entry->done = 1;
+        pthread_cond_broadcast(&mxf->prefetch_cond);
+    }
+    pthread_mutex_unlock(&mxf->prefetch_lock);
+    return NULL;
+}
+
+static int mxf_prefetch_read(void *opaque, uint8_t *buf, int buf_size)
+{
+    MXFContext *mxf = opaque;
+    MXFPrefetchEntry *entry = NULL;
+    int64_t pos = mxf->prefetch_pos;
+    int ret;
+
+    for (int i = 0; i < mxf->nb_prefetch && mxf->prefetch[i].pos <= pos; i++)
+        entry = &mxf->prefetch[i];
+    if (entry) {
+        pthread_mutex_lock(&mxf->prefetch_lock);
+        while (!entry->done)
+            pthread_cond_wait(&mxf->prefetch_cond, &mxf->prefetch_lock);
+        pthread_mutex_unlock(&mxf->prefetch_lock);
+        if (pos < entry->pos + entry->size) {
+            ret = FFMIN(buf_size, entry->pos + entry->size - pos);
+            memcpy(buf, entry->data + pos - entry->pos, ret);
+            mxf->prefetch_pos += ret;
+            return ret;
+        }
+    }
+
+    /* not prefetched, read it from the input */
+    if (avio_tell(mxf->prefetch_orig_pb) != pos &&
+        (ret = avio_seek(mxf->prefetch_orig_pb, pos, SEEK_SET)) < 0)
+        return ret;
+    ret = avio_read_partial(mxf->prefetch_orig_pb, buf, buf_size);
+    if (ret > 0)
+        mxf->prefetch_pos += ret;
+    return ret ? ret : AVERROR_EOF;
+}
+
+static int64_t mxf_prefetch_seek(void *opaque, int64_t offset, int whence)
+{
+    MXFContext *mxf = opaque;
+    int64_t size = avio_size(mxf->prefetch_orig_pb);
+
+    switch (whence) {
+    case AVSEEK_SIZE:
+        return size;
+    case SEEK_CUR:
+        offset += mxf->prefetch_pos;
+        break;
+    case SEEK_END:
+        if (size < 0)
+            return size;
+        offset += size;
+        break;
+    }
+    if (offset < 0)
+        return AVERROR(EINVAL);
+    return mxf->prefetch_pos = offset;
+}
+#endif
+
+/**
+ * Fetch the partitions listed in the RandomIndexPack in separate threads,
+ * each with its own connection to the input, while the header partition is
+ * parsed. Reads from the input go through a context serving them from the
+ * prefetched data until mxf_stop_prefetch().
+ * This mostly helps with inputs where each seek is slow, like network ones.
+ */
+static int mxf_start_prefetch(AVFormatContext *s)
+{
+#if HAVE_THREADS
+    MXFContext *mxf = s->priv_data;
+    AVDictionary *opts = NULL;
+    uint8_t *buf;
+    int nb_workers, ret;
+
+    /* the header partition is read directly */
+    if (mxf->nb_rip_offsets < 2 || !s->url || (s->flags & AVFMT_FLAG_CUSTOM_IO))
+        return 0;
+    if (!(mxf->prefetch = av_calloc(mxf->nb_rip_offsets - 1, sizeof(*mxf->prefetch))))
+        return AVERROR(ENOMEM);
+    for (int i = 1; i < mxf->nb_rip_offsets; i++) {
+        if (mxf->rip_offsets[i] <= mxf->rip_offsets[i - 1]) {
+            av_log(s, AV_LOG_VERBOSE, "Unsorted RandomIndexPack, not prefetching partitions\n");
+            av_freep(&mxf->prefetch);
+            return 0;
+        }
+        mxf->prefetch[i - 1].pos = mxf->run_in + mxf->rip_offsets[i];
+    }
+    mxf->nb_prefetch   = mxf->nb_rip_offsets - 1;
+    mxf->prefetch_next = mxf->nb_prefetch - 1;
+
+    nb_workers = FFMIN(mxf->partition_threads, mxf->nb_prefetch);
+    if (!(mxf->prefetch_workers = av_calloc(nb_workers, sizeof(*mxf->prefetch_workers))))
+        return AVERROR(ENOMEM);
+    /* the inputs are opened here, one after the other, and only read from
+     * the workers */
+    if ((ret = ffio_copy_url_options(s->pb, &opts)) < 0) {
+        av_dict_free(&opts);
+        return ret;
+    }
+    for (int i = 0; i < nb_workers; i++) {
+        MXFPrefetchWorker *w = &mxf->prefetch_workers[i];
+        AVDictionary *worker_opts = NULL;
+
+        w->mxf = mxf;
+        if ((ret = av_dict_copy(&worker_opts, opts, 0)) >= 0)
+            ret = s->io_open(s, &w->pb, s->url, AVIO_FLAG_READ, &worker_opts);
+        av_dict_free(&worker_opts);
+        if (ret < 0) {
+            av_log(s, AV_LOG_WARNING, "Cannot open the input for prefetching partitions\n");
+            break;
+        }
+        mxf->nb_prefetch_workers++;
+    }
+    av_dict_free(&opts);
+    if (!mxf->nb_prefetch_workers)
+        return 0;
+
+    if (!(buf = av_malloc(PREFETCH_BUFFER_SIZE)))
+        return AVERROR(ENOMEM);
+    mxf->prefetch_pb = avio_alloc_context(buf, PREFETCH_BUFFER_SIZE, 0, mxf,
+                                          mxf_prefetch_read, NULL, mxf_prefetch_seek);
+    if (!mxf->prefetch_pb) {
+        av_free(buf);
+        return AVERROR(ENOMEM);
+    }
+    mxf->prefetch_pb->seekable = s->pb->seekable;
+
+    atomic_init(&mxf->prefetch_stop, 0);
+    if ((ret = pthread_mutex_init(&mxf->prefetch_lock, NULL)))
+        return AVERROR(ret);
+    if ((ret = pthread_cond_init(&mxf->prefetch_cond, NULL))) {
+        pthread_mutex_destroy(&mxf->prefetch_lock);
+        return AVERROR(ret);
+    }
+    for (int i = 0; i < mxf->nb_prefetch_workers; i++) {
+        MXFPrefetchWorker *w = &mxf->prefetch_workers[i];
+        if ((ret = pthread_create(&w->thread, NULL, mxf_prefetch_worker, w))) {
+            /* the workers already running fetch all the partitions */
+            for (int j = i; j < mxf->nb_prefetch_workers; j++)
+                ff_format_io_close(s, &mxf->prefetch_workers[j].pb);
+            break;
+        }
+        w->started = 1;
+    }
+    /* without any worker running, everything is read from the input */
+    if (!mxf->prefetch_workers[0].started) {
+        for (int i = 0; i < mxf->nb_prefetch; i++)
+            mxf->prefetch[i].done = 1;
+    }
+
+    mxf->prefetch_orig_pb = s->pb;
+    s->pb = mxf->prefetch_pb;
+    if ((ret = avio_seek(s->pb, avio_tell(mxf->prefetch_orig_pb), SEEK_SET)) < 0)
+        return ret;
+#endif
+    return 0;
+}
+
+static void mxf_stop_prefetch(AVFormatContext *s)
+{
+#if HAVE_THREADS
+    MXFContext *mxf = s->priv_data;
+
+    if (mxf->prefetch_orig_pb) {
+        atomic_store(&mxf->prefetch_stop, 1);
+        for (int i = 0; i < mxf->nb_prefetch_workers; i++)
+            if (mxf->prefetch_workers[i].started)
+                pthread_join(mxf->prefetch_workers[i].thread, NULL);
+        pthread_cond_destroy(&mxf->prefetch_cond);
+        pthread_mutex_destroy(&mxf->prefetch_lock);
+        s->pb = mxf->prefetch_orig_pb;
+        mxf->prefetch_orig_pb = NULL;
+    }
+    for (int i = 0; i < mxf->nb_prefetch_workers; i++)
+        ff_format_io_close(s, &mxf->prefetch_workers[i].pb);
+    av_freep(&mxf->prefetch_workers);
+    mxf->nb_prefetch_workers = 0;
+    for (int i = 0; i < mxf->nb_prefetch; i++)
+        av_freep(&mxf->prefetch[i].data);
+    av_freep(&mxf->prefetch);
+    mxf->nb_prefetch = 0;
+    if (mxf->prefetch_pb)
+        av_freep(&mxf->prefetch_pb->buffer);
+    avio_context_free(&mxf->prefetch_pb);
+#endif
+}
+
 static int mxf_read_header(AVFormatContext *s)
 {
     MXFContext *mxf = s->priv_data;
@@ -3658,6 +3953,9 @@ static int mxf_read_header(AVFormatContext *s)
 
     mxf_read_random_index_pack(s);
 
+    if ((ret = mxf_start_prefetch(s)) < 0)
+        return ret;
+
     while (!avio_feof(s->pb)) {
         const MXFMetadataReadTableEntry *metadata;
 
@@ -3715,6 +4013,8 @@ static int mxf_read_header(AVFormatContext *s)
             avio_skip(s->pb, klv.length);
         }
     }
+    mxf_stop_prefetch(s);
+
     /* FIXME avoid seek */
     if (!essence_offset)  {
         av_log(s, AV_LOG_ERROR, "no essence\n");
@@ -4030,6 +4330,8 @@ static int mxf_read_close(AVFormatContext *s)
     MXFContext *mxf = s->priv_data;
     int i;
 
+    mxf_stop_prefetch(s);
+    av_freep(&mxf->rip_offsets);
     av_freep(&mxf->packages_refs);
     av_freep(&mxf->essence_container_data_refs);
 
@@ -4199,6 +4501,9 @@ static const AVOption options[] = {
     { "eia608_extract", "extract eia 608 captions from s436m track",
       offsetof(MXFContext, eia608_extract), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,
       AV_OPT_FLAG_DECODING_PARAM },
+    { "partition_threads", "number of threads reading the partitions ahead while parsing the header",
+      offsetof(MXFContext, partition_threads), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64,
+      AV_OPT_FLAG_DECODING_PARAM },
     { NULL },
 };
 
@@ -53,6 +53,15 @@ void ff_tls_deinit(void)
 #endif
 }
 
+void ff_tls_clear_sessions(void)
+{
+#if CONFIG_TLS_PROTOCOL
+#if CONFIG_OPENSSL
+    ff_openssl_clear_sessions();
+#endif
+#endif
+}
+
 int ff_network_init(void)
 {
 #if HAVE_WINSOCK2_H
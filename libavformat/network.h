@@ -83,6 +83,7 @@ void ff_network_close(void);
 
 int ff_tls_init(void);
 void ff_tls_deinit(void);
+void ff_tls_clear_sessions(void);
 
 int ff_network_wait_fd(int fd, int write);
 
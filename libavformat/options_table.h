@@ -106,6 +106,16 @@ static const AVOption avformat_options[] = {
 {"max_streams", "maximum number of streams", OFFSET(max_streams), AV_OPT_TYPE_INT, { .i64 = 1000 }, 0, INT_MAX, D },
 {"skip_estimate_duration_from_pts", "skip duration calculation in estimate_timings_from_pts", OFFSET(skip_estimate_duration_from_pts), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, D},
 {"max_probe_packets", "Maximum number of packets to probe a codec", OFFSET(max_probe_packets), AV_OPT_TYPE_INT, { .i64 = 2500 }, 0, INT_MAX, D },
+{"probe_threads", "number of threads decoding streams concurrently while probing", OFFSET(probe_threads), AV_OPT_TYPE_INT, { .i64 = 1 }, 0, INT_MAX, D },
+{"probe_required", "stream information to read packets for while probing", OFFSET(probe_required), AV_OPT_TYPE_FLAGS, { .i64 = AVFMT_PROBE_REQUIRE_ALL }, 0, INT_MAX, D, "probe_required"},
+{"codec_params", "codec parameters", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_PROBE_REQUIRE_CODEC_PARAMS }, INT_MIN, INT_MAX, D, "probe_required"},
+{"frame_rate", "frame rate", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_PROBE_REQUIRE_FRAME_RATE }, INT_MIN, INT_MAX, D, "probe_required"},
+{"decode_delay", "decoder delay", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_PROBE_REQUIRE_DECODE_DELAY }, INT_MIN, INT_MAX, D, "probe_required"},
+{"extradata", "extradata", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_PROBE_REQUIRE_EXTRADATA }, INT_MIN, INT_MAX, D, "probe_required"},
+{"start_time", "first timestamp", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_PROBE_REQUIRE_START_TIME }, INT_MIN, INT_MAX, D, "probe_required"},
+{"streams", "streams appearing later", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_PROBE_REQUIRE_STREAMS }, INT_MIN, INT_MAX, D, "probe_required"},
+{"all", "all of the above", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_PROBE_REQUIRE_ALL }, INT_MIN, INT_MAX, D, "probe_required"},
+{"probe_info", "probe information saved by avformat_save_probe_info()", OFFSET(probe_info), AV_OPT_TYPE_BINARY, {.dbl = 0}, 0, 0, D},
 {NULL},
 };
 
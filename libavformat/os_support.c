@@ -23,11 +23,17 @@
 /* needed by inet_aton() */
 #define _DEFAULT_SOURCE
 #define _SVID_SOURCE
+/* needed by fallocate() */
+#define _GNU_SOURCE
 
 #include "config.h"
 #include "avformat.h"
 #include "os_support.h"
 
+#if HAVE_FALLOCATE
+#include <fcntl.h>
+#endif
+
 #if CONFIG_NETWORK
 #include <fcntl.h>
 #if !HAVE_POLL_H
@@ -297,3 +303,28 @@ int ff_poll(struct pollfd *fds, nfds_t numfds, int timeout)
 #endif /* !HAVE_POLL_H */
 
 #endif /* CONFIG_NETWORK */
+
+int ff_file_insert_space_align(int fd)
+{
+#if HAVE_FALLOCATE && defined(FALLOC_FL_INSERT_RANGE)
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+        st.st_blksize <= 0 || st.st_blksize > INT_MAX)
+        return AVERROR(ENOSYS);
+    return st.st_blksize;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+int ff_file_insert_space(int fd, int64_t pos, int64_t size)
+{
+#if HAVE_FALLOCATE && defined(FALLOC_FL_INSERT_RANGE)
+    if (fallocate(fd, FALLOC_FL_INSERT_RANGE, pos, size) < 0)
+        return AVERROR(errno);
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
@@ -29,6 +29,7 @@
 
 #include "config.h"
 
+#include <stdint.h>
 #include <sys/stat.h>
 
 #ifdef _WIN32
@@ -247,4 +248,28 @@ fallback:
 
 #endif
 
+/**
+ * Get the alignment of the space ff_file_insert_space() can insert.
+ *
+ * @param fd file descriptor opened for writing
+ * @return the filesystem block size, or a negative AVERROR code if inserting
+ *         space is not supported for this file
+ */
+int ff_file_insert_space_align(int fd);
+
+/**
+ * Insert space in the middle of a regular file without copying the data after
+ * it, on filesystems supporting it.
+ *
+ * @param fd   file descriptor opened for writing
+ * @param pos  position of the inserted space, a multiple of the alignment
+ *             returned by ff_file_insert_space_align()
+ * @param size size of the inserted space, a multiple of that alignment too,
+ *             by which the data from pos is moved; the contents of the
+ *             inserted space are unspecified
+ * @return 0 on success, or a negative AVERROR code if it is not supported or
+ *         on failure, in which case the file is left unchanged
+ */
+int ff_file_insert_space(int fd, int64_t pos, int64_t size);
+
 #endif /* AVFORMAT_OS_SUPPORT_H */
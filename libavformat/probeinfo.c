@@ -0,0 +1,384 @@
+/*
+ * Saving and restoring the results of input probing
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <limits.h>
+#include <string.h>
+
+#include "libavutil/imgutils.h"
+#include "libavutil/mem.h"
+
+#include "libavcodec/bytestream.h"
+
+#include "avformat.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "version.h"
+
+/*
+ * The probe information is stored as big-endian fields:
+ *   "FFPI", libavformat version, probe score, input format name,
+ *   input size, start time, duration, bit rate, duration estimation method,
+ *   number of streams, then for each stream its id, time base, frame rates,
+ *   sample aspect ratio, start time, duration, number of frames,
+ *   disposition, number of probed frames and codec parameters.
+ * The libavformat version must match for it to be used.
+ */
+#define PROBE_INFO_TAG MKBETAG('F', 'F', 'P', 'I')
+
+/* sizes of the fixed fields of each stream and of its codec parameters */
+#define STREAM_INFO_SIZE (4 + 4 * 8 + 3 * 8 + 2 * 4)
+#define CODECPAR_SIZE    (4 * 4 + 8 + 6 * 4 + 8 + 7 * 4 + 8 + 7 * 4 + 4)
+
+typedef struct ProbeInfoStream {
+    AVRational r_frame_rate;
+    AVRational avg_frame_rate;
+    AVRational sample_aspect_ratio;
+    int64_t start_time;
+    int64_t duration;
+    int64_t nb_frames;
+    int disposition;
+    int codec_info_nb_frames;
+    AVCodecParameters *par;
+} ProbeInfoStream;
+
+static void put_rational(AVIOContext *pb, AVRational q)
+{
+    avio_wb32(pb, q.num);
+    avio_wb32(pb, q.den);
+}
+
+static AVRational get_rational(GetByteContext *gb)
+{
+    AVRational q;
+    q.num = bytestream2_get_be32(gb);
+    q.den = bytestream2_get_be32(gb);
+    return q;
+}
+
+static void put_codecpar(AVIOContext *pb, const AVCodecParameters *par)
+{
+    avio_wb32(pb, par->codec_type);
+    avio_wb32(pb, par->codec_id);
+    avio_wb32(pb, par->codec_tag);
+    avio_wb32(pb, par->format);
+    avio_wb64(pb, par->bit_rate);
+    avio_wb32(pb, par->bits_per_coded_sample);
+    avio_wb32(pb, par->bits_per_raw_sample);
+    avio_wb32(pb, par->profile);
+    avio_wb32(pb, par->level);
+    avio_wb32(pb, par->width);
+    avio_wb32(pb, par->height);
+    put_rational(pb, par->sample_aspect_ratio);
+    avio_wb32(pb, par->field_order);
+    avio_wb32(pb, par->color_range);
+    avio_wb32(pb, par->color_primaries);
+    avio_wb32(pb, par->color_trc);
+    avio_wb32(pb, par->color_space);
+    avio_wb32(pb, par->chroma_location);
+    avio_wb32(pb, par->video_delay);
+    avio_wb64(pb, par->channel_layout);
+    avio_wb32(pb, par->channels);
+    avio_wb32(pb, par->sample_rate);
+    avio_wb32(pb, par->block_align);
+    avio_wb32(pb, par->frame_size);
+    avio_wb32(pb, par->initial_padding);
+    avio_wb32(pb, par->trailing_padding);
+    avio_wb32(pb, par->seek_preroll);
+    avio_wb32(pb, par->extradata_size);
+    avio_write(pb, par->extradata, par->extradata_size);
+}
+
+static int check_codecpar(const AVCodecParameters *par)
+{
+    if ((unsigned)(par->codec_type + 1) > AVMEDIA_TYPE_NB ||
+        (par->codec_id != AV_CODEC_ID_NONE && !avcodec_descriptor_get(par->codec_id)))
+        return AVERROR_INVALIDDATA;
+    if (par->codec_type == AVMEDIA_TYPE_VIDEO &&
+        (unsigned)(par->format + 1) > AV_PIX_FMT_NB)
+        return AVERROR_INVALIDDATA;
+    if (par->codec_type == AVMEDIA_TYPE_AUDIO &&
+        (unsigned)(par->format + 1) > AV_SAMPLE_FMT_NB)
+        return AVERROR_INVALIDDATA;
+    if (par->width < 0 || par->height < 0 ||
+        (par->width && par->height &&
+         av_image_check_size(par->width, par->height, 0, NULL) < 0))
+        return AVERROR_INVALIDDATA;
+    if (par->sample_aspect_ratio.num < 0 || par->sample_aspect_ratio.den < 0 ||
+        (unsigned)par->field_order     > AV_FIELD_BT          ||
+        (unsigned)par->color_range     >= AVCOL_RANGE_NB      ||
+        (unsigned)par->color_primaries >= AVCOL_PRI_NB        ||
+        (unsigned)par->color_trc       >= AVCOL_TRC_NB        ||
+        (unsigned)par->color_space     >= AVCOL_SPC_NB        ||
+        (unsigned)par->chroma_location >= AVCHROMA_LOC_NB)
+        return AVERROR_INVALIDDATA;
+    if (par->bits_per_coded_sample < 0 || par->bits_per_raw_sample < 0 ||
+        par->video_delay < 0 || par->channels < 0 || par->sample_rate < 0 ||
+        par->block_align < 0 || par->frame_size < 0 ||
+        par->initial_padding < 0 || par->trailing_padding < 0 ||
+        par->seek_preroll < 0)
+        return AVERROR_INVALIDDATA;
+    return 0;
+}
+
+static int get_codecpar(GetByteContext *gb, AVCodecParameters *par)
+{
+    int extradata_size, ret;
+
+    par->codec_type            = bytestream2_get_be32(gb);
+    par->codec_id              = bytestream2_get_be32(gb);
+    par->codec_tag             = bytestream2_get_be32(gb);
+    par->format                = bytestream2_get_be32(gb);
+    par->bit_rate              = bytestream2_get_be64(gb);
+    par->bits_per_coded_sample = bytestream2_get_be32(gb);
+    par->bits_per_raw_sample   = bytestream2_get_be32(gb);
+    par->profile               = bytestream2_get_be32(gb);
+    par->level                 = bytestream2_get_be32(gb);
+    par->width                 = bytestream2_get_be32(gb);
+    par->height                = bytestream2_get_be32(gb);
+    par->sample_aspect_ratio   = get_rational(gb);
+    par->field_order           = bytestream2_get_be32(gb);
+    par->color_range           = bytestream2_get_be32(gb);
+    par->color_primaries       = bytestream2_get_be32(gb);
+    par->color_trc             = bytestream2_get_be32(gb);
+    par->color_space           = bytestream2_get_be32(gb);
+    par->chroma_location       = bytestream2_get_be32(gb);
+    par->video_delay           = bytestream2_get_be32(gb);
+    par->channel_layout        = bytestream2_get_be64(gb);
+    par->channels              = bytestream2_get_be32(gb);
+    par->sample_rate           = bytestream2_get_be32(gb);
+    par->block_align           = bytestream2_get_be32(gb);
+    par->frame_size            = bytestream2_get_be32(gb);
+    par->initial_padding       = bytestream2_get_be32(gb);
+    par->trailing_padding      = bytestream2_get_be32(gb);
+    par->seek_preroll          = bytestream2_get_be32(gb);
+    if ((ret = check_codecpar(par)) < 0)
+        return ret;
+
+    extradata_size = bytestream2_get_be32(gb);
+    if (extradata_size < 0 || extradata_size > bytestream2_get_bytes_left(gb) ||
+        extradata_size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return AVERROR_INVALIDDATA;
+    if (extradata_size) {
+        par->extradata = av_mallocz(extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!par->extradata)
+            return AVERROR(ENOMEM);
+        bytestream2_get_bufferu(gb, par->extradata, extradata_size);
+        par->extradata_size = extradata_size;
+    }
+    return 0;
+}
+
+int avformat_save_probe_info(AVFormatContext *s, uint8_t **buf, int *size)
+{
+    AVIOContext *pb;
+    int ret;
+
+    if (!s->iformat)
+        return AVERROR(EINVAL);
+    if ((ret = avio_open_dyn_buf(&pb)) < 0)
+        return ret;
+
+    avio_wb32(pb, PROBE_INFO_TAG);
+    avio_wb32(pb, LIBAVFORMAT_VERSION_INT);
+    avio_wb32(pb, s->probe_score);
+    avio_put_str(pb, s->iformat->name);
+    avio_wb64(pb, s->pb ? avio_size(s->pb) : -1);
+    avio_wb64(pb, s->start_time);
+    avio_wb64(pb, s->duration);
+    avio_wb64(pb, s->bit_rate);
+    avio_wb32(pb, s->duration_estimation_method);
+    avio_wb32(pb, s->nb_streams);
+
+    for (unsigned i = 0; i < s->nb_streams; i++) {
+        const AVStream *const st = s->streams[i];
+
+        avio_wb32(pb, st->id);
+        put_rational(pb, st->time_base);
+        put_rational(pb, st->r_frame_rate);
+        put_rational(pb, st->avg_frame_rate);
+        put_rational(pb, st->sample_aspect_ratio);
+        avio_wb64(pb, st->start_time);
+        avio_wb64(pb, st->duration);
+        avio_wb64(pb, st->nb_frames);
+        avio_wb32(pb, st->disposition);
+        avio_wb32(pb, cffstream(st)->codec_info_nb_frames);
+        put_codecpar(pb, st->codecpar);
+    }
+
+    *size = avio_close_dyn_buf(pb, buf);
+    return *buf ? 0 : AVERROR(ENOMEM);
+}
+
+static int probe_info_header(AVFormatContext *s, GetByteContext *gb,
+                             char *name, int name_size, int *score)
+{
+    bytestream2_init(gb, s->probe_info, s->probe_info_size);
+    if (bytestream2_get_be32(gb) != PROBE_INFO_TAG)
+        return AVERROR_INVALIDDATA;
+    if (bytestream2_get_be32(gb) != LIBAVFORMAT_VERSION_INT) {
+        av_log(s, AV_LOG_VERBOSE, "Probe info from another libavformat version, ignoring it\n");
+        return AVERROR(EINVAL);
+    }
+    *score = bytestream2_get_be32(gb);
+    if ((unsigned)*score > AVPROBE_SCORE_MAX)
+        return AVERROR_INVALIDDATA;
+    for (int i = 0;; i++) {
+        if (i == name_size || !bytestream2_get_bytes_left(gb))
+            return AVERROR_INVALIDDATA;
+        if (!(name[i] = bytestream2_get_byte(gb)))
+            break;
+    }
+    return 0;
+}
+
+const AVInputFormat *ff_probe_info_format(AVFormatContext *s, int *score)
+{
+    GetByteContext gb;
+    char name[128];
+
+    int64_t size;
+
+    if (probe_info_header(s, &gb, name, sizeof(name), score) < 0)
+        return NULL;
+    size = bytestream2_get_be64(&gb);
+    if (size >= 0 && avio_size(s->pb) >= 0 && size != avio_size(s->pb))
+        return NULL;
+    return av_find_input_format(name);
+}
+
+int ff_probe_info_apply(AVFormatContext *s)
+{
+    GetByteContext gb;
+    ProbeInfoStream *streams = NULL;
+    char name[128];
+    int64_t size, start_time, duration, bit_rate;
+    int score, method, ret;
+    unsigned nb_streams;
+
+    if ((ret = probe_info_header(s, &gb, name, sizeof(name), &score)) < 0)
+        goto mismatch;
+    ret = AVERROR_INVALIDDATA;
+    if (bytestream2_get_bytes_left(&gb) < 4 * 8 + 2 * 4)
+        goto mismatch;
+    size       = bytestream2_get_be64(&gb);
+    start_time = bytestream2_get_be64(&gb);
+    duration   = bytestream2_get_be64(&gb);
+    bit_rate   = bytestream2_get_be64(&gb);
+    method     = bytestream2_get_be32(&gb);
+    nb_streams = bytestream2_get_be32(&gb);
+    if ((unsigned)method > AVFMT_DURATION_FROM_BITRATE)
+        goto mismatch;
+
+    ret = AVERROR(EINVAL);
+    if (strcmp(name, s->iformat->name) || nb_streams != s->nb_streams ||
+        (size >= 0 && s->pb && avio_size(s->pb) >= 0 && size != avio_size(s->pb)))
+        goto mismatch;
+
+    streams = av_calloc(nb_streams, sizeof(*streams));
+    if (!streams)
+        return AVERROR(ENOMEM);
+
+    /* Read and check everything before touching any of the streams. */
+    for (unsigned i = 0; i < nb_streams; i++) {
+        const AVStream *const st = s->streams[i];
+        ProbeInfoStream *const pst = &streams[i];
+        AVRational time_base;
+
+        ret = AVERROR_INVALIDDATA;
+        if (bytestream2_get_bytes_left(&gb) < STREAM_INFO_SIZE + CODECPAR_SIZE)
+            goto mismatch;
+        ret = AVERROR(EINVAL);
+        if (bytestream2_get_be32(&gb) != st->id)
+            goto mismatch;
+        time_base                 = get_rational(&gb);
+        pst->r_frame_rate         = get_rational(&gb);
+        pst->avg_frame_rate       = get_rational(&gb);
+        pst->sample_aspect_ratio  = get_rational(&gb);
+        pst->start_time           = bytestream2_get_be64(&gb);
+        pst->duration             = bytestream2_get_be64(&gb);
+        pst->nb_frames            = bytestream2_get_be64(&gb);
+        pst->disposition          = bytestream2_get_be32(&gb);
+        pst->codec_info_nb_frames = bytestream2_get_be32(&gb);
+
+        if (!(pst->par = avcodec_parameters_alloc())) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        if ((ret = get_codecpar(&gb, pst->par)) < 0) {
+            if (ret == AVERROR(ENOMEM))
+                goto end;
+            goto mismatch;
+        }
+        ret = AVERROR(EINVAL);
+        if (av_cmp_q(time_base, st->time_base) ||
+            (st->codecpar->codec_type != AVMEDIA_TYPE_UNKNOWN &&
+             st->codecpar->codec_type != pst->par->codec_type))
+            goto mismatch;
+        ret = AVERROR_INVALIDDATA;
+        if (pst->sample_aspect_ratio.num < 0 || pst->sample_aspect_ratio.den < 0 ||
+            pst->codec_info_nb_frames < 0)
+            goto mismatch;
+    }
+    if (bytestream2_get_bytes_left(&gb)) {
+        ret = AVERROR_INVALIDDATA;
+        goto mismatch;
+    }
+
+    for (unsigned i = 0; i < nb_streams; i++) {
+        AVStream *const st  = s->streams[i];
+        FFStream *const sti = ffstream(st);
+        const ProbeInfoStream *const pst = &streams[i];
+
+        st->r_frame_rate          = pst->r_frame_rate;
+        st->avg_frame_rate        = pst->avg_frame_rate;
+        st->sample_aspect_ratio   = pst->sample_aspect_ratio;
+        st->start_time            = pst->start_time;
+        st->duration              = pst->duration;
+        st->nb_frames             = pst->nb_frames;
+        st->disposition           = pst->disposition;
+        sti->codec_info_nb_frames = pst->codec_info_nb_frames;
+        if ((ret = avcodec_parameters_copy(st->codecpar, pst->par)) < 0)
+            goto end;
+        if (st->codecpar->codec_id != AV_CODEC_ID_NONE && sti->request_probe > 0)
+            sti->request_probe = 0;
+        sti->need_context_update = 1;
+    }
+
+    s->start_time                 = start_time;
+    s->duration                   = duration;
+    s->bit_rate                   = bit_rate;
+    s->duration_estimation_method = method;
+    ret = 1;
+    goto end;
+
+mismatch:
+    if (ret == AVERROR_INVALIDDATA)
+        av_log(s, AV_LOG_WARNING, "Invalid probe info, analyzing the input\n");
+    else
+        av_log(s, AV_LOG_WARNING, "Probe info does not match the input, analyzing it\n");
+    ret = 0;
+end:
+    if (streams) {
+        for (unsigned i = 0; i < nb_streams; i++)
+            avcodec_parameters_free(&streams[i].par);
+        av_free(streams);
+    }
+    return ret;
+}
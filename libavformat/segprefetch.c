@@ -0,0 +1,385 @@
+/*
+ * Segment prefetching for the HLS and DASH demuxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "config.h"
+
+#include "libavutil/error.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+#include "segprefetch.h"
+#include "url.h"
+
+#define PREFETCH_CHUNK_SIZE 65536
+
+static void free_item(SegPrefetchItem *it)
+{
+    av_freep(&it->url);
+    av_freep(&it->data);
+    av_dict_free(&it->opts);
+    av_free(it);
+}
+
+void ff_segprefetch_free_queue(SegPrefetchQueue *q)
+{
+    while (q->items) {
+        SegPrefetchItem *it = q->items;
+        q->items = it->next;
+        free_item(it);
+    }
+    q->cur         = NULL;
+    q->next_seq_no = 0;
+    av_freep(&q->buf);
+}
+
+#if HAVE_THREADS
+
+int ff_segprefetch_init(SegPrefetch *p, int64_t budget,
+                        AVIOInterruptCB *interrupt_callback)
+{
+    int ret;
+
+    if ((ret = pthread_mutex_init(&p->lock, NULL)))
+        return AVERROR(ret);
+    if ((ret = pthread_cond_init(&p->cond, NULL))) {
+        pthread_mutex_destroy(&p->lock);
+        return AVERROR(ret);
+    }
+    p->budget             = budget;
+    p->bytes              = 0;
+    p->stop               = 0;
+    p->interrupt_callback = interrupt_callback;
+    p->inited             = 1;
+    return 0;
+}
+
+void ff_segprefetch_stop(SegPrefetch *p)
+{
+    if (!p->inited)
+        return;
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void ff_segprefetch_uninit(SegPrefetch *p)
+{
+    if (!p->inited)
+        return;
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->lock);
+    p->inited = 0;
+}
+
+int ff_segprefetch_start(SegPrefetch *p, SegPrefetchQueue *q,
+                         void *(*thread)(void *arg), void *arg)
+{
+    int ret;
+
+    if (!q->buf && !(q->buf = av_malloc(PREFETCH_CHUNK_SIZE)))
+        return AVERROR(ENOMEM);
+    ret = pthread_create(&q->thread, NULL, thread, arg);
+    if (ret)
+        return AVERROR(ret);
+    q->started = 1;
+    return 0;
+}
+
+void ff_segprefetch_join(SegPrefetchQueue *q)
+{
+    if (q->started)
+        pthread_join(q->thread, NULL);
+    q->started = 0;
+}
+
+void ff_segprefetch_wait(SegPrefetch *p, int64_t timeout)
+{
+    int64_t t = av_gettime() + timeout;
+    struct timespec tv = { .tv_sec  =  t / 1000000,
+                           .tv_nsec = (t % 1000000) * 1000 };
+    pthread_cond_timedwait(&p->cond, &p->lock, &tv);
+}
+
+/* Called with the lock held. */
+static void discard(SegPrefetch *p, SegPrefetchQueue *q, SegPrefetchItem *it)
+{
+    SegPrefetchItem **prev = &q->items;
+
+    if (it->running && !it->done) {
+        it->abandoned = 1;
+        return;
+    }
+    while (*prev != it)
+        prev = &(*prev)->next;
+    *prev = it->next;
+    p->bytes -= it->len;
+    free_item(it);
+    pthread_cond_broadcast(&p->cond);
+}
+
+int ff_segprefetch_add(SegPrefetch *p, SegPrefetchQueue *q, int64_t seq_no,
+                       const char *url, int64_t url_offset, int64_t size,
+                       const AVDictionary *opts)
+{
+    SegPrefetchItem **tail, *it = av_mallocz(sizeof(*it));
+    int ret;
+
+    if (!it || !(it->url = av_strdup(url))) {
+        av_free(it);
+        return AVERROR(ENOMEM);
+    }
+    if ((ret = av_dict_copy(&it->opts, opts, 0)) < 0) {
+        free_item(it);
+        return ret;
+    }
+    it->seq_no     = seq_no;
+    it->url_offset = url_offset;
+    it->size       = size;
+
+    for (tail = &q->items; *tail; tail = &(*tail)->next)
+        ;
+    *tail = it;
+    pthread_cond_broadcast(&p->cond);
+    return 0;
+}
+
+void ff_segprefetch_drop_before(SegPrefetch *p, SegPrefetchQueue *q,
+                                int64_t seq_no)
+{
+    SegPrefetchItem *it, *next;
+
+    for (it = q->items; it; it = next) {
+        next = it->next;
+        if (it->seq_no < seq_no && !it->abandoned)
+            discard(p, q, it);
+    }
+}
+
+SegPrefetchItem *ff_segprefetch_next(SegPrefetch *p, SegPrefetchQueue *q)
+{
+    SegPrefetchItem *it, *first = NULL;
+
+    for (it = q->items; it; it = it->next) {
+        if (it->abandoned)
+            continue;
+        if (!first)
+            first = it;
+        if (!it->running)
+            break;
+    }
+    if (!it || (it != first && p->bytes >= p->budget))
+        return NULL;
+    it->running = 1;
+    return it;
+}
+
+int ff_segprefetch_fill(SegPrefetch *p, SegPrefetchQueue *q,
+                        SegPrefetchItem *it, AVIOContext *pb)
+{
+    int ret = 0;
+
+    for (;;) {
+        int64_t len = PREFETCH_CHUNK_SIZE;
+        uint8_t *data;
+
+        if (it->size >= 0)
+            len = FFMIN(len, it->size - it->len);
+        if (len <= 0)
+            break;
+        ret = avio_read(pb, q->buf, len);
+        if (ret <= 0) {
+            if (ret == AVERROR_EOF)
+                ret = 0;
+            break;
+        }
+
+        pthread_mutex_lock(&p->lock);
+        if (it->abandoned || p->stop) {
+            ret = AVERROR_EXIT;
+        } else if (!(data = av_fast_realloc(it->data, &it->alloc, it->len + ret))) {
+            ret = AVERROR(ENOMEM);
+        } else {
+            it->data = data;
+            memcpy(it->data + it->len, q->buf, ret);
+            it->len  += ret;
+            p->bytes += ret;
+            pthread_cond_broadcast(&p->cond);
+        }
+        pthread_mutex_unlock(&p->lock);
+        if (ret < 0)
+            break;
+    }
+    return ret;
+}
+
+void ff_segprefetch_done(SegPrefetch *p, SegPrefetchQueue *q,
+                         SegPrefetchItem *it, int ret)
+{
+    it->error = ret;
+    it->done  = 1;
+    if (it->abandoned)
+        discard(p, q, it);
+    pthread_cond_broadcast(&p->cond);
+}
+
+int ff_segprefetch_open(SegPrefetch *p, SegPrefetchQueue *q, int64_t seq_no,
+                        const char *url, int64_t url_offset)
+{
+    SegPrefetchItem *it;
+    int ret = 0;
+
+    pthread_mutex_lock(&p->lock);
+    for (it = q->items; it; it = it->next) {
+        if (it->abandoned)
+            continue;
+        if (url ? it->url_offset == url_offset && !strcmp(it->url, url)
+                : it->seq_no == seq_no)
+            break;
+    }
+    if (!it) {
+        ret = AVERROR(ENOENT);
+    } else {
+        while (!it->done && !it->len) {
+            if (ff_check_interrupt(p->interrupt_callback)) {
+                ret = AVERROR_EXIT;
+                break;
+            }
+            ff_segprefetch_wait(p, 100000);
+        }
+        if (!ret && !it->len && it->error < 0) {
+            ret = it->error;
+            discard(p, q, it);
+        } else if (!ret) {
+            q->cur = it;
+        }
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return ret;
+}
+
+int ff_segprefetch_read(SegPrefetch *p, SegPrefetchQueue *q, int64_t offset,
+                        uint8_t *buf, int buf_size)
+{
+    SegPrefetchItem *it = q->cur;
+    int ret;
+
+    pthread_mutex_lock(&p->lock);
+    while (offset >= it->len && !it->done) {
+        if (ff_check_interrupt(p->interrupt_callback)) {
+            pthread_mutex_unlock(&p->lock);
+            return AVERROR_EXIT;
+        }
+        ff_segprefetch_wait(p, 100000);
+    }
+    if (offset < it->len) {
+        ret = FFMIN(buf_size, it->len - offset);
+        memcpy(buf, it->data + offset, ret);
+    } else {
+        ret = it->error < 0 ? it->error : AVERROR_EOF;
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return ret;
+}
+
+void ff_segprefetch_release(SegPrefetch *p, SegPrefetchQueue *q,
+                            AVDictionary **avio_opts)
+{
+    SegPrefetchItem *it = q->cur;
+    const AVDictionaryEntry *e;
+
+    if (!it)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    e = av_dict_get(it->opts, "cookies", NULL, 0);
+    if (it->done && e) {
+        SegPrefetchItem *next;
+        av_dict_set(avio_opts, "cookies", e->value, 0);
+        /* the segments queued behind this one are not being downloaded yet */
+        for (next = it->next; next; next = next->next)
+            if (!next->running)
+                av_dict_set(&next->opts, "cookies", e->value, 0);
+    }
+    discard(p, q, it);
+    q->cur = NULL;
+    pthread_mutex_unlock(&p->lock);
+}
+
+void ff_segprefetch_flush(SegPrefetch *p, SegPrefetchQueue *q)
+{
+    SegPrefetchItem *it, *next;
+
+    if (!q->started)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    q->cur = NULL;
+    for (it = q->items; it; it = next) {
+        next = it->next;
+        if (!it->abandoned)
+            discard(p, q, it);
+    }
+    pthread_mutex_unlock(&p->lock);
+    q->next_seq_no = 0;
+}
+
+#else
+
+int ff_segprefetch_init(SegPrefetch *p, int64_t budget,
+                        AVIOInterruptCB *interrupt_callback)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_segprefetch_stop(SegPrefetch *p)
+{
+}
+
+void ff_segprefetch_uninit(SegPrefetch *p)
+{
+}
+
+int ff_segprefetch_open(SegPrefetch *p, SegPrefetchQueue *q, int64_t seq_no,
+                        const char *url, int64_t url_offset)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_segprefetch_read(SegPrefetch *p, SegPrefetchQueue *q, int64_t offset,
+                        uint8_t *buf, int buf_size)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_segprefetch_release(SegPrefetch *p, SegPrefetchQueue *q,
+                            AVDictionary **avio_opts)
+{
+}
+
+void ff_segprefetch_flush(SegPrefetch *p, SegPrefetchQueue *q)
+{
+}
+
+#endif /* HAVE_THREADS */
@@ -0,0 +1,185 @@
+/*
+ * Segment prefetching for the HLS and DASH demuxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_SEGPREFETCH_H
+#define AVFORMAT_SEGPREFETCH_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "libavutil/dict.h"
+#include "libavutil/thread.h"
+#include "avio.h"
+
+/**
+ * A segment downloaded ahead of time by the prefetch thread of its
+ * playlist. The data may be read while it is still being downloaded.
+ */
+typedef struct SegPrefetchItem {
+    struct SegPrefetchItem *next;
+    int64_t seq_no;
+    char *url;
+    int64_t url_offset;
+    int64_t size;           ///< -1 if unknown
+    AVDictionary *opts;     ///< options for opening the url, updated by it
+    uint8_t *data;
+    unsigned int len;
+    unsigned int alloc;
+    int running;
+    int done;
+    int abandoned;          ///< no longer wanted, freed by the thread once done
+    int error;
+} SegPrefetchItem;
+
+/**
+ * The segments of one playlist queued for download by its prefetch thread.
+ * Except for cur and next_seq_no, which belong to the demuxer, the fields
+ * are shared with the thread and protected by SegPrefetch.lock.
+ */
+typedef struct SegPrefetchQueue {
+    SegPrefetchItem *items; ///< in seq_no order
+    SegPrefetchItem *cur;   ///< segment being read
+    int64_t next_seq_no;    ///< next seq_no to queue
+    int started;
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+    uint8_t *buf;           ///< download buffer of the thread
+} SegPrefetchQueue;
+
+/**
+ * State shared by all the prefetch threads of a demuxer. The lock and the
+ * condition may also protect other state exchanged with these threads.
+ */
+typedef struct SegPrefetch {
+    int64_t budget;         ///< maximum amount of prefetched data
+    int64_t bytes;          ///< amount of prefetched data
+    int stop;
+    AVIOInterruptCB *interrupt_callback;
+#if HAVE_THREADS
+    int inited;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+} SegPrefetch;
+
+/**
+ * @return 0 on success, AVERROR(ENOSYS) when built without thread support
+ */
+int ff_segprefetch_init(SegPrefetch *p, int64_t budget,
+                        AVIOInterruptCB *interrupt_callback);
+
+/**
+ * Ask all the prefetch threads to exit, they must then be joined with
+ * ff_segprefetch_join() before calling ff_segprefetch_uninit().
+ */
+void ff_segprefetch_stop(SegPrefetch *p);
+
+void ff_segprefetch_uninit(SegPrefetch *p);
+
+/**
+ * Start the prefetch thread of a queue.
+ */
+int ff_segprefetch_start(SegPrefetch *p, SegPrefetchQueue *q,
+                         void *(*thread)(void *arg), void *arg);
+
+void ff_segprefetch_join(SegPrefetchQueue *q);
+
+/**
+ * Wait for a change of the shared state, with the lock held.
+ *
+ * @param timeout maximum time to wait, in microseconds
+ */
+void ff_segprefetch_wait(SegPrefetch *p, int64_t timeout);
+
+/**
+ * Append a segment to a queue, with the lock held.
+ */
+int ff_segprefetch_add(SegPrefetch *p, SegPrefetchQueue *q, int64_t seq_no,
+                       const char *url, int64_t url_offset, int64_t size,
+                       const AVDictionary *opts);
+
+/**
+ * Drop the queued segments before seq_no, with the lock held.
+ */
+void ff_segprefetch_drop_before(SegPrefetch *p, SegPrefetchQueue *q,
+                                int64_t seq_no);
+
+/**
+ * Pick the next segment to download and mark it as running, with the lock
+ * held. Only the segment being read may be downloaded once the memory
+ * budget is exhausted.
+ *
+ * @return the segment, or NULL if there is nothing to download
+ */
+SegPrefetchItem *ff_segprefetch_next(SegPrefetch *p, SegPrefetchQueue *q);
+
+/**
+ * Read a segment from pb until its end, from the prefetch thread, without
+ * the lock held.
+ *
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int ff_segprefetch_fill(SegPrefetch *p, SegPrefetchQueue *q,
+                        SegPrefetchItem *it, AVIOContext *pb);
+
+/**
+ * Mark a segment returned by ff_segprefetch_next() as downloaded, with
+ * the lock held.
+ */
+void ff_segprefetch_done(SegPrefetch *p, SegPrefetchQueue *q,
+                         SegPrefetchItem *it, int ret);
+
+/**
+ * Start reading a segment from the queue, waiting for its first data so
+ * that download errors are reported here.
+ *
+ * @param url if not NULL, the segment is matched by url and url_offset
+ *            instead of seq_no
+ * @return 0 on success, AVERROR(ENOENT) if the segment is not queued
+ */
+int ff_segprefetch_open(SegPrefetch *p, SegPrefetchQueue *q, int64_t seq_no,
+                        const char *url, int64_t url_offset);
+
+/**
+ * Read from the segment being read, waiting for the data to be downloaded.
+ */
+int ff_segprefetch_read(SegPrefetch *p, SegPrefetchQueue *q, int64_t offset,
+                        uint8_t *buf, int buf_size);
+
+/**
+ * Free the segment being read. The cookies set by its download are kept in
+ * avio_opts and passed on to the queued segments not yet being downloaded,
+ * as the demuxers do for the segments they open themselves.
+ */
+void ff_segprefetch_release(SegPrefetch *p, SegPrefetchQueue *q,
+                            AVDictionary **avio_opts);
+
+/**
+ * Drop all the queued segments, e.g. when the read position changes.
+ */
+void ff_segprefetch_flush(SegPrefetch *p, SegPrefetchQueue *q);
+
+/**
+ * Free all the segments and buffers of a queue whose thread was joined.
+ */
+void ff_segprefetch_free_queue(SegPrefetchQueue *q);
+
+#endif /* AVFORMAT_SEGPREFETCH_H */
@@ -108,3 +108,12 @@ int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AV
                                 &parent->interrupt_callback, options,
                                 parent->protocol_whitelist, parent->protocol_blacklist, parent);
 }
+
+TLSShared *ff_tls_get_shared(URLContext *h)
+{
+    struct {
+        const AVClass *class;
+        TLSShared tls_shared;
+    } *p = h->priv_data;
+    return &p->tls_shared;
+}
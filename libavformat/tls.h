@@ -55,10 +55,18 @@ typedef struct TLSShared {
 
 int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AVDictionary **options);
 
+/**
+ * Get the state shared by the TLS implementations, which all keep it right
+ * after their class in their private context.
+ */
+TLSShared *ff_tls_get_shared(URLContext *h);
+
 void ff_gnutls_init(void);
 void ff_gnutls_deinit(void);
 
 int ff_openssl_init(void);
 void ff_openssl_deinit(void);
+/* Drop the sessions kept for resumption. */
+void ff_openssl_clear_sessions(void);
 
 #endif /* AVFORMAT_TLS_H */
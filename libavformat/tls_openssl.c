@@ -47,8 +47,82 @@ typedef struct TLSContext {
     BIO_METHOD* url_bio_method;
 #endif
     int io_err;
+    char *session_key;
 } TLSContext;
 
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+#define MAX_CACHED_SESSIONS 16
+
+/* Sessions of the last servers connected to, resumed by later connections
+ * to them with the same settings to skip the full handshake. */
+static AVMutex session_mutex = AV_MUTEX_INITIALIZER;
+static struct {
+    char *key;
+    SSL_SESSION *session;
+} sessions[MAX_CACHED_SESSIONS];
+static int nb_sessions;
+
+static int new_session_cb(SSL *ssl, SSL_SESSION *session)
+{
+    TLSContext *p = SSL_get_app_data(ssl);
+    char *key;
+    int i;
+
+    if (!p->session_key || !SSL_SESSION_is_resumable(session))
+        return 0;
+
+    ff_mutex_lock(&session_mutex);
+    for (i = 0; i < nb_sessions; i++)
+        if (!strcmp(sessions[i].key, p->session_key))
+            break;
+    if (i < nb_sessions) {
+        SSL_SESSION_free(sessions[i].session);
+    } else if ((key = av_strdup(p->session_key))) {
+        if (nb_sessions == MAX_CACHED_SESSIONS) {
+            av_free(sessions[0].key);
+            SSL_SESSION_free(sessions[0].session);
+            memmove(&sessions[0], &sessions[1], (nb_sessions - 1) * sizeof(*sessions));
+            nb_sessions--;
+        }
+        i = nb_sessions++;
+        sessions[i].key = key;
+    } else {
+        ff_mutex_unlock(&session_mutex);
+        return 0;
+    }
+    sessions[i].session = session;
+    ff_mutex_unlock(&session_mutex);
+
+    /* the reference to the session is kept */
+    return 1;
+}
+
+static void resume_session(TLSContext *p)
+{
+    ff_mutex_lock(&session_mutex);
+    for (int i = 0; i < nb_sessions; i++) {
+        if (!strcmp(sessions[i].key, p->session_key)) {
+            SSL_set_session(p->ssl, sessions[i].session);
+            break;
+        }
+    }
+    ff_mutex_unlock(&session_mutex);
+}
+#endif
+
+void ff_openssl_clear_sessions(void)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    ff_mutex_lock(&session_mutex);
+    for (int i = 0; i < nb_sessions; i++) {
+        av_freep(&sessions[i].key);
+        SSL_SESSION_free(sessions[i].session);
+    }
+    nb_sessions = 0;
+    ff_mutex_unlock(&session_mutex);
+#endif
+}
+
 #if HAVE_THREADS && OPENSSL_VERSION_NUMBER < 0x10100000L
 #include <openssl/crypto.h>
 pthread_mutex_t *openssl_mutexes;
@@ -155,6 +229,7 @@ static int tls_close(URLContext *h)
     }
     if (c->ctx)
         SSL_CTX_free(c->ctx);
+    av_freep(&c->session_key);
     ffurl_closep(&c->tls_shared.tcp);
 #if OPENSSL_VERSION_NUMBER >= 0x1010000fL
     if (c->url_bio_method)
@@ -273,6 +348,13 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
         goto fail;
     }
     SSL_CTX_set_options(p->ctx, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    if (!c->listen) {
+        SSL_CTX_set_session_cache_mode(p->ctx, SSL_SESS_CACHE_CLIENT |
+                                               SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(p->ctx, new_session_cb);
+    }
+#endif
     if (c->ca_file) {
         if (!SSL_CTX_load_verify_locations(p->ctx, c->ca_file, NULL))
             av_log(h, AV_LOG_ERROR, "SSL_CTX_load_verify_locations %s\n", ERR_error_string(ERR_get_error(), NULL));
@@ -316,6 +398,21 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
     SSL_set_bio(p->ssl, bio, bio);
     if (!c->listen && !c->numerichost)
         SSL_set_tlsext_host_name(p->ssl, c->host);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    if (!c->listen) {
+        p->session_key = av_asprintf("%s %d %s %s %s %s", uri, c->verify,
+                                     c->ca_file   ? c->ca_file   : "",
+                                     c->cert_file ? c->cert_file : "",
+                                     c->key_file  ? c->key_file  : "",
+                                     c->host      ? c->host      : "");
+        if (!p->session_key) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        SSL_set_app_data(p->ssl, p);
+        resume_session(p);
+    }
+#endif
     ret = c->listen ? SSL_accept(p->ssl) : SSL_connect(p->ssl);
     if (ret == 0) {
         av_log(h, AV_LOG_ERROR, "Unable to negotiate TLS/SSL session\n");
@@ -325,6 +422,8 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
         ret = print_tls_error(h, ret);
         goto fail;
     }
+    if (SSL_session_reused(p->ssl))
+        av_log(h, AV_LOG_VERBOSE, "Resumed the TLS session\n");
 
     return 0;
 fail:
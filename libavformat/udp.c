@@ -26,6 +26,9 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() and sendmmsg() */
+
+#include <stdatomic.h>
 
 #include "avformat.h"
 #include "avio_internal.h"
@@ -47,6 +50,11 @@
 #include "TargetConditionals.h"
 #endif
 
+#if HAVE_STRUCT_SOCK_TXTIME
+#include <time.h>
+#include <linux/net_tstamp.h>
+#endif
+
 #if HAVE_UDPLITE_H
 #include "udplite.h"
 #else
@@ -80,6 +88,24 @@
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
 
+#if HAVE_RECVMMSG
+#define UDP_RX_BATCH 32 /* maximum number of datagrams per recvmmsg() call */
+#else
+#define UDP_RX_BATCH 1
+#endif
+
+#if HAVE_SENDMMSG
+#define UDP_TX_BATCH 32 /* maximum number of datagrams per sendmmsg() call */
+#else
+#define UDP_TX_BATCH 1
+#endif
+
+#if HAVE_SENDMMSG && HAVE_STRUCT_SOCK_TXTIME && defined(SO_TXTIME)
+#define UDP_TXTIME 1
+#else
+#define UDP_TXTIME 0
+#endif
+
 typedef struct UDPContext {
     const AVClass *class;
     int udp_fd;
@@ -100,8 +126,29 @@ typedef struct UDPContext {
     int circular_buffer_size;
     AVFifo *fifo;
     int circular_buffer_error;
+
+    /* Single producer, single consumer ring of datagrams between the
+     * receiving thread and udp_read(), each stored as a 32-bit length
+     * followed by the data padded to 4 bytes. rx_head and rx_tail count
+     * the bytes written and consumed since the start. */
+    uint8_t *rx_ring;
+    unsigned rx_ring_size;
+    uint8_t *rx_batch;
+    atomic_uint_least64_t rx_head;
+    atomic_uint_least64_t rx_tail;
+    atomic_int rx_error;
+    atomic_int rx_waiting;
+    atomic_uint_least64_t rx_dropped;
+    atomic_uint_least64_t rx_high_water;
+    int64_t dropped_packets;
+    int64_t fifo_high_water;
+
     int64_t bitrate; /* number of bits to send per second */
     int64_t burst_bits;
+    int send_batch;
+    int txtime;
+    int txtime_lookahead;
+    int64_t txtime_offset; /* SO_TXTIME clock minus av_gettime_relative(), in ns */
     int close_req;
 #if HAVE_PTHREAD_CANCEL
     pthread_t circular_buffer_thread;
@@ -126,6 +173,9 @@ static const AVOption options[] = {
     { "buffer_size",    "System data size (in bytes)",                     OFFSET(buffer_size),    AV_OPT_TYPE_INT,    { .i64 = -1 },    -1, INT_MAX, .flags = D|E },
     { "bitrate",        "Bits to send per second",                         OFFSET(bitrate),        AV_OPT_TYPE_INT64,  { .i64 = 0  },     0, INT64_MAX, .flags = E },
     { "burst_bits",     "Max length of bursts in bits (when using bitrate)", OFFSET(burst_bits),   AV_OPT_TYPE_INT64,  { .i64 = 0  },     0, INT64_MAX, .flags = E },
+    { "send_batch",     "Max number of due packets sent per system call (when using bitrate)", OFFSET(send_batch), AV_OPT_TYPE_INT, { .i64 = UDP_TX_BATCH }, 1, UDP_TX_BATCH, .flags = E },
+    { "txtime",         "Let the kernel pace packets using SO_TXTIME deadlines (when using bitrate)", OFFSET(txtime), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
+    { "txtime_lookahead", "How long before their deadline packets are handed to the kernel, in microseconds", OFFSET(txtime_lookahead), AV_OPT_TYPE_INT, { .i64 = 2000 }, 0, INT_MAX, E },
     { "localport",      "Local port",                                      OFFSET(local_port),     AV_OPT_TYPE_INT,    { .i64 = -1 },    -1, INT_MAX, D|E },
     { "local_port",     "Local port",                                      OFFSET(local_port),     AV_OPT_TYPE_INT,    { .i64 = -1 },    -1, INT_MAX, .flags = D|E },
     { "localaddr",      "Local address",                                   OFFSET(localaddr),      AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
@@ -138,6 +188,8 @@ static const AVOption options[] = {
     { "connect",        "set if connect() should be called on socket",     OFFSET(is_connected),   AV_OPT_TYPE_BOOL,   { .i64 =  0 },     0, 1,       .flags = D|E },
     { "fifo_size",      "set the UDP receiving circular buffer size, expressed as a number of packets with size of 188 bytes", OFFSET(circular_buffer_size), AV_OPT_TYPE_INT, {.i64 = 7*4096}, 0, INT_MAX, D },
     { "overrun_nonfatal", "survive in case of UDP receiving circular buffer overrun", OFFSET(overrun_nonfatal), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,    D },
+    { "dropped_packets", "number of packets dropped on UDP receiving circular buffer overrun", OFFSET(dropped_packets), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, D|AV_OPT_FLAG_EXPORT|AV_OPT_FLAG_READONLY },
+    { "fifo_high_water", "highest fill level of the UDP receiving circular buffer, in bytes", OFFSET(fifo_high_water), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, D|AV_OPT_FLAG_EXPORT|AV_OPT_FLAG_READONLY },
     { "timeout",        "set raise error timeout, in microseconds (only in read mode)",OFFSET(timeout),         AV_OPT_TYPE_INT,  {.i64 = 0}, 0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
@@ -481,67 +533,252 @@ static int udp_get_file_handle(URLContext *h)
 }
 
 #if HAVE_PTHREAD_CANCEL
+#define RX_WRAP UINT32_MAX /* ring record telling the reader to wrap around */
+
+/* Receive up to UDP_RX_BATCH datagrams, waiting for the first one. */
+static int udp_recv_batch(UDPContext *s, int *len, struct sockaddr_storage *addr)
+{
+#if HAVE_RECVMMSG
+    struct mmsghdr msg[UDP_RX_BATCH];
+    struct iovec iov[UDP_RX_BATCH];
+    int i, ret;
+
+    for (i = 0; i < UDP_RX_BATCH; i++) {
+        iov[i].iov_base = s->rx_batch + i * UDP_MAX_PKT_SIZE;
+        iov[i].iov_len  = UDP_MAX_PKT_SIZE;
+        memset(&msg[i], 0, sizeof(msg[i]));
+        msg[i].msg_hdr.msg_name    = &addr[i];
+        msg[i].msg_hdr.msg_namelen = sizeof(addr[i]);
+        msg[i].msg_hdr.msg_iov     = &iov[i];
+        msg[i].msg_hdr.msg_iovlen  = 1;
+    }
+    ret = recvmmsg(s->udp_fd, msg, UDP_RX_BATCH, MSG_WAITFORONE, NULL);
+    if (ret < 0)
+        return ff_neterrno();
+    for (i = 0; i < ret; i++)
+        len[i] = msg[i].msg_len;
+    return ret;
+#else
+    socklen_t addr_len = sizeof(*addr);
+    int ret = recvfrom(s->udp_fd, s->rx_batch, UDP_MAX_PKT_SIZE, 0,
+                       (struct sockaddr *)addr, &addr_len);
+    if (ret < 0)
+        return ff_neterrno();
+    len[0] = ret;
+    return 1;
+#endif
+}
+
+/* Called by the receiving thread only. */
+static int rx_ring_write(UDPContext *s, const uint8_t *data, int len)
+{
+    uint64_t head = atomic_load_explicit(&s->rx_head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&s->rx_tail, memory_order_acquire);
+    unsigned pos  = head % s->rx_ring_size;
+    unsigned need = 4 + FFALIGN(len, 4);
+    unsigned skip = s->rx_ring_size - pos < need ? s->rx_ring_size - pos : 0;
+
+    if (head + skip + need - tail > s->rx_ring_size)
+        return AVERROR(ENOSPC);
+    if (skip) {
+        AV_WN32(s->rx_ring + pos, RX_WRAP);
+        pos = 0;
+    }
+    AV_WN32(s->rx_ring + pos, len);
+    memcpy(s->rx_ring + pos + 4, data, len);
+    head += skip + need;
+    atomic_store(&s->rx_head, head);
+
+    if (head - tail > atomic_load_explicit(&s->rx_high_water, memory_order_relaxed))
+        atomic_store_explicit(&s->rx_high_water, head - tail, memory_order_relaxed);
+    return 0;
+}
+
+/* Called by udp_read() only. */
+static int rx_ring_read(URLContext *h, uint8_t *buf, int size)
+{
+    UDPContext *s = h->priv_data;
+    uint64_t tail = atomic_load_explicit(&s->rx_tail, memory_order_relaxed);
+    uint64_t head = atomic_load(&s->rx_head);
+    int ret = AVERROR(EAGAIN);
+
+    while (tail != head) {
+        unsigned pos = tail % s->rx_ring_size;
+        uint32_t len = AV_RN32(s->rx_ring + pos);
+
+        if (len == RX_WRAP) {
+            tail += s->rx_ring_size - pos;
+            continue;
+        }
+        if (len > size) {
+            av_log(h, AV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
+            ret = size;
+        } else {
+            ret = len;
+        }
+        memcpy(buf, s->rx_ring + pos + 4, ret);
+        tail += 4 + FFALIGN(len, 4);
+        break;
+    }
+    atomic_store_explicit(&s->rx_tail, tail, memory_order_release);
+    return ret;
+}
+
+/* Wake up udp_read() if it is waiting for data. */
+static void rx_wake(UDPContext *s)
+{
+    if (atomic_load(&s->rx_waiting)) {
+        pthread_mutex_lock(&s->mutex);
+        pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+    }
+}
+
 static void *circular_buffer_task_rx( void *_URLContext)
 {
     URLContext *h = _URLContext;
     UDPContext *s = h->priv_data;
+    struct sockaddr_storage addr[UDP_RX_BATCH];
+    int len[UDP_RX_BATCH];
     int old_cancelstate;
+    int overrun = 0;
+    int err = 0;
 
     pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
-    pthread_mutex_lock(&s->mutex);
     if (ff_socket_nonblock(s->udp_fd, 0) < 0) {
         av_log(h, AV_LOG_ERROR, "Failed to set blocking mode");
-        s->circular_buffer_error = AVERROR(EIO);
+        err = AVERROR(EIO);
         goto end;
     }
     while(1) {
-        int len;
-        struct sockaddr_storage addr;
-        socklen_t addr_len = sizeof(addr);
+        int i, n;
 
-        pthread_mutex_unlock(&s->mutex);
         /* Blocking operations are always cancellation points;
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
-        len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
+        n = udp_recv_batch(s, len, addr);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
-        pthread_mutex_lock(&s->mutex);
-        if (len < 0) {
-            if (ff_neterrno() != AVERROR(EAGAIN) && ff_neterrno() != AVERROR(EINTR)) {
-                s->circular_buffer_error = ff_neterrno();
+        if (n < 0) {
+            if (n != AVERROR(EAGAIN) && n != AVERROR(EINTR)) {
+                err = n;
                 goto end;
             }
             continue;
         }
-        if (ff_ip_check_source_lists(&addr, &s->filters))
-            continue;
-        AV_WL32(s->tmp, len);
 
-        if (av_fifo_can_write(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
+        for (i = 0; i < n; i++) {
+            if (ff_ip_check_source_lists(&addr[i], &s->filters))
                 continue;
-            } else {
+            if (rx_ring_write(s, s->rx_batch + i * UDP_MAX_PKT_SIZE, len[i]) >= 0) {
+                overrun = 0;
+                continue;
+            }
+            /* No Space left */
+            if (!s->overrun_nonfatal) {
                 av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
                         "To avoid, increase fifo_size URL option. "
                         "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
+                err = AVERROR(EIO);
                 goto end;
             }
+            if (!overrun)
+                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                        "Surviving due to overrun_nonfatal option\n");
+            overrun = 1;
+            atomic_fetch_add_explicit(&s->rx_dropped, 1, memory_order_relaxed);
         }
-        av_fifo_write(s->fifo, s->tmp, len + 4);
-        pthread_cond_signal(&s->cond);
+        rx_wake(s);
     }
 
 end:
-    pthread_cond_signal(&s->cond);
-    pthread_mutex_unlock(&s->mutex);
+    atomic_store(&s->rx_error, err);
+    rx_wake(s);
     return NULL;
 }
 
+/**
+ * Send nb datagrams stored back to back in buf. When SO_TXTIME is in use,
+ * each of them carries its deadline so that the kernel releases it on time.
+ */
+static int udp_send_batch(UDPContext *s, const uint8_t *buf, const int *len,
+                          const int64_t *deadline, int nb)
+{
+    int i, ret;
+#if HAVE_SENDMMSG
+    struct mmsghdr msg[UDP_TX_BATCH];
+    struct iovec iov[UDP_TX_BATCH];
+#if UDP_TXTIME
+    union {
+        char buf[CMSG_SPACE(sizeof(uint64_t))];
+        struct cmsghdr align;
+    } control[UDP_TX_BATCH];
+#endif
+
+    memset(msg, 0, nb * sizeof(*msg));
+    for (i = 0; i < nb; i++) {
+        iov[i].iov_base = (void *)buf;
+        iov[i].iov_len  = len[i];
+        buf += len[i];
+        msg[i].msg_hdr.msg_iov    = &iov[i];
+        msg[i].msg_hdr.msg_iovlen = 1;
+        if (!s->is_connected) {
+            msg[i].msg_hdr.msg_name    = &s->dest_addr;
+            msg[i].msg_hdr.msg_namelen = s->dest_addr_len;
+        }
+#if UDP_TXTIME
+        if (s->txtime) {
+            uint64_t txtime = deadline[i] * 1000 + s->txtime_offset;
+            struct cmsghdr *cmsg;
+
+            msg[i].msg_hdr.msg_control    = control[i].buf;
+            msg[i].msg_hdr.msg_controllen = sizeof(control[i].buf);
+            cmsg = CMSG_FIRSTHDR(&msg[i].msg_hdr);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type  = SCM_TXTIME;
+            cmsg->cmsg_len   = CMSG_LEN(sizeof(txtime));
+            memcpy(CMSG_DATA(cmsg), &txtime, sizeof(txtime));
+        }
+#endif
+    }
+
+    for (i = 0; i < nb;) {
+        ret = sendmmsg(s->udp_fd, msg + i, nb - i, 0);
+        if (ret < 0) {
+            ret = ff_neterrno();
+            if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                return ret;
+            continue;
+        }
+        i += ret;
+    }
+#else
+    for (i = 0; i < nb; i++) {
+        const uint8_t *p = buf;
+        int size = len[i];
+
+        buf += len[i];
+        while (size) {
+            if (!s->is_connected) {
+                ret = sendto (s->udp_fd, p, size, 0,
+                            (struct sockaddr *) &s->dest_addr,
+                            s->dest_addr_len);
+            } else
+                ret = send(s->udp_fd, p, size, 0);
+            if (ret >= 0) {
+                size -= ret;
+                p    += ret;
+            } else {
+                ret = ff_neterrno();
+                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                    return ret;
+            }
+        }
+    }
+#endif
+    return 0;
+}
+
 static void *circular_buffer_task_tx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -551,6 +788,11 @@ static void *circular_buffer_task_tx( void *_URLContext)
     int64_t sent_bits = 0;
     int64_t burst_interval = s->bitrate ? (s->burst_bits * 1000000 / s->bitrate) : 0;
     int64_t max_delay = s->bitrate ?  ((int64_t)h->max_packet_size * 8 * 1000000 / s->bitrate + 1) : 0;
+    /* with SO_TXTIME the kernel does the final pacing, so packets can be
+     * handed over a little before they are due */
+    int64_t lookahead = s->txtime ? s->txtime_lookahead : 0;
+    int64_t deadline[UDP_TX_BATCH];
+    int len[UDP_TX_BATCH];
 
     pthread_mutex_lock(&s->mutex);
 
@@ -561,74 +803,72 @@ static void *circular_buffer_task_tx( void *_URLContext)
     }
 
     for(;;) {
-        int len;
-        const uint8_t *p;
+        int n, size, ret;
         uint8_t tmp[4];
         int64_t timestamp;
 
-        len = av_fifo_can_read(s->fifo);
-
-        while (len<4) {
+        while (av_fifo_can_read(s->fifo) < 4) {
             if (s->close_req)
                 goto end;
             pthread_cond_wait(&s->cond, &s->mutex);
-            len = av_fifo_can_read(s->fifo);
         }
 
-        av_fifo_read(s->fifo, tmp, 4);
-        len = AV_RL32(tmp);
-
-        av_assert0(len >= 0);
-        av_assert0(len <= sizeof(s->tmp));
-
-        av_fifo_read(s->fifo, s->tmp, len);
-
-        pthread_mutex_unlock(&s->mutex);
-
         if (s->bitrate) {
             timestamp = av_gettime_relative();
-            if (timestamp < target_timestamp) {
-                int64_t delay = target_timestamp - timestamp;
+            if (timestamp < target_timestamp - lookahead) {
+                int64_t delay = target_timestamp - lookahead - timestamp;
                 if (delay > max_delay) {
                     delay = max_delay;
-                    start_timestamp = timestamp + delay;
+                    start_timestamp = target_timestamp = timestamp + lookahead + delay;
                     sent_bits = 0;
                 }
+                pthread_mutex_unlock(&s->mutex);
                 av_usleep(delay);
+                pthread_mutex_lock(&s->mutex);
             } else {
                 if (timestamp - burst_interval > target_timestamp) {
-                    start_timestamp = timestamp - burst_interval;
+                    start_timestamp = target_timestamp = timestamp - burst_interval;
                     sent_bits = 0;
                 }
             }
-            sent_bits += len * 8;
-            target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
         }
 
-        p = s->tmp;
-        while (len) {
-            int ret;
-            av_assert0(len > 0);
-            if (!s->is_connected) {
-                ret = sendto (s->udp_fd, p, len, 0,
-                            (struct sockaddr *) &s->dest_addr,
-                            s->dest_addr_len);
-            } else
-                ret = send(s->udp_fd, p, len, 0);
-            if (ret >= 0) {
-                len -= ret;
-                p   += ret;
-            } else {
-                ret = ff_neterrno();
-                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
-                    pthread_mutex_lock(&s->mutex);
-                    s->circular_buffer_error = ret;
-                    pthread_mutex_unlock(&s->mutex);
-                    return NULL;
-                }
+        /* The head of the queue is due now. Send it together with the
+         * packets following it which are due as well, which happens after
+         * oversleeping or when bursts are allowed. */
+        timestamp = av_gettime_relative();
+        for (n = 0, size = 0; n < s->send_batch && av_fifo_can_read(s->fifo) >= 4; n++) {
+            av_fifo_peek(s->fifo, tmp, 4, 0);
+            len[n] = AV_RL32(tmp);
+
+            av_assert0(len[n] >= 0);
+            av_assert0(len[n] <= sizeof(s->tmp));
+
+            if (n && (size + len[n] > sizeof(s->tmp) ||
+                      target_timestamp - lookahead > timestamp))
+                break;
+
+            av_fifo_drain2(s->fifo, 4);
+            av_fifo_read(s->fifo, s->tmp + size, len[n]);
+            size += len[n];
+
+            deadline[n] = target_timestamp;
+            if (s->bitrate) {
+                sent_bits += len[n] * 8;
+                target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
             }
         }
 
+        pthread_mutex_unlock(&s->mutex);
+
+        ret = udp_send_batch(s, s->tmp, len, deadline, n);
+        if (ret < 0) {
+            pthread_mutex_lock(&s->mutex);
+            s->circular_buffer_error = ret;
+            pthread_mutex_unlock(&s->mutex);
+            return NULL;
+        }
+
         pthread_mutex_lock(&s->mutex);
     }
 
@@ -733,6 +973,15 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "burst_bits", p)) {
             s->burst_bits = strtoll(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "send_batch", p)) {
+            s->send_batch = av_clip(strtol(buf, NULL, 10), 1, UDP_TX_BATCH);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "txtime", p)) {
+            s->txtime = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "txtime_lookahead", p)) {
+            s->txtime_lookahead = FFMAX(strtol(buf, NULL, 10), 0);
+        }
         if (av_find_info_tag(buf, sizeof(buf), "localaddr", p)) {
             av_freep(&s->localaddr);
             s->localaddr = av_strdup(buf);
@@ -887,6 +1136,25 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             ret = ff_neterrno();
             goto fail;
         }
+        if (s->txtime && s->bitrate) {
+#if UDP_TXTIME
+            struct sock_txtime txtime = { .clockid = CLOCK_MONOTONIC };
+            struct timespec ts;
+
+            if (setsockopt(udp_fd, SOL_SOCKET, SO_TXTIME, &txtime, sizeof(txtime)) < 0 ||
+                clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+                ff_log_net_error(h, AV_LOG_WARNING, "setsockopt(SO_TXTIME)");
+                s->txtime = 0;
+            } else {
+                s->txtime_offset = ts.tv_sec * 1000000000LL + ts.tv_nsec -
+                                   av_gettime_relative() * 1000;
+            }
+#else
+            av_log(h, AV_LOG_WARNING,
+                   "'txtime' option was set but it is not supported on this build\n");
+            s->txtime = 0;
+#endif
+        }
     } else {
         /* set udp recv buffer size to the requested value (default UDP_RX_BUF_SIZE) */
         tmp = s->buffer_size;
@@ -929,10 +1197,20 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
     if ((!is_output && s->circular_buffer_size) || (is_output && s->bitrate && s->circular_buffer_size)) {
         /* start the task going */
-        s->fifo = av_fifo_alloc2(s->circular_buffer_size, 1, 0);
-        if (!s->fifo) {
-            ret = AVERROR(ENOMEM);
-            goto fail;
+        if (is_output) {
+            s->fifo = av_fifo_alloc2(s->circular_buffer_size, 1, 0);
+            if (!s->fifo) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+        } else {
+            s->rx_ring_size = FFALIGN(s->circular_buffer_size, 4);
+            s->rx_ring  = av_malloc(s->rx_ring_size);
+            s->rx_batch = av_malloc(UDP_RX_BATCH * UDP_MAX_PKT_SIZE);
+            if (!s->rx_ring || !s->rx_batch) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
         }
         ret = pthread_mutex_init(&s->mutex, NULL);
         if (ret != 0) {
@@ -967,6 +1245,8 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_freep2(&s->fifo);
+    av_freep(&s->rx_ring);
+    av_freep(&s->rx_batch);
     ff_ip_reset_filters(&s->filters);
     return ret;
 }
@@ -988,46 +1268,41 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
     struct sockaddr_storage addr;
     socklen_t addr_len = sizeof(addr);
 #if HAVE_PTHREAD_CANCEL
-    int avail, nonblock = h->flags & AVIO_FLAG_NONBLOCK;
+    int nonblock = h->flags & AVIO_FLAG_NONBLOCK;
 
-    if (s->fifo) {
-        pthread_mutex_lock(&s->mutex);
+    if (s->rx_ring) {
         do {
-            avail = av_fifo_can_read(s->fifo);
-            if (avail) { // >=size) {
-                uint8_t tmp[4];
-
-                av_fifo_read(s->fifo, tmp, 4);
-                avail = AV_RL32(tmp);
-                if(avail > size){
-                    av_log(h, AV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
-                    avail = size;
-                }
-
-                av_fifo_read(s->fifo, buf, avail);
-                av_fifo_drain2(s->fifo, AV_RL32(tmp) - avail);
-                pthread_mutex_unlock(&s->mutex);
-                return avail;
-            } else if(s->circular_buffer_error){
-                int err = s->circular_buffer_error;
-                pthread_mutex_unlock(&s->mutex);
+            /* FIXME: using the monotonic clock would be better,
+               but it does not exist on all supported platforms. */
+            int64_t t;
+            struct timespec tv;
+            int err = atomic_load(&s->rx_error);
+
+            ret = rx_ring_read(h, buf, size);
+            s->dropped_packets = atomic_load_explicit(&s->rx_dropped, memory_order_relaxed);
+            s->fifo_high_water = atomic_load_explicit(&s->rx_high_water, memory_order_relaxed);
+            if (ret != AVERROR(EAGAIN))
+                return ret;
+            if (err)
                 return err;
-            } else if(nonblock) {
-                pthread_mutex_unlock(&s->mutex);
+            if (nonblock)
                 return AVERROR(EAGAIN);
-            } else {
-                /* FIXME: using the monotonic clock would be better,
-                   but it does not exist on all supported platforms. */
-                int64_t t = av_gettime() + 100000;
-                struct timespec tv = { .tv_sec  =  t / 1000000,
-                                       .tv_nsec = (t % 1000000) * 1000 };
-                int err = pthread_cond_timedwait(&s->cond, &s->mutex, &tv);
-                if (err) {
-                    pthread_mutex_unlock(&s->mutex);
-                    return AVERROR(err == ETIMEDOUT ? EAGAIN : err);
-                }
-                nonblock = 1;
-            }
+
+            t  = av_gettime() + 100000;
+            tv = (struct timespec){ .tv_sec  =  t / 1000000,
+                                    .tv_nsec = (t % 1000000) * 1000 };
+            /* the receiving thread only signals when rx_waiting is set,
+             * check the ring again once it is */
+            pthread_mutex_lock(&s->mutex);
+            atomic_store(&s->rx_waiting, 1);
+            if (atomic_load(&s->rx_head) == atomic_load_explicit(&s->rx_tail, memory_order_relaxed) &&
+                !atomic_load(&s->rx_error))
+                err = pthread_cond_timedwait(&s->cond, &s->mutex, &tv);
+            atomic_store(&s->rx_waiting, 0);
+            pthread_mutex_unlock(&s->mutex);
+            if (err)
+                return AVERROR(err == ETIMEDOUT ? EAGAIN : err);
+            nonblock = 1;
         } while(1);
     }
 #endif
@@ -1134,8 +1409,15 @@ static int udp_close(URLContext *h)
         pthread_cond_destroy(&s->cond);
     }
 #endif
+    if (s->rx_ring)
+        av_log(h, AV_LOG_VERBOSE, "%"PRIu64" packets dropped, circular buffer "
+               "high water mark %"PRIu64" of %u bytes\n",
+               (uint64_t)atomic_load(&s->rx_dropped),
+               (uint64_t)atomic_load(&s->rx_high_water), s->rx_ring_size);
     closesocket(s->udp_fd);
     av_fifo_freep2(&s->fifo);
+    av_freep(&s->rx_ring);
+    av_freep(&s->rx_batch);
     ff_ip_reset_filters(&s->filters);
     return 0;
 }
@@ -0,0 +1,363 @@
+/*
+ * Concurrent upload of muxer output files
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+#include "avio_internal.h"
+#include "internal.h"
+#if CONFIG_HTTP_PROTOCOL
+#include "http.h"
+#endif
+#include "uploadpool.h"
+#include "url.h"
+
+#if HAVE_THREADS
+
+#define RETRY_DELAY    200000 ///< delay before the first retry, in microseconds
+#define MAX_WAITING         4 ///< maximum number of waiting files per worker
+
+typedef struct UploadJob {
+    struct UploadJob *next;
+    char *url;
+    char *final_url;
+    uint8_t *data;
+    int size;
+    AVDictionary *options;
+    int group;
+    int ordered;
+    int running;
+} UploadJob;
+
+typedef struct UploadWorker {
+    UploadPool *pool;
+    pthread_t thread;
+    AVIOContext *pb;
+} UploadWorker;
+
+struct UploadPool {
+    AVFormatContext *s;
+    UploadWorker *workers;
+    int nb_workers;
+    int max_retries;
+    int persistent;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UploadJob *jobs;            ///< queued and running files, in submission order
+    int nb_waiting;
+    int error;
+    int stop;
+};
+
+static void free_job(UploadJob *job)
+{
+    av_freep(&job->url);
+    av_freep(&job->final_url);
+    av_freep(&job->data);
+    av_dict_free(&job->options);
+    av_free(job);
+}
+
+static UploadJob *next_job(UploadPool *pool)
+{
+    for (UploadJob *job = pool->jobs; job; job = job->next) {
+        if (job->running)
+            continue;
+        if (job->ordered) {
+            UploadJob *prev = pool->jobs;
+            while (prev != job && job->group >= 0 && prev->group != job->group)
+                prev = prev->next;
+            if (prev != job)
+                continue;
+        }
+        return job;
+    }
+    return NULL;
+}
+
+static void remove_job(UploadPool *pool, UploadJob *job)
+{
+    UploadJob **p = &pool->jobs;
+
+    while (*p != job)
+        p = &(*p)->next;
+    *p = job->next;
+}
+
+static int upload(UploadWorker *w, UploadJob *job)
+{
+    UploadPool *pool = w->pool;
+    AVFormatContext *s = pool->s;
+    int http = pool->persistent && ff_is_http_proto(job->url);
+    int ret, err;
+
+#if CONFIG_HTTP_PROTOCOL
+    if (w->pb && http) {
+        ret = ff_http_do_new_request(ffio_geturlcontext(w->pb), job->url);
+    } else
+#endif
+    {
+        AVDictionary *options = NULL;
+
+        /* What the default io_open does, without calling back into the
+         * muxer context from this thread. */
+        avio_closep(&w->pb);
+        av_log(s, AV_LOG_INFO, "Opening '%s' for writing\n", job->url);
+        av_dict_copy(&options, job->options, 0);
+        ret = ffio_open_whitelist(&w->pb, job->url, AVIO_FLAG_WRITE,
+                                  &s->interrupt_callback, &options,
+                                  s->protocol_whitelist, s->protocol_blacklist);
+        av_dict_free(&options);
+    }
+    if (ret < 0) {
+        avio_closep(&w->pb);
+        return ret;
+    }
+
+    avio_write(w->pb, job->data, job->size);
+    avio_flush(w->pb);
+    ret = w->pb->error;
+
+#if CONFIG_HTTP_PROTOCOL
+    if (http) {
+        URLContext *h = ffio_geturlcontext(w->pb);
+        ffurl_shutdown(h, AVIO_FLAG_WRITE);
+        if (ret >= 0)
+            ret = ff_http_get_shutdown_status(h);
+        if (ret < 0)
+            avio_closep(&w->pb);
+        return ret;
+    }
+#endif
+    err = avio_closep(&w->pb);
+    if (ret >= 0 && err >= 0 && job->final_url)
+        err = ff_rename(job->url, job->final_url, s);
+    return ret < 0 ? ret : err;
+}
+
+static void *upload_worker(void *arg)
+{
+    UploadWorker *w = arg;
+    UploadPool *pool = w->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        UploadJob *job = next_job(pool);
+        int64_t delay = RETRY_DELAY;
+        int ret;
+
+        if (!job) {
+            if (pool->stop)
+                break;
+            pthread_cond_wait(&pool->cond, &pool->lock);
+            continue;
+        }
+        job->running = 1;
+        pool->nb_waiting--;
+        pthread_cond_broadcast(&pool->cond);
+        pthread_mutex_unlock(&pool->lock);
+
+        for (int attempt = 0;; attempt++) {
+            ret = upload(w, job);
+            if (ret >= 0 || attempt >= pool->max_retries ||
+                ff_check_interrupt(&pool->s->interrupt_callback))
+                break;
+            av_log(pool->s, AV_LOG_WARNING, "Upload of '%s' failed: %s, "
+                   "retrying in %"PRId64" ms\n", job->url, av_err2str(ret),
+                   delay / 1000);
+            av_usleep(delay);
+            delay *= 2;
+        }
+        if (ret < 0)
+            av_log(pool->s, AV_LOG_ERROR, "Failed to upload '%s'\n", job->url);
+
+        pthread_mutex_lock(&pool->lock);
+        remove_job(pool, job);
+        if (ret < 0 && !pool->error)
+            pool->error = ret;
+        pthread_cond_broadcast(&pool->cond);
+        free_job(job);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    avio_closep(&w->pb);
+    return NULL;
+}
+
+int ff_upload_pool_init(UploadPool **ppool, AVFormatContext *s, int nb_workers,
+                        int max_retries, int persistent)
+{
+    UploadPool *pool;
+    int ret;
+
+    if (!ff_format_io_is_default(s)) {
+        av_log(s, AV_LOG_WARNING, "Upload threads are not supported with "
+               "custom I/O callbacks\n");
+        return AVERROR(ENOSYS);
+    }
+
+    pool = av_mallocz(sizeof(*pool));
+    if (!pool)
+        return AVERROR(ENOMEM);
+    pool->workers = av_calloc(nb_workers, sizeof(*pool->workers));
+    if (!pool->workers) {
+        av_free(pool);
+        return AVERROR(ENOMEM);
+    }
+    pool->s           = s;
+    pool->max_retries = max_retries;
+    pool->persistent  = persistent;
+
+    if ((ret = pthread_mutex_init(&pool->lock, NULL))) {
+        av_free(pool->workers);
+        av_free(pool);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&pool->cond, NULL))) {
+        pthread_mutex_destroy(&pool->lock);
+        av_free(pool->workers);
+        av_free(pool);
+        return AVERROR(ret);
+    }
+    *ppool = pool;
+
+    for (; pool->nb_workers < nb_workers; pool->nb_workers++) {
+        UploadWorker *w = &pool->workers[pool->nb_workers];
+        w->pool = pool;
+        if ((ret = pthread_create(&w->thread, NULL, upload_worker, w))) {
+            ff_upload_pool_free(ppool);
+            return AVERROR(ret);
+        }
+    }
+    return 0;
+}
+
+int ff_upload_pool_submit(UploadPool *pool, const char *url,
+                          const char *final_url, uint8_t *data, int size,
+                          AVDictionary **options, int group, int ordered)
+{
+    UploadJob *job, **p;
+    int ret;
+
+    job = av_mallocz(sizeof(*job));
+    if (!job || !(job->url = av_strdup(url)) ||
+        final_url && !(job->final_url = av_strdup(final_url))) {
+        if (job)
+            av_free(job->url);
+        av_free(job);
+        av_free(data);
+        av_dict_free(options);
+        return AVERROR(ENOMEM);
+    }
+    job->data    = data;
+    job->size    = size;
+    job->options = *options;
+    job->group   = group;
+    job->ordered = ordered;
+    *options     = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->nb_waiting >= MAX_WAITING * pool->nb_workers)
+        pthread_cond_wait(&pool->cond, &pool->lock);
+    p = &pool->jobs;
+    while (*p)
+        p = &(*p)->next;
+    *p = job;
+    pool->nb_waiting++;
+    ret = pool->error;
+    pool->error = 0;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    return ret;
+}
+
+int ff_upload_pool_flush(UploadPool *pool)
+{
+    int ret;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->jobs)
+        pthread_cond_wait(&pool->cond, &pool->lock);
+    ret = pool->error;
+    pool->error = 0;
+    pthread_mutex_unlock(&pool->lock);
+
+    return ret;
+}
+
+void ff_upload_pool_free(UploadPool **ppool)
+{
+    UploadPool *pool = *ppool;
+
+    if (!pool)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->nb_workers; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+
+    while (pool->jobs) {
+        UploadJob *job = pool->jobs;
+        pool->jobs = job->next;
+        free_job(job);
+    }
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    av_freep(&pool->workers);
+    av_freep(ppool);
+}
+
+#else
+
+int ff_upload_pool_init(UploadPool **pool, AVFormatContext *s, int nb_workers,
+                        int max_retries, int persistent)
+{
+    av_log(s, AV_LOG_WARNING, "Upload threads are not supported without "
+           "threading\n");
+    return AVERROR(ENOSYS);
+}
+
+int ff_upload_pool_submit(UploadPool *pool, const char *url,
+                          const char *final_url, uint8_t *data, int size,
+                          AVDictionary **options, int group, int ordered)
+{
+    av_free(data);
+    av_dict_free(options);
+    return AVERROR(ENOSYS);
+}
+
+int ff_upload_pool_flush(UploadPool *pool)
+{
+    return 0;
+}
+
+void ff_upload_pool_free(UploadPool **pool)
+{
+}
+
+#endif /* HAVE_THREADS */
@@ -0,0 +1,84 @@
+/*
+ * Concurrent upload of muxer output files
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_UPLOADPOOL_H
+#define AVFORMAT_UPLOADPOOL_H
+
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+#include "avformat.h"
+
+/**
+ * A pool of worker threads writing complete files (segments, playlists)
+ * to their destination, each worker with its own connection. The files
+ * are opened with the protocol whitelist of the muxer context, which must
+ * use the default I/O callbacks.
+ */
+typedef struct UploadPool UploadPool;
+
+/**
+ * Create an upload pool.
+ *
+ * @param s           muxer context used to open the outputs and for logging
+ * @param nb_workers  number of concurrent uploads
+ * @param max_retries number of times a failed upload is retried, with an
+ *                    exponentially growing delay between attempts
+ * @param persistent  reuse the HTTP connection of a worker for its next upload
+ * @return 0 on success, a negative AVERROR code on failure; AVERROR(ENOSYS)
+ *         when built without thread support or when s has custom I/O
+ *         callbacks, after logging why
+ */
+int ff_upload_pool_init(UploadPool **pool, AVFormatContext *s, int nb_workers,
+                        int max_retries, int persistent);
+
+/**
+ * Queue a file for upload. Blocks while too many files are waiting.
+ *
+ * Files marked as ordered are only started once all the files of the same
+ * group queued before them have been uploaded, e.g. a playlist after the
+ * segments it references. Ordered files of a negative group wait for all
+ * the files queued before them.
+ *
+ * @param final_url if not NULL, the local file url is renamed to it once
+ *                  written, e.g. to replace a playlist atomically
+ * @param data      file contents, allocated with av_malloc(); ownership is
+ *                  transferred to the pool, even on failure
+ * @param options   options for opening the file; ownership is transferred
+ *                  to the pool
+ * @return 0 on success, or the error of a previously failed upload
+ */
+int ff_upload_pool_submit(UploadPool *pool, const char *url,
+                          const char *final_url, uint8_t *data, int size,
+                          AVDictionary **options, int group, int ordered);
+
+/**
+ * Wait until all the queued files have been uploaded.
+ *
+ * @return 0 on success, or the error of a failed upload
+ */
+int ff_upload_pool_flush(UploadPool *pool);
+
+/**
+ * Finish all pending uploads and free the pool.
+ */
+void ff_upload_pool_free(UploadPool **pool);
+
+#endif /* AVFORMAT_UPLOADPOOL_H */
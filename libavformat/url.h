@@ -48,6 +48,9 @@ typedef struct URLContext {
     const char *protocol_whitelist;
     const char *protocol_blacklist;
     int min_packet_size;        /**< if non zero, the stream is packetized with this min packet size */
+    int async_write;            /**< write the data of the AVIOContext from a background thread */
+    int async_write_size;       /**< size of the AVIOContext buffer when writing asynchronously, 0 for the default */
+    int64_t async_write_budget; /**< maximum amount of data pending for the background thread, 0 for the default */
 } URLContext;
 
 typedef struct URLProtocol {
@@ -43,8 +43,11 @@
 #include "avformat.h"
 #include "avio_internal.h"
 #include "internal.h"
+#include "os_support.h"
+#include "url.h"
 #if CONFIG_NETWORK
 #include "network.h"
+#include "http.h"
 #endif
 
 #include "libavutil/ffversion.h"
@@ -1314,6 +1317,10 @@ int avformat_network_init(void)
 int avformat_network_deinit(void)
 {
 #if CONFIG_NETWORK
+#if CONFIG_HTTP_PROTOCOL || CONFIG_HTTPPROXY_PROTOCOL || CONFIG_HTTPS_PROTOCOL
+    ff_http_close_pool();
+#endif
+    ff_tls_clear_sessions();
     ff_network_close();
     ff_tls_deinit();
 #endif
@@ -2036,6 +2043,69 @@ const char *av_disposition_to_string(int disposition)
     return NULL;
 }
 
+int64_t ff_format_insert_space(AVFormatContext *s, int64_t pos,
+                               int64_t min_size, int64_t max_size)
+{
+    URLContext *h = s->pb ? ffio_geturlcontext(s->pb) : NULL;
+    int fd = h ? ffurl_get_file_handle(h) : -1;
+    int64_t start, size;
+    uint8_t *buf = NULL;
+    AVDictionary *opts = NULL;
+    AVIOContext *read_pb;
+    int align, ret;
+
+    if (fd < 0 || (align = ff_file_insert_space_align(fd)) < 0)
+        return AVERROR(ENOSYS);
+    /* the space has to be inserted at a block boundary, the data between it
+     * and pos is moved along and written back before the space */
+    start = pos - pos % align;
+    size  = FFALIGN(min_size + pos - start, (int64_t)align);
+    if (size > max_size)
+        return AVERROR(ENOSYS);
+    avio_flush(s->pb);
+    if (s->pb->error < 0)
+        return s->pb->error;
+
+    /* read that data before changing the output, so that nothing can fail
+     * but writing once it is changed */
+    if (start < pos) {
+        if (!(buf = av_malloc(pos - start)))
+            return AVERROR(ENOMEM);
+        if ((ret = ffio_copy_url_options(s->pb, &opts)) >= 0)
+            ret = s->io_open(s, &read_pb, s->url, AVIO_FLAG_READ, &opts);
+        av_dict_free(&opts);
+        if (ret < 0) {
+            av_log(s, AV_LOG_DEBUG, "Cannot re-open %s to insert space\n", s->url);
+            goto fallback;
+        }
+        if ((ret = avio_seek(read_pb, start, SEEK_SET)) >= 0)
+            ret = ffio_read_size(read_pb, buf, pos - start);
+        ff_format_io_close(s, &read_pb);
+        if (ret < 0)
+            goto fallback;
+    }
+
+    if ((ret = ff_file_insert_space(fd, start, size)) < 0) {
+        av_log(s, AV_LOG_DEBUG, "Cannot insert space in the output: %s\n",
+               av_err2str(ret));
+        goto fallback;
+    }
+    if (start < pos) {
+        avio_seek(s->pb, start, SEEK_SET);
+        avio_write(s->pb, buf, pos - start);
+        avio_flush(s->pb);
+        av_free(buf);
+        if (s->pb->error < 0)
+            return s->pb->error;
+    }
+    return size;
+
+fallback:
+    /* nothing was changed, the caller can fall back to moving the data */
+    av_free(buf);
+    return AVERROR(ENOSYS);
+}
+
 int ff_format_shift_data(AVFormatContext *s, int64_t read_start, int shift_size)
 {
     int ret;
@@ -0,0 +1,216 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * HTTP parallel range requests test, against a local server serving ranges
+ * of a generated file
+ */
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h" // not public
+#include "libavformat/avformat.h"
+
+#define FILE_SIZE   (1024 * 1024 + 1234)
+#define RANGE_SIZE  65536
+
+static uint8_t file_data[FILE_SIZE];
+
+static atomic_int stop;
+static atomic_int nb_range_requests;
+static atomic_int foreign_interrupt_calls;
+static pthread_t reader_thread;
+
+static int server_interrupt_cb(void *opaque)
+{
+    return atomic_load(&stop);
+}
+
+static int reader_interrupt_cb(void *opaque)
+{
+    if (!pthread_equal(pthread_self(), reader_thread))
+        atomic_fetch_add(&foreign_interrupt_calls, 1);
+    return 0;
+}
+
+static void *serve_client(void *arg)
+{
+    AVIOContext *pb = arg;
+    char req[4096] = "";
+    int len = 0;
+
+    for (;;) {
+        int64_t start = 0, end = FILE_SIZE - 1;
+        char *hdr_end, *range;
+        int ret;
+
+        while (!(hdr_end = strstr(req, "\r\n\r\n"))) {
+            if (len == sizeof(req) - 1)
+                goto end;
+            ret = avio_read_partial(pb, req + len, sizeof(req) - 1 - len);
+            if (ret <= 0)
+                goto end;
+            len += ret;
+            req[len] = 0;
+        }
+        *hdr_end = 0;
+        if ((range = av_stristr(req, "\r\nRange: bytes="))) {
+            char *p;
+            start = strtoll(range + 15, &p, 10);
+            if (*p == '-' && p[1] >= '0' && p[1] <= '9') {
+                end = strtoll(p + 1, NULL, 10);
+                atomic_fetch_add(&nb_range_requests, 1);
+            }
+        }
+        if (start < 0 || start >= FILE_SIZE || end < start || end >= FILE_SIZE) {
+            avio_printf(pb, "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                        "Content-Range: bytes */%d\r\nContent-Length: 0\r\n\r\n",
+                        FILE_SIZE);
+        } else {
+            avio_printf(pb, "HTTP/1.1 %s\r\nAccept-Ranges: bytes\r\n"
+                        "Content-Range: bytes %"PRId64"-%"PRId64"/%d\r\n"
+                        "Content-Length: %"PRId64"\r\n\r\n",
+                        range ? "206 Partial Content" : "200 OK",
+                        start, end, FILE_SIZE, end - start + 1);
+            avio_write(pb, file_data + start, end - start + 1);
+        }
+        avio_flush(pb);
+        if (pb->error)
+            break;
+        len -= hdr_end + 4 - req;
+        memmove(req, hdr_end + 4, len + 1);
+    }
+end:
+    avio_closep(&pb);
+    return NULL;
+}
+
+static void *serve(void *arg)
+{
+    AVIOContext *server = arg;
+    pthread_t *clients = NULL;
+    int nb_clients = 0;
+
+    for (;;) {
+        AVIOContext *client;
+        if (avio_accept(server, &client) < 0)
+            break;
+        if (av_reallocp_array(&clients, nb_clients + 1, sizeof(*clients)) < 0 ||
+            pthread_create(&clients[nb_clients], NULL, serve_client, client)) {
+            avio_closep(&client);
+            break;
+        }
+        nb_clients++;
+    }
+    for (int i = 0; i < nb_clients; i++)
+        pthread_join(clients[i], NULL);
+    av_free(clients);
+    return NULL;
+}
+
+static int check_read(AVIOContext *pb, int64_t pos, int size)
+{
+    static uint8_t buf[FILE_SIZE];
+    int ret;
+
+    if (avio_seek(pb, pos, SEEK_SET) != pos) {
+        fprintf(stderr, "Seeking to %"PRId64" failed\n", pos);
+        return -1;
+    }
+    if ((ret = avio_read(pb, buf, size)) != FFMIN(size, FILE_SIZE - pos)) {
+        fprintf(stderr, "Reading %d bytes at %"PRId64" returned %d\n", size, pos, ret);
+        return -1;
+    }
+    if (memcmp(buf, file_data + pos, ret)) {
+        fprintf(stderr, "Wrong data read at %"PRId64"\n", pos);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const int64_t reads[][2] = {
+        { 0, FILE_SIZE }, { 500000, 100000 }, { 70000, 300000 },
+        { FILE_SIZE - 5000, 10000 }, { 3 * RANGE_SIZE - 7, 2 * RANGE_SIZE },
+        { 900000, 4096 }, { 100, RANGE_SIZE },
+    };
+    const AVIOInterruptCB server_cb = { server_interrupt_cb, NULL };
+    const AVIOInterruptCB reader_cb = { reader_interrupt_cb, NULL };
+    AVIOContext *server = NULL, *pb = NULL;
+    AVDictionary *opts = NULL;
+    pthread_t server_thread;
+    char url[64];
+    int port, ret = 1;
+
+    for (int i = 0; i < FILE_SIZE; i++)
+        file_data[i] = i * 7 ^ i >> 9;
+
+    avformat_network_init();
+    reader_thread = pthread_self();
+
+    for (port = 31550; port < 31650; port++) {
+        snprintf(url, sizeof(url), "tcp://127.0.0.1:%d?listen=2", port);
+        if (avio_open2(&server, url, AVIO_FLAG_READ_WRITE, &server_cb, NULL) >= 0)
+            break;
+    }
+    if (!server) {
+        fprintf(stderr, "Cannot listen on a local port\n");
+        return 1;
+    }
+    if (pthread_create(&server_thread, NULL, serve, server)) {
+        avio_closep(&server);
+        return 1;
+    }
+
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/file", port);
+    av_dict_set(&opts, "parallel_ranges", "4", 0);
+    av_dict_set_int(&opts, "range_size", RANGE_SIZE, 0);
+    if (avio_open2(&pb, url, AVIO_FLAG_READ, &reader_cb, &opts) < 0) {
+        fprintf(stderr, "Cannot open %s\n", url);
+        goto end;
+    }
+    for (int i = 0; i < FF_ARRAY_ELEMS(reads); i++)
+        if (check_read(pb, reads[i][0], reads[i][1]) < 0)
+            goto end;
+    if (!atomic_load(&nb_range_requests)) {
+        fprintf(stderr, "No parallel range request was made\n");
+        goto end;
+    }
+    if (atomic_load(&foreign_interrupt_calls)) {
+        fprintf(stderr, "The interrupt callback was called from another thread\n");
+        goto end;
+    }
+    ret = 0;
+
+end:
+    avio_closep(&pb);
+    av_dict_free(&opts);
+    atomic_store(&stop, 1);
+    pthread_join(server_thread, NULL);
+    avio_closep(&server);
+    avformat_network_deinit();
+    return ret;
+}
@@ -0,0 +1,172 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * Probe info API test: the stream information restored from the saved
+ * probe info must match the analyzed one, and corrupted probe info must be
+ * rejected in favor of analyzing the input.
+ */
+
+#include <string.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/bprint.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/log.h"
+#include "libavutil/opt.h"
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+
+static int restored;
+
+static void log_callback(void *avcl, int level, const char *fmt, va_list vl)
+{
+    if (strstr(fmt, "restored from probe info"))
+        restored = 1;
+    av_log_default_callback(avcl, level, fmt, vl);
+}
+
+static void describe(AVBPrint *bp, const AVFormatContext *fmt_ctx)
+{
+    av_bprintf(bp, "format=%s start_time=%"PRId64" duration=%"PRId64" bit_rate=%"PRId64"\n",
+               fmt_ctx->iformat->name, fmt_ctx->start_time,
+               fmt_ctx->duration, fmt_ctx->bit_rate);
+    for (unsigned i = 0; i < fmt_ctx->nb_streams; i++) {
+        const AVStream *st = fmt_ctx->streams[i];
+        const AVCodecParameters *par = st->codecpar;
+
+        av_bprintf(bp, "stream=%u codec=%s type=%s time_base=%d/%d "
+                   "r_frame_rate=%d/%d avg_frame_rate=%d/%d "
+                   "start_time=%"PRId64" duration=%"PRId64" nb_frames=%"PRId64" "
+                   "format=%d size=%dx%d sample_rate=%d channels=%d "
+                   "frame_size=%d extradata=%d/0x%08"PRIx32"\n",
+                   i, avcodec_get_name(par->codec_id),
+                   av_get_media_type_string(par->codec_type),
+                   st->time_base.num, st->time_base.den,
+                   st->r_frame_rate.num, st->r_frame_rate.den,
+                   st->avg_frame_rate.num, st->avg_frame_rate.den,
+                   st->start_time, st->duration, st->nb_frames,
+                   par->format, par->width, par->height,
+                   par->sample_rate, par->channels, par->frame_size,
+                   par->extradata_size,
+                   av_adler32_update(1, par->extradata, par->extradata_size));
+    }
+}
+
+static int open_input(const char *filename, const uint8_t *info, int info_size,
+                      AVFormatContext **fmt_ctx)
+{
+    int ret;
+
+    if (!(*fmt_ctx = avformat_alloc_context()))
+        return AVERROR(ENOMEM);
+    if (info && (ret = av_opt_set_bin(*fmt_ctx, "probe_info", info, info_size, 0)) < 0) {
+        avformat_free_context(*fmt_ctx);
+        *fmt_ctx = NULL;
+        return ret;
+    }
+    if ((ret = avformat_open_input(fmt_ctx, filename, NULL, NULL)) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Can't open file\n");
+        return ret;
+    }
+    restored = 0;
+    if ((ret = avformat_find_stream_info(*fmt_ctx, NULL)) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Can't get stream info\n");
+        avformat_close_input(fmt_ctx);
+        return ret;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    AVFormatContext *fmt_ctx = NULL;
+    AVBPrint ref, desc;
+    uint8_t *info = NULL, *corrupt = NULL;
+    int info_size, par_offset, ret, failed = 0;
+    static const struct {
+        const char *name;
+        int offset;          ///< offset in the codec parameters of stream 0
+        uint32_t value;
+        int truncate;
+    } tests[] = {
+        { "saved" },
+        { "codec_id",        4, 0x7fffffff },
+        { "width",          40, 0xffffffff },
+        { "extradata_size", 120, 0x7fffffff },
+        { "truncated",       0, 0, 1 },
+    };
+
+    if (argc < 2) {
+        av_log(NULL, AV_LOG_ERROR, "Incorrect input\n");
+        return 1;
+    }
+    av_log_set_callback(log_callback);
+
+    av_bprint_init(&ref, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprint_init(&desc, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    if ((ret = open_input(argv[1], NULL, 0, &fmt_ctx)) < 0)
+        goto end;
+    describe(&ref, fmt_ctx);
+    ret = avformat_save_probe_info(fmt_ctx, &info, &info_size);
+    /* the codec parameters of stream 0 follow the fixed header fields, the
+     * name of the input format and the fixed fields of the stream */
+    par_offset = 12 + strlen(fmt_ctx->iformat->name) + 1 + 40 + 68;
+    avformat_close_input(&fmt_ctx);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Can't save probe info\n");
+        goto end;
+    }
+    printf("%s", ref.str);
+
+    if (!(corrupt = av_malloc(info_size))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (int i = 0; i < FF_ARRAY_ELEMS(tests); i++) {
+        int size = info_size - tests[i].truncate;
+        int expected = i == 0;
+
+        memcpy(corrupt, info, info_size);
+        if (tests[i].offset)
+            AV_WB32(corrupt + par_offset + tests[i].offset, tests[i].value);
+        if ((ret = open_input(argv[1], corrupt, size, &fmt_ctx)) < 0)
+            goto end;
+        av_bprint_clear(&desc);
+        describe(&desc, fmt_ctx);
+        avformat_close_input(&fmt_ctx);
+
+        printf("%s: %s, %s\n", tests[i].name,
+               restored ? "restored" : "analyzed",
+               strcmp(desc.str, ref.str) ? "different" : "same");
+        if (restored != expected || strcmp(desc.str, ref.str)) {
+            printf("%s", desc.str);
+            failed = 1;
+        }
+    }
+
+end:
+    av_bprint_finalize(&ref, NULL);
+    av_bprint_finalize(&desc, NULL);
+    av_free(info);
+    av_free(corrupt);
+    return ret < 0 || failed;
+}
@@ -0,0 +1,69 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+
+#include "libavcodec/avcodec.h"
+#include "libavcodec/fdctdsp.h"
+
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem_internal.h"
+
+/* Samples of bits bits, signed or not, as the encoders may feed both. */
+static void randomize_block(int16_t *block0, int16_t *block1, int bits)
+{
+    for (int i = 0; i < 64; i++) {
+        int v = (rnd() & ((2 << bits) - 1)) - (1 << bits);
+        block0[i] = block1[i] = v;
+    }
+}
+
+static void check_fdct(int bits)
+{
+    LOCAL_ALIGNED_16(int16_t, block0, [64]);
+    LOCAL_ALIGNED_16(int16_t, block1, [64]);
+    AVCodecContext avctx = {
+        .bits_per_raw_sample = bits,
+        .dct_algo            = FF_DCT_AUTO,
+    };
+    FDCTDSPContext h;
+
+    ff_fdctdsp_init(&h, &avctx);
+
+    if (check_func(h.fdct, "fdct_%d", bits)) {
+        declare_func_emms(AV_CPU_FLAG_MMX, void, int16_t *block);
+
+        for (int i = 0; i < 16; i++) {
+            randomize_block(block0, block1, bits);
+            call_ref(block0);
+            call_new(block1);
+            if (memcmp(block0, block1, sizeof(*block0) * 64))
+                fail();
+        }
+        bench_new(block1);
+    }
+}
+
+void checkasm_check_fdctdsp(void)
+{
+    check_fdct(10);
+    report("fdct");
+}
@@ -533,7 +533,11 @@ static void check_loopfilter(void)
 #undef setdx
 #undef randomize_buffers
 
-#define DST_BUF_SIZE (size * size * SIZEOF_PIXEL)
+/* Every other destination row is not 64-byte aligned and the rows are not
+ * contiguous, to catch stores outside of the block or assuming a larger
+ * alignment than 32 bytes. */
+#define DST_BUF_STRIDE (64 * SIZEOF_PIXEL + 32)
+#define DST_BUF_SIZE (64 * DST_BUF_STRIDE)
 #define SRC_BUF_STRIDE 72
 #define SRC_BUF_SIZE ((size + 7) * SRC_BUF_STRIDE * SIZEOF_PIXEL)
 #define src (buf + 3 * SIZEOF_PIXEL * (SRC_BUF_STRIDE + 1))
@@ -546,22 +550,20 @@ static void check_loopfilter(void)
             uint32_t r = rnd() & mask;                    \
             AV_WN32A(buf + k, r);                         \
         }                                                 \
-        if (op == 1) {                                    \
-            for (k = 0; k < DST_BUF_SIZE; k += 4) {       \
-                uint32_t r = rnd() & mask;                \
-                AV_WN32A(dst0 + k, r);                    \
-                AV_WN32A(dst1 + k, r);                    \
-            }                                             \
+        for (k = 0; k < DST_BUF_SIZE; k += 4) {           \
+            uint32_t r = rnd() & mask;                    \
+            AV_WN32A(dst0 + k, r);                        \
+            AV_WN32A(dst1 + k, r);                        \
         }                                                 \
     } while (0)
 
 static void check_mc(void)
 {
     LOCAL_ALIGNED_32(uint8_t, buf, [72 * 72 * 2]);
-    LOCAL_ALIGNED_32(uint8_t, dst0, [64 * 64 * 2]);
-    LOCAL_ALIGNED_32(uint8_t, dst1, [64 * 64 * 2]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [64 * (64 * 2 + 32)]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [64 * (64 * 2 + 32)]);
     VP9DSPContext dsp;
-    int op, hsize, bit_depth, filter, dx, dy;
+    int op, hsize, bit_depth, filter, dx, dy, pos, h;
     declare_func_emms(AV_CPU_FLAG_MMX | AV_CPU_FLAG_MMXEXT, void, uint8_t *dst, ptrdiff_t dst_stride,
                       const uint8_t *ref, ptrdiff_t ref_stride,
                  int h, int mx, int my);
@@ -592,17 +594,27 @@ static void check_mc(void)
                             }
                             if (check_func(dsp.mc[hsize][filter][op][dx][dy],
                                            "vp9_%s_%dbpp", str, bit_depth)) {
-                                int mx = dx ? 1 + (rnd() % 14) : 0;
-                                int my = dy ? 1 + (rnd() % 14) : 0;
-                                randomize_buffers();
-                                call_ref(dst0, size * SIZEOF_PIXEL,
-                                         src, SRC_BUF_STRIDE * SIZEOF_PIXEL,
-                                         size, mx, my);
-                                call_new(dst1, size * SIZEOF_PIXEL,
-                                         src, SRC_BUF_STRIDE * SIZEOF_PIXEL,
-                                         size, mx, my);
-                                if (memcmp(dst0, dst1, DST_BUF_SIZE))
-                                    fail();
+                                // all the subpel positions, for blocks as
+                                // high as wide and half as high (but at least
+                                // 4 rows, as processed at once by some simd)
+                                for (pos = 1; pos < 16; pos++) {
+                                    int mx = dx ? pos : 0;
+                                    int my = dy ? (dx ? 16 - pos : pos) : 0;
+
+                                    for (h = size; h >= FFMAX(size / 2, 4); h -= size / 2) {
+                                        randomize_buffers();
+                                        call_ref(dst0, DST_BUF_STRIDE,
+                                                 src, SRC_BUF_STRIDE * SIZEOF_PIXEL,
+                                                 h, mx, my);
+                                        call_new(dst1, DST_BUF_STRIDE,
+                                                 src, SRC_BUF_STRIDE * SIZEOF_PIXEL,
+                                                 h, mx, my);
+                                        if (memcmp(dst0, dst1, DST_BUF_SIZE))
+                                            fail();
+                                    }
+                                    if (!dx && !dy)
+                                        break;
+                                }
 
                                 // simd implementations for each filter of subpel
                                 // functions are identical
@@ -610,9 +622,9 @@ static void check_mc(void)
                                 // 10/12 bpp for bilin are identical
                                 if (bit_depth == 12 && filter == 3) continue;
 
-                                bench_new(dst1, size * SIZEOF_PIXEL,
+                                bench_new(dst1, DST_BUF_STRIDE,
                                           src, SRC_BUF_STRIDE * SIZEOF_PIXEL,
-                                          size, mx, my);
+                                          size, dx ? 8 : 0, dy ? 8 : 0);
                             }
                         }
                     }
@@ -21,6 +21,15 @@ fate-api-seek: $(APITESTSDIR)/api-seek-test$(EXESUF) fate-lavf-flv
 fate-api-seek: CMD = run $(APITESTSDIR)/api-seek-test$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.flv 0 720
 fate-api-seek: CMP = null
 
+FATE_API_LIBAVFORMAT-$(call ENCDEC2, MPEG4, MP2, NUT) += fate-api-probe-info
+fate-api-probe-info: $(APITESTSDIR)/api-probe-info-test$(EXESUF) fate-lavf-nut
+fate-api-probe-info: CMD = run $(APITESTSDIR)/api-probe-info-test$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.nut
+
+FATE_API_LIBAVFORMAT-$(if $(HAVE_THREADS),$(call ALLYES, HTTP_PROTOCOL TCP_PROTOCOL)) += fate-api-http-ranges
+fate-api-http-ranges: $(APITESTSDIR)/api-http-ranges-test$(EXESUF)
+fate-api-http-ranges: CMD = run $(APITESTSDIR)/api-http-ranges-test$(EXESUF)
+fate-api-http-ranges: CMP = null
+
 FATE_API-$(HAVE_THREADS) += fate-api-threadmessage
 fate-api-threadmessage: $(APITESTSDIR)/api-threadmessage-test$(EXESUF)
 fate-api-threadmessage: CMD = run $(APITESTSDIR)/api-threadmessage-test$(EXESUF) 3 10 30 50 2 20 40
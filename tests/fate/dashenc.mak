@@ -0,0 +1,44 @@
+# Segments and manifests written by the upload threads, through temporary
+# files renamed once complete, must be the ones written by the muxing thread.
+DASHENC_UPLOAD = -f lavfi -i testsrc=d=6:s=64x48:r=10 -vf scale,format=yuv420p \
+                 -c:v mpeg4 -g 10 -threads 1 -idct simple -dct fastint \
+                 -sws_flags +accurate_rnd+bitexact -flags +bitexact -fflags +bitexact \
+                 -seg_duration 1 -f dash
+DASHENC_UPLOAD_SEGMENTS = init 1 2 3 4 5 6
+
+FATE_DASHENC_UPLOAD-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER SCALE_FILTER FORMAT_FILTER \
+                                   MPEG4_ENCODER DASH_MUXER MOV_DEMUXER FILE_PROTOCOL \
+                                   PIPE_PROTOCOL FRAMECRC_MUXER) += fate-dash-upload
+fate-dash-upload: CMD = ffmpeg $(DASHENC_UPLOAD) \
+    -init_seg_name dash-upload-init.m4s -media_seg_name dash-upload-\$$Number\$$.m4s \
+    file:$(TARGET_PATH)/tests/data/fate/dash-upload.mpd && \
+    cat $(DASHENC_UPLOAD_SEGMENTS:%=tests/data/fate/dash-upload-%.m4s) | framecrc -i pipe:0 -c copy
+fate-dash-upload-threads: CMD = ffmpeg $(DASHENC_UPLOAD) -upload_threads 2 \
+    -init_seg_name dash-upload-threads-init.m4s -media_seg_name dash-upload-threads-\$$Number\$$.m4s \
+    file:$(TARGET_PATH)/tests/data/fate/dash-upload-threads.mpd && \
+    cat $(DASHENC_UPLOAD_SEGMENTS:%=tests/data/fate/dash-upload-threads-%.m4s) | framecrc -i pipe:0 -c copy
+fate-dash-upload-threads: REF = $(SRC_PATH)/tests/ref/fate/dash-upload
+
+# Fragments downloaded by the prefetch thread, with a memory budget smaller
+# than a fragment, must be demuxed as when read directly.
+FATE_DASHENC_DEMUX-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER SCALE_FILTER FORMAT_FILTER \
+                                  MPEG4_ENCODER DASH_MUXER DASH_DEMUXER MOV_DEMUXER \
+                                  FILE_PROTOCOL FRAMECRC_MUXER) += fate-dash-demux
+fate-dash-demux: CMD = ffmpeg $(DASHENC_UPLOAD) \
+    -init_seg_name dash-demux-init.m4s -media_seg_name dash-demux-\$$Number\$$.m4s \
+    file:$(TARGET_PATH)/tests/data/fate/dash-demux.mpd && \
+    framecrc -i file:$(TARGET_PATH)/tests/data/fate/dash-demux.mpd -c copy
+fate-dash-demux-prefetch: CMD = ffmpeg $(DASHENC_UPLOAD) \
+    -init_seg_name dash-demux-prefetch-init.m4s -media_seg_name dash-demux-prefetch-\$$Number\$$.m4s \
+    file:$(TARGET_PATH)/tests/data/fate/dash-demux-prefetch.mpd && \
+    framecrc -prefetch_segments 3 -prefetch_size 1024 \
+    -i file:$(TARGET_PATH)/tests/data/fate/dash-demux-prefetch.mpd -c copy
+fate-dash-demux-prefetch: REF = $(SRC_PATH)/tests/ref/fate/dash-demux
+
+FATE_DASHENC-yes += $(FATE_DASHENC_UPLOAD-yes)
+FATE_DASHENC-$(HAVE_THREADS) += $(FATE_DASHENC_UPLOAD-yes:%=%-threads)
+FATE_DASHENC-yes += $(FATE_DASHENC_DEMUX-yes)
+FATE_DASHENC-$(HAVE_THREADS) += $(FATE_DASHENC_DEMUX-yes:%=%-prefetch)
+
+FATE_FFMPEG += $(FATE_DASHENC-yes)
+fate-dashenc: $(FATE_DASHENC-yes)
@@ -34,6 +34,31 @@ fate-ffprobe_xsd: $(FFPROBE_TEST_FILE)
 fate-ffprobe_xsd: CMD = run $(FFPROBE_COMMAND) -noprivate -of xml=q=1:x=1 | \
 	xmllint --schema $(SRC_PATH)/doc/ffprobe.xsd -
 
+# stream information found with a partial or threaded analysis, compared
+# against the default one
+FFPROBE_PROBE_COMMAND=ffprobe$(PROGSSUF)$(EXESUF) -show_streams -show_format -bitexact
+
+FATE_FFPROBE_PROBE-$(call ENCDEC2, MPEG2VIDEO, MP2, MPEGTS) += fate-ffprobe-probe-ts fate-ffprobe-probe-ts-required
+fate-ffprobe-probe-ts fate-ffprobe-probe-ts-required: fate-lavf-ts
+fate-ffprobe-probe-ts: CMD = run $(FFPROBE_PROBE_COMMAND) $(TARGET_PATH)/tests/data/lavf/lavf.ts -print_filename lavf.ts
+fate-ffprobe-probe-ts-required: CMD = run $(FFPROBE_PROBE_COMMAND) -probe_required codec_params+start_time $(TARGET_PATH)/tests/data/lavf/lavf.ts -print_filename lavf.ts
+fate-ffprobe-probe-ts-required: REF = $(SRC_PATH)/tests/ref/fate/ffprobe-probe-ts
+FATE_FFPROBE_PROBE_THREADS-$(call ENCDEC2, MPEG2VIDEO, MP2, MPEGTS) += fate-ffprobe-probe-ts-threads
+fate-ffprobe-probe-ts-threads: fate-lavf-ts
+fate-ffprobe-probe-ts-threads: CMD = run $(FFPROBE_PROBE_COMMAND) -probe_required codec_params+start_time -probe_threads 2 $(TARGET_PATH)/tests/data/lavf/lavf.ts -print_filename lavf.ts
+fate-ffprobe-probe-ts-threads: REF = $(SRC_PATH)/tests/ref/fate/ffprobe-probe-ts
+
+# MPEG-PS has no header, the streams are only found while reading packets
+FFPROBE_PROBE_PS_COMMAND=ffprobe$(PROGSSUF)$(EXESUF) -show_entries stream=index,codec_name,width,height,pix_fmt,sample_rate,channels,start_time -bitexact $(TARGET_PATH)/tests/data/lavf/lavf.mpg
+FATE_FFPROBE_PROBE-$(call ENCDEC2, MPEG1VIDEO, MP2, MPEG1SYSTEM MPEGPS) += fate-ffprobe-probe-ps fate-ffprobe-probe-ps-required
+fate-ffprobe-probe-ps fate-ffprobe-probe-ps-required: fate-lavf-mpg
+fate-ffprobe-probe-ps: CMD = run $(FFPROBE_PROBE_PS_COMMAND)
+fate-ffprobe-probe-ps-required: CMD = run $(FFPROBE_PROBE_PS_COMMAND) -probe_required codec_params+start_time
+fate-ffprobe-probe-ps-required: REF = $(SRC_PATH)/tests/ref/fate/ffprobe-probe-ps
+
+FATE_FFPROBE += $(FATE_FFPROBE_PROBE-yes)
+FATE_FFPROBE += $(if $(HAVE_THREADS),$(FATE_FFPROBE_PROBE_THREADS-yes))
+
 FATE_FFPROBE-$(HAVE_XMLLINT) += $(FATE_FFPROBE_SCHEMA-yes)
 FATE_FFPROBE += $(FATE_FFPROBE-yes)
 
@@ -109,6 +109,39 @@ FATE_HLSENC_PROBE-$(call ALLYES, HLS_DEMUXER EAC3_DEMUXER) += fate-hls-fmp4_ac3
 fate-hls-fmp4_ac3: tests/data/hls_fmp4_ac3.m3u8
 fate-hls-fmp4_ac3: CMD = probeaudiostream $(TARGET_PATH)/tests/data/now_ac3.mp4
 
+# Segments and playlists written by the upload threads, through temporary
+# files renamed once complete, must be the ones written by the muxing thread.
+HLSENC_UPLOAD = -auto_conversion_filters -f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=20" \
+                -map 0 -codec:a mp2fixed -fflags +bitexact -hls_time 3 -hls_list_size 0 \
+                -hls_flags temp_file
+
+FATE_HLSENC_UPLOAD-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILTER LAVFI_INDEV \
+                                  MP2FIXED_ENCODER FILE_PROTOCOL FRAMECRC_MUXER) += fate-hls-upload
+fate-hls-upload: CMD = ffmpeg $(HLSENC_UPLOAD) \
+    -hls_segment_filename file:$(TARGET_PATH)/tests/data/fate/hls-upload-%d.ts \
+    file:$(TARGET_PATH)/tests/data/fate/hls-upload.m3u8 && \
+    framecrc -i $(TARGET_PATH)/tests/data/fate/hls-upload.m3u8 -c copy
+fate-hls-upload-threads: CMD = ffmpeg $(HLSENC_UPLOAD) -upload_threads 2 \
+    -hls_segment_filename file:$(TARGET_PATH)/tests/data/fate/hls-upload-threads-%d.ts \
+    file:$(TARGET_PATH)/tests/data/fate/hls-upload-threads.m3u8 && \
+    framecrc -i $(TARGET_PATH)/tests/data/fate/hls-upload-threads.m3u8 -c copy
+fate-hls-upload-threads: REF = $(SRC_PATH)/tests/ref/fate/hls-upload
+
+FATE_HLSENC_FFMPEG-yes += $(FATE_HLSENC_UPLOAD-yes)
+FATE_HLSENC_FFMPEG-$(HAVE_THREADS) += $(FATE_HLSENC_UPLOAD-yes:%=%-threads)
+
+# Segments downloaded by the prefetch thread, with a memory budget smaller
+# than a segment, must be demuxed as when read directly.
+FATE_HLSENC_FFMPEG-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILTER LAVFI_INDEV \
+                              MP2FIXED_ENCODER FILE_PROTOCOL FRAMECRC_MUXER) += fate-hls-prefetch
+fate-hls-prefetch: CMD = ffmpeg $(HLSENC_UPLOAD) \
+    -hls_segment_filename file:$(TARGET_PATH)/tests/data/fate/hls-prefetch-%d.ts \
+    file:$(TARGET_PATH)/tests/data/fate/hls-prefetch.m3u8 && \
+    framecrc -prefetch_segments 3 -prefetch_size 16384 \
+    -i file:$(TARGET_PATH)/tests/data/fate/hls-prefetch.m3u8 -c copy
+fate-hls-prefetch: REF = $(SRC_PATH)/tests/ref/fate/hls-upload
+
 FATE_SAMPLES_FFMPEG += $(FATE_HLSENC-yes)
 FATE_SAMPLES_FFMPEG_FFPROBE += $(FATE_HLSENC_PROBE-yes)
-fate-hlsenc: $(FATE_HLSENC-yes) $(FATE_HLSENC_PROBE-yes)
+FATE_FFMPEG += $(FATE_HLSENC_FFMPEG-yes)
+fate-hlsenc: $(FATE_HLSENC-yes) $(FATE_HLSENC_PROBE-yes) $(FATE_HLSENC_FFMPEG-yes)
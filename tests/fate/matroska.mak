@@ -198,8 +198,29 @@ FATE_MATROSKA_FFMPEG_FFPROBE-$(call ALLYES, FILE_PROTOCOL WEBVTT_DEMUXER  \
                                += fate-webm-webvtt-remux
 fate-webm-webvtt-remux: CMD = transcode webvtt $(TARGET_SAMPLES)/sub/WebVTT_capability_tester.vtt webm "-map 0 -map 0 -map 0 -map 0 -c:s copy -disposition:0 original+descriptions+hearing_impaired -disposition:1 lyrics+default+metadata -disposition:2 comment+forced -disposition:3 karaoke+captions+dub" "-map 0:0 -map 0:1 -c copy" "" "-show_entries stream_disposition:stream=index,codec_name:packet=stream_index,pts:packet_side_data_list -show_data_hash CRC32"
 
+# A file without Cues, written to a pipe, with many small clusters.
+tests/data/mkv-no-cues.mkv: TAG = GEN
+tests/data/mkv-no-cues.mkv: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f lavfi -i "testsrc=d=10:s=64x48:r=25" -c:v mpeg4 -g 12 -q:v 8 -threads 1 \
+        -sws_flags +accurate_rnd+bitexact -fflags +bitexact -flags +bitexact \
+        -idct simple -dct fastint -cluster_time_limit 100 \
+        -f matroska pipe: > $(TARGET_PATH)/tests/data/mkv-no-cues.mkv 2>/dev/null
+
+# These test seeking by bisection in a file without Cues, without and with
+# the cluster index. The results are the same as with cueless_seek disabled.
+FATE_MATROSKA_NO_CUES-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER MPEG4_ENCODER \
+                                     MATROSKA_MUXER MATROSKA_DEMUXER \
+                                     PIPE_PROTOCOL FILE_PROTOCOL) += \
+    fate-matroska-cueless-seek fate-matroska-cueless-seek-index
+$(FATE_MATROSKA_NO_CUES-yes): libavformat/tests/seek$(EXESUF) tests/data/mkv-no-cues.mkv
+fate-matroska-cueless-seek: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/mkv-no-cues.mkv -cueless_seek 1 -duration 10
+fate-matroska-cueless-seek-index: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/mkv-no-cues.mkv -cueless_seek 1 -index_clusters 1 -duration 10
+fate-matroska-cueless-seek-index: REF = $(SRC_PATH)/tests/ref/fate/matroska-cueless-seek
+
+FATE_AVCONV += $(FATE_MATROSKA_NO_CUES-yes)
 FATE_SAMPLES_AVCONV += $(FATE_MATROSKA-yes)
 FATE_SAMPLES_FFPROBE += $(FATE_MATROSKA_FFPROBE-yes)
 FATE_SAMPLES_FFMPEG_FFPROBE += $(FATE_MATROSKA_FFMPEG_FFPROBE-yes)
 
-fate-matroska: $(FATE_MATROSKA-yes) $(FATE_MATROSKA_FFPROBE-yes) $(FATE_MATROSKA_FFMPEG_FFPROBE-yes)
+fate-matroska: $(FATE_MATROSKA-yes) $(FATE_MATROSKA_FFPROBE-yes) $(FATE_MATROSKA_FFMPEG_FFPROBE-yes) $(FATE_MATROSKA_NO_CUES-yes)
@@ -147,4 +147,83 @@ fate-mov-mp4-disposition-mpegts-remux: CMD = transcode mpegts $(TARGET_SAMPLES)/
 
 FATE_SAMPLES_FFMPEG_FFPROBE += $(FATE_MOV_FFMPEG_FFPROBE-yes)
 
-fate-mov: $(FATE_MOV) $(FATE_MOV_FFPROBE) $(FATE_MOV_FASTSTART) $(FATE_MOV_FFMPEG_FFPROBE-yes)
+# The video track is stored after the audio track, but both start at 0 once
+# the edit lists are ignored, so the demuxer has to alternate between them.
+tests/data/mov-track-readahead.mov: TAG = GEN
+tests/data/mov-track-readahead.mov: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f lavfi -i "sine=d=2" -f lavfi -i "testsrc=d=2:s=64x48:r=10" \
+        -map 0 -map 1 -filter:v "setpts=PTS+10/TB" -vsync passthrough \
+        -fflags +bitexact -flags +bitexact -c:a pcm_s16le -c:v rawvideo -pix_fmt rgb24 \
+        -y $(TARGET_PATH)/tests/data/mov-track-readahead.mov 2>/dev/null
+
+# Makes sure that reading the samples of a track ahead returns the same packets
+# as reading them one by one.
+FATE_MOV_FFMPEG-$(call ALLYES, FILE_PROTOCOL LAVFI_INDEV SINE_FILTER TESTSRC_FILTER \
+                               SETPTS_FILTER PCM_S16LE_ENCODER RAWVIDEO_ENCODER \
+                               MOV_MUXER MOV_DEMUXER FRAMECRC_MUXER PIPE_PROTOCOL) \
+                               += fate-mov-track-readahead
+fate-mov-track-readahead: tests/data/mov-track-readahead.mov
+fate-mov-track-readahead: CMD = framecrc -ignore_editlist 1 -track_readahead 65536 -i $(TARGET_PATH)/tests/data/mov-track-readahead.mov -c copy
+
+# The space for the moov atom is inserted in place or, on filesystems not
+# supporting it, made by moving the data. Reading the output from a pipe
+# checks that the moov atom ends up before the data either way.
+FATE_MOV_FFMPEG-$(call ALLYES, FILE_PROTOCOL LAVFI_INDEV SINE_FILTER TESTSRC_FILTER \
+                               SETPTS_FILTER PCM_S16LE_ENCODER RAWVIDEO_ENCODER \
+                               MOV_MUXER MOV_DEMUXER FRAMECRC_MUXER PIPE_PROTOCOL) \
+                               += fate-mov-insert-moov
+fate-mov-insert-moov: tests/data/mov-track-readahead.mov
+fate-mov-insert-moov: CMD = ffmpeg -i $(TARGET_PATH)/tests/data/mov-track-readahead.mov -c copy -movflags +faststart+insert_moov -fflags +bitexact -y $(TARGET_PATH)/tests/data/fate/mov-insert-moov.mov && cat tests/data/fate/mov-insert-moov.mov | framecrc -i pipe:0 -c copy
+
+# The moov atom space reserved from the expected duration is large enough in
+# the first test. It is too small in the second one, where the data is moved
+# by the missing size. The data must be the same in both.
+FATE_MOV_FFMPEG-$(call ALLYES, FILE_PROTOCOL LAVFI_INDEV TESTSRC_FILTER SCALE_FILTER \
+                               FORMAT_FILTER MPEG4_ENCODER MOV_MUXER MOV_DEMUXER \
+                               CRC_MUXER PIPE_PROTOCOL) \
+                               += fate-mov-reserve-moov fate-mov-reserve-moov-short
+MOV_RESERVE_MOOV = -f lavfi -i testsrc=d=40:s=16x16:r=100 -vf scale,format=yuv420p \
+                   -c:v mpeg4 -q:v 8 -threads 1 -idct simple -dct fastint \
+                   -sws_flags +accurate_rnd+bitexact -flags +bitexact -fflags +bitexact \
+                   -movflags +reserve_moov -f mov
+fate-mov-reserve-moov: CMD = md5 $(MOV_RESERVE_MOOV) -expected_duration 40 && cat tests/data/fate/mov-reserve-moov.out | crc -i pipe:0 -c copy
+fate-mov-reserve-moov-short: CMD = md5 $(MOV_RESERVE_MOOV) -expected_duration 2 && cat tests/data/fate/mov-reserve-moov-short.out | crc -i pipe:0 -c copy
+
+# Fragments written by the writer thread, with a small queue budget to make
+# the muxing thread wait for it, must be the same as the ones written
+# synchronously.
+FATE_MOV_FRAG_WRITE-$(call ALLYES, FILE_PROTOCOL LAVFI_INDEV SINE_FILTER TESTSRC_FILTER \
+                                   SETPTS_FILTER PCM_S16LE_ENCODER RAWVIDEO_ENCODER \
+                                   MOV_MUXER MOV_DEMUXER) \
+                                   += fate-mov-frag-write
+MOV_FRAG_WRITE = -i $(TARGET_PATH)/tests/data/mov-track-readahead.mov -c copy \
+                 -movflags +frag_keyframe+empty_moov -fflags +bitexact -f mov
+fate-mov-frag-write fate-mov-frag-write-thread: tests/data/mov-track-readahead.mov
+fate-mov-frag-write: CMD = md5 $(MOV_FRAG_WRITE)
+fate-mov-frag-write-thread: CMD = md5 $(MOV_FRAG_WRITE) -frag_write_thread 1 -frag_write_buffer 4096
+fate-mov-frag-write-thread: REF = $(SRC_PATH)/tests/ref/fate/mov-frag-write
+FATE_MOV_FFMPEG-yes += $(FATE_MOV_FRAG_WRITE-yes)
+FATE_MOV_FFMPEG-yes += $(if $(HAVE_THREADS),$(FATE_MOV_FRAG_WRITE-yes:%=%-thread))
+
+# Writing the output from a background thread, with small blocks and budget,
+# must not change it, also when faststart reads it back.
+FATE_MOV_ASYNC_WRITE-$(call ALLYES, FILE_PROTOCOL LAVFI_INDEV SINE_FILTER TESTSRC_FILTER \
+                                    SETPTS_FILTER PCM_S16LE_ENCODER RAWVIDEO_ENCODER \
+                                    MOV_MUXER MOV_DEMUXER) \
+                                    += fate-mov-write fate-mov-write-faststart
+MOV_WRITE = -i $(TARGET_PATH)/tests/data/mov-track-readahead.mov -c copy -fflags +bitexact -f mov
+MOV_ASYNC_WRITE = -async_write 1 -async_write_size 4096 -async_write_budget 16384
+$(FATE_MOV_ASYNC_WRITE-yes) $(FATE_MOV_ASYNC_WRITE-yes:%=%-async): tests/data/mov-track-readahead.mov
+fate-mov-write: CMD = md5 $(MOV_WRITE)
+fate-mov-write-async: CMD = md5 $(MOV_WRITE) $(MOV_ASYNC_WRITE)
+fate-mov-write-async: REF = $(SRC_PATH)/tests/ref/fate/mov-write
+fate-mov-write-faststart: CMD = md5 $(MOV_WRITE) -movflags +faststart
+fate-mov-write-faststart-async: CMD = md5 $(MOV_WRITE) -movflags +faststart $(MOV_ASYNC_WRITE)
+fate-mov-write-faststart-async: REF = $(SRC_PATH)/tests/ref/fate/mov-write-faststart
+FATE_MOV_FFMPEG-yes += $(FATE_MOV_ASYNC_WRITE-yes)
+FATE_MOV_FFMPEG-yes += $(if $(HAVE_THREADS),$(FATE_MOV_ASYNC_WRITE-yes:%=%-async))
+
+FATE_FFMPEG += $(FATE_MOV_FFMPEG-yes)
+
+fate-mov: $(FATE_MOV) $(FATE_MOV_FFPROBE) $(FATE_MOV_FASTSTART) $(FATE_MOV_FFMPEG_FFPROBE-yes) $(FATE_MOV_FFMPEG-yes)
@@ -52,11 +52,20 @@ FATE_MXF_OPATOM_USER_COMMENTS-$(call ENCDEC2, MPEG2VIDEO, PCM_S16LE, MXF) += fat
 fate-mxf-opatom-user-comments: $(SAMPLES)/mxf/Sony-00001.mxf
 fate-mxf-opatom-user-comments: CMD = md5 -y -i $(TARGET_SAMPLES)/mxf/Sony-00001.mxf -an -vcodec copy -metadata "comment_test=value" -fflags +bitexact -f mxf_opatom
 
+# Reads the partitions listed in the RIP in a background thread, which must
+# give the same packets as reading them one after the other.
+FATE_MXF_PARTITION_THREADS-$(call ALLYES, FILE_PROTOCOL PIPE_PROTOCOL FRAMECRC_MUXER \
+                                          MXF_MUXER MXF_DEMUXER MPEG2VIDEO_ENCODER \
+                                          PCM_S16LE_ENCODER) += fate-mxf-partition-threads
+fate-mxf-partition-threads: fate-lavf-mxf
+fate-mxf-partition-threads: CMD = framecrc -partition_threads 2 -i $(TARGET_PATH)/tests/data/lavf/lavf.mxf -c copy
+
 FATE_MXF-$(CONFIG_MXF_DEMUXER) += $(FATE_MXF)
 
 FATE_SAMPLES_AVCONV += $(FATE_MXF-yes) $(FATE_MXF_REEL_NAME-yes)
 FATE_SAMPLES_AVCONV += $(FATE_MXF_USER_COMMENTS-yes) $(FATE_MXF_OPATOM_USER_COMMENTS-yes)
 FATE_SAMPLES_FFMPEG_FFPROBE += $(FATE_MXF_D10_USER_COMMENTS-yes)
 FATE_SAMPLES_FFPROBE += $(FATE_MXF_PROBE-yes)
+FATE_FFMPEG += $(FATE_MXF_PARTITION_THREADS-yes)
 
-fate-mxf: $(FATE_MXF-yes) $(FATE_MXF_PROBE-yes) $(FATE_MXF_REEL_NAME-yes) $(FATE_MXF_USER_COMMENTS-yes) $(FATE_MXF_D10_USER_COMMENTS-yes) $(FATE_MXF_OPATOM_USER_COMMENTS-yes)
+fate-mxf: $(FATE_MXF-yes) $(FATE_MXF_PROBE-yes) $(FATE_MXF_REEL_NAME-yes) $(FATE_MXF_USER_COMMENTS-yes) $(FATE_MXF_D10_USER_COMMENTS-yes) $(FATE_MXF_OPATOM_USER_COMMENTS-yes) $(FATE_MXF_PARTITION_THREADS-yes)
@@ -350,7 +350,8 @@ fate-vsynth%-mpng:               CODEC   = png
 
 FATE_VCODEC-$(call ENCDEC, MSVIDEO1, AVI) += msvideo1
 
-FATE_VCODEC-$(call ENCDEC, PRORES, MOV) += prores prores_int prores_444 prores_444_int prores_ks
+FATE_VCODEC-$(call ENCDEC, PRORES, MOV) += prores prores_int prores_444 prores_444_int prores_ks \
+                                           prores_ks_fast
 fate-vsynth%-prores:             FMT     = mov
 
 fate-vsynth%-prores_int:         CODEC   = prores
@@ -368,6 +369,10 @@ fate-vsynth%-prores_444_int:     FMT     = mov
 fate-vsynth%-prores_ks:          ENCOPTS = -profile hq
 fate-vsynth%-prores_ks:          FMT     = mov
 
+fate-vsynth%-prores_ks_fast:     CODEC   = prores_ks
+fate-vsynth%-prores_ks_fast:     ENCOPTS = -profile hq -quant_search fast
+fate-vsynth%-prores_ks_fast:     FMT     = mov
+
 FATE_VCODEC-$(call ENCDEC, QTRLE, MOV)  += qtrle qtrlegray
 fate-vsynth%-qtrle:              FMT     = mov
 
@@ -463,7 +468,9 @@ FATE_VCODEC-$(call ENCDEC, ZLIB, AVI) += zlib
 FATE_VCODEC += $(FATE_VCODEC-yes)
 FATE_VSYNTH1 = $(FATE_VCODEC:%=fate-vsynth1-%)
 FATE_VSYNTH2 = $(FATE_VCODEC:%=fate-vsynth2-%)
-FATE_VSYNTH_LENA = $(FATE_VCODEC:%=fate-vsynth_lena-%)
+# No reference for the lena sample yet
+VSYNTH_LENA_OFF  = prores_ks_fast
+FATE_VSYNTH_LENA = $(filter-out $(VSYNTH_LENA_OFF:%=fate-vsynth_lena-%),$(FATE_VCODEC:%=fate-vsynth_lena-%))
 # Redundant tests because they just resize the input
 RESIZE_OFF   = dnxhd-720p dnxhd-720p-rd dnxhd-720p-10bit dnxhd-1080i \
                dv dv-411 dv-50 avui snow snow-hpel snow-ll vc2-420p \
@@ -0,0 +1,252 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Measure av_read_frame() throughput on inputs made of many small packets.
+ * Matroska files with a single 16-bit mono PCM stream are muxed in memory,
+ * with block sizes from 16 samples up to the given maximum, then demuxed
+ * from memory a number of times; the best run is reported.
+ * An input file can be given instead, it is then read into memory and
+ * demuxed the same way.
+ * The checksum of the packets allows to check that the demuxed data does
+ * not change.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/file.h"
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+
+#define AUDIO_RATE 48000
+
+typedef struct Input {
+    const uint8_t *data;
+    int64_t size;
+    int64_t pos;
+} Input;
+
+static int read_input(void *opaque, uint8_t *buf, int size)
+{
+    Input *in = opaque;
+
+    size = FFMIN(size, in->size - in->pos);
+    if (size <= 0)
+        return AVERROR_EOF;
+    memcpy(buf, in->data + in->pos, size);
+    in->pos += size;
+    return size;
+}
+
+static int64_t seek_input(void *opaque, int64_t offset, int whence)
+{
+    Input *in = opaque;
+
+    switch (whence) {
+    case AVSEEK_SIZE: return in->size;
+    case SEEK_SET:                      break;
+    case SEEK_CUR:    offset += in->pos;  break;
+    case SEEK_END:    offset += in->size; break;
+    default:          return AVERROR(EINVAL);
+    }
+    if (offset < 0 || offset > in->size)
+        return AVERROR(EINVAL);
+    return in->pos = offset;
+}
+
+static int mux(int block_samples, int seconds, uint8_t **buf, int *size)
+{
+    AVFormatContext *oc = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    AVStream *st;
+    int ret;
+
+    *buf = NULL;
+    if (!pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    ret = avformat_alloc_output_context2(&oc, NULL, "matroska", NULL);
+    if (ret < 0)
+        goto end;
+    if (!(st = avformat_new_stream(oc, NULL))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    st->codecpar->codec_type  = AVMEDIA_TYPE_AUDIO;
+    st->codecpar->codec_id    = AV_CODEC_ID_PCM_S16LE;
+    st->codecpar->sample_rate = AUDIO_RATE;
+    st->codecpar->channels    = 1;
+    st->time_base             = (AVRational){ 1, AUDIO_RATE };
+    if ((ret = avio_open_dyn_buf(&oc->pb)) < 0)
+        goto end;
+    if ((ret = avformat_write_header(oc, NULL)) < 0)
+        goto end;
+
+    for (int64_t pts = 0; pts < (int64_t)seconds * AUDIO_RATE; pts += block_samples) {
+        if ((ret = av_new_packet(pkt, 2 * block_samples)) < 0)
+            goto end;
+        for (int i = 0; i < pkt->size; i++)
+            pkt->data[i] = pts + i;
+        pkt->pts = pkt->dts = pts;
+        pkt->duration = block_samples;
+        pkt->flags = AV_PKT_FLAG_KEY;
+        if ((ret = av_write_frame(oc, pkt)) < 0)
+            goto end;
+        av_packet_unref(pkt);
+    }
+    ret = av_write_trailer(oc);
+
+end:
+    if (oc && oc->pb) {
+        *size = avio_close_dyn_buf(oc->pb, buf);
+        oc->pb = NULL;
+    }
+    if (ret >= 0 && !*buf)
+        ret = AVERROR(ENOMEM);
+    if (ret < 0)
+        av_freep(buf);
+    av_packet_free(&pkt);
+    avformat_free_context(oc);
+    return ret;
+}
+
+static int demux(const uint8_t *data, int64_t size, int64_t *nb_packets,
+                 int64_t *nb_bytes, double *elapsed, uint32_t *checksum)
+{
+    Input in = { data, size };
+    AVFormatContext *ic = NULL;
+    AVIOContext *pb = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    uint8_t *iobuf = av_malloc(32768);
+    int64_t start;
+    int ret;
+
+    *nb_packets = *nb_bytes = 0;
+    *checksum = 1;
+    if (!pkt || !iobuf || !(ic = avformat_alloc_context())) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    pb = avio_alloc_context(iobuf, 32768, 0, &in, read_input, NULL, seek_input);
+    if (!pb) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    iobuf = NULL;
+    ic->pb = pb;
+
+    start = av_gettime_relative();
+    if ((ret = avformat_open_input(&ic, "", NULL, NULL)) < 0)
+        goto end;
+    while ((ret = av_read_frame(ic, pkt)) >= 0) {
+        *checksum = av_adler32_update(*checksum, pkt->data, pkt->size);
+        *nb_bytes += pkt->size;
+        (*nb_packets)++;
+        av_packet_unref(pkt);
+    }
+    *elapsed = (av_gettime_relative() - start) / 1000000.0;
+    if (ret == AVERROR_EOF)
+        ret = 0;
+
+end:
+    avformat_close_input(&ic);
+    if (pb) {
+        av_freep(&pb->buffer);
+        avio_context_free(&pb);
+    }
+    av_freep(&iobuf);
+    av_packet_free(&pkt);
+    return ret;
+}
+
+static int bench(const char *name, const uint8_t *data, int64_t size, int runs)
+{
+    int64_t nb_packets, nb_bytes;
+    double best = 0;
+    uint32_t checksum;
+
+    for (int i = 0; i < runs; i++) {
+        double elapsed;
+        int ret = demux(data, size, &nb_packets, &nb_bytes, &elapsed, &checksum);
+
+        if (ret < 0) {
+            fprintf(stderr, "%s: %s\n", name, av_err2str(ret));
+            return ret;
+        }
+        if (!i || elapsed < best)
+            best = elapsed;
+    }
+    best = FFMAX(best, 1e-6);
+    printf("%s: %8"PRId64" packets, %7.1f ns/packet, %7.1f MB/s, checksum 0x%08"PRIX32"\n",
+           name, nb_packets, best * 1e9 / FFMAX(nb_packets, 1),
+           size / best / 1e6, checksum);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int max_samples, seconds, runs;
+    int ret = 0;
+
+    if (argc > 1 && !strspn(argv[1], "0123456789")) {
+        uint8_t *data;
+        size_t size;
+
+        runs = argc > 2 ? atoi(argv[2]) : 10;
+        if (runs < 1) {
+            fprintf(stderr, "Usage: %s input [runs]\n", argv[0]);
+            return 1;
+        }
+        if ((ret = av_file_map(argv[1], &data, &size, 0, NULL)) < 0) {
+            fprintf(stderr, "%s: %s\n", argv[1], av_err2str(ret));
+            return 1;
+        }
+        ret = bench(argv[1], data, size, runs);
+        av_file_unmap(data, size);
+        return ret < 0;
+    }
+
+    max_samples = argc > 1 ? atoi(argv[1]) : 1024;
+    seconds     = argc > 2 ? atoi(argv[2]) : 600;
+    runs        = argc > 3 ? atoi(argv[3]) : 10;
+    if (max_samples < 16 || seconds < 1 || runs < 1) {
+        fprintf(stderr, "Usage: %s [max_block_samples [seconds [runs]]]\n"
+                        "       %s input [runs]\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    for (int n = 16; n <= max_samples && ret >= 0; n *= 2) {
+        char name[32];
+        uint8_t *data;
+        int size;
+
+        if ((ret = mux(n, seconds, &data, &size)) < 0) {
+            fprintf(stderr, "%d samples per block: %s\n", n, av_err2str(ret));
+            break;
+        }
+        snprintf(name, sizeof(name), "%4d samples per block", n);
+        ret = bench(name, data, size, runs);
+        av_free(data);
+    }
+    return ret < 0;
+}
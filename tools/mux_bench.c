@@ -0,0 +1,193 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Measure av_interleaved_write_frame() throughput against the number of
+ * streams. One video stream is muxed together with audio and sparse
+ * subtitle streams into the framecrc muxer. Each stream is fed in bursts,
+ * as when the streams come from different inputs or encoders, so packets
+ * have to be inserted in the middle of the interleaving queue.
+ * The checksum of the output allows to check that the interleaving order
+ * does not change.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/mathematics.h"
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+
+#define VIDEO_TB       25
+#define AUDIO_RATE  48000
+#define AUDIO_FRAME  1024
+#define SUB_INTERVAL    5 ///< seconds between subtitle packets
+
+static int write_output(void *opaque, uint8_t *buf, int size)
+{
+    uint32_t *checksum = opaque;
+
+    *checksum = av_adler32_update(*checksum, buf, size);
+    return size;
+}
+
+static int add_stream(AVFormatContext *oc, enum AVMediaType type)
+{
+    AVStream *st = avformat_new_stream(oc, NULL);
+
+    if (!st)
+        return AVERROR(ENOMEM);
+    st->codecpar->codec_type = type;
+    switch (type) {
+    case AVMEDIA_TYPE_VIDEO:
+        st->codecpar->codec_id = AV_CODEC_ID_RAWVIDEO;
+        st->codecpar->width    = 16;
+        st->codecpar->height   = 16;
+        st->time_base          = (AVRational){ 1, VIDEO_TB };
+        break;
+    case AVMEDIA_TYPE_AUDIO:
+        st->codecpar->codec_id    = AV_CODEC_ID_PCM_S16LE;
+        st->codecpar->sample_rate = AUDIO_RATE;
+        st->codecpar->channels    = 1;
+        st->time_base             = (AVRational){ 1, AUDIO_RATE };
+        break;
+    default:
+        st->codecpar->codec_id = AV_CODEC_ID_SUBRIP;
+        st->time_base          = (AVRational){ 1, 1000 };
+        break;
+    }
+    return 0;
+}
+
+static int write_packet(AVFormatContext *oc, AVPacket *pkt, int stream_index,
+                        int64_t dts, int64_t duration)
+{
+    int ret = av_new_packet(pkt, 16);
+
+    if (ret < 0)
+        return ret;
+    memset(pkt->data, stream_index, pkt->size);
+    pkt->stream_index = stream_index;
+    pkt->pts = pkt->dts = dts;
+    pkt->duration = duration;
+    pkt->flags = AV_PKT_FLAG_KEY;
+    return av_interleaved_write_frame(oc, pkt);
+}
+
+static int run(int nb_streams, int seconds, int burst, int64_t max_delta,
+               double *rate, uint32_t *checksum)
+{
+    const AVOutputFormat *ofmt = av_guess_format("framecrc", NULL, NULL);
+    AVFormatContext *oc = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    uint8_t *iobuf = av_malloc(4096);
+    int64_t *next_dts = NULL, start, nb_packets = 0;
+    int i, ret;
+
+    *checksum = 1;
+    if (!pkt || !iobuf || !ofmt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    ret = avformat_alloc_output_context2(&oc, ofmt, NULL, NULL);
+    if (ret < 0)
+        goto end;
+    oc->max_interleave_delta = max_delta;
+    oc->pb = avio_alloc_context(iobuf, 4096, 1, checksum, NULL, write_output, NULL);
+    if (!oc->pb) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    iobuf = NULL;
+
+    for (i = 0; i < nb_streams; i++) {
+        ret = add_stream(oc, !i ? AVMEDIA_TYPE_VIDEO :
+                             i & 1 ? AVMEDIA_TYPE_AUDIO : AVMEDIA_TYPE_SUBTITLE);
+        if (ret < 0)
+            goto end;
+    }
+    next_dts = av_calloc(nb_streams, sizeof(*next_dts));
+    if (!next_dts) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if ((ret = avformat_write_header(oc, NULL)) < 0)
+        goto end;
+
+    start = av_gettime_relative();
+    for (int64_t t = burst; t <= seconds * VIDEO_TB; t += burst) {
+        for (i = 0; i < nb_streams; i++) {
+            AVStream *st = oc->streams[i];
+            int64_t limit = av_rescale_q(t, (AVRational){ 1, VIDEO_TB }, st->time_base);
+            int64_t duration = st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO ? 1 :
+                               st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO ? AUDIO_FRAME :
+                               SUB_INTERVAL * 1000;
+
+            while (next_dts[i] < limit) {
+                if ((ret = write_packet(oc, pkt, i, next_dts[i], duration)) < 0)
+                    goto end;
+                next_dts[i] += duration;
+                nb_packets++;
+            }
+        }
+    }
+    ret = av_write_trailer(oc);
+    *rate = nb_packets * 1000000.0 / FFMAX(av_gettime_relative() - start, 1);
+
+end:
+    if (oc && oc->pb) {
+        av_freep(&oc->pb->buffer);
+        avio_context_free(&oc->pb);
+    }
+    av_freep(&iobuf);
+    av_freep(&next_dts);
+    av_packet_free(&pkt);
+    avformat_free_context(oc);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int max_streams = argc > 1 ? atoi(argv[1]) : 64;
+    int seconds     = argc > 2 ? atoi(argv[2]) : 600;
+    int burst       = argc > 3 ? atoi(argv[3]) : VIDEO_TB;
+    int64_t delta   = argc > 4 ? strtoll(argv[4], NULL, 0) : 0;
+
+    if (max_streams < 2 || seconds < 1 || burst < 1) {
+        fprintf(stderr, "Usage: %s [max_streams [seconds [burst_frames [max_interleave_delta]]]]\n",
+                argv[0]);
+        return 1;
+    }
+
+    for (int n = 2; n <= max_streams; n *= 2) {
+        uint32_t checksum;
+        double rate;
+        int ret = run(n, seconds, burst, delta, &rate, &checksum);
+
+        if (ret < 0) {
+            fprintf(stderr, "%d streams: %s\n", n, av_err2str(ret));
+            return 1;
+        }
+        printf("%3d streams: %10.0f packets/s, checksum 0x%08"PRIX32"\n",
+               n, rate, checksum);
+    }
+    return 0;
+}